@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <thread>
+
+#include <common/arguments.hpp>
+#include <common/address_v4.hpp>
+#include <common/socket_udp.hpp>
+
+/*
+ * Benchmarks for the data paths of bootpd, each mode is a plain client or
+ * sink driving a bootpd started separately, or the socket layer directly.
+ * Every run prints one line per measurement, meant to be pasted as is.
+ */
+
+/* datagrams per second of one sendto per datagram against UDP GSO sends of the same datagrams */
+auto bench_gso(arguments& args) -> int;
+/* counts the datagrams arriving at -L every second, the receiving end of a gso run across a veth pair */
+auto bench_sink(arguments& args) -> int;
+/* -N concurrent downloads of -F, with the blksize and windowsize asked for, throughput, what the client had to throw away
+   and how far apart the DATA of a window arrive, which shows whether the server's pacing takes effect */
+auto bench_tftp(arguments& args) -> int;
+/* DISCOVER to OFFER latency percentiles of a DHCP server, -W DISCOVERs in flight at a time */
+auto bench_dhcp(arguments& args) -> int;
+
+/* counts datagrams arriving at a socket on its own thread until stopped */
+struct bench_counter
+{
+	explicit bench_counter(socket_udp socket);
+	bench_counter(bench_counter const&) = delete;
+	bench_counter& operator = (bench_counter const&) = delete;
+ ~bench_counter();
+
+	auto take() noexcept -> std::uint64_t;
+
+private:
+	socket_udp								m_socket;
+	std::atomic<std::uint64_t>	m_count{ 0u };
+	std::jthread							m_thread;
+};
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <format>
+#include <vector>
+#include <array>
+#include <span>
+#include <random>
+#include <charconv>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+#include "bench.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+/* "00:1c:7e:35:ed:20", dashes work too, as the client sections of the config name it */
+static auto bench_mac(std::string_view text_v) -> std::array<std::byte, 6u>
+{
+	std::array<std::byte, 6u> mac_v{};
+	if (text_v.size() != 17u)
+		throw std::invalid_argument(std::format("Invalid MAC address '{}'.", text_v));
+	for (auto i = 0u; i < mac_v.size(); ++i)
+	{
+		unsigned value_v{ 0u };
+		if (std::from_chars(text_v.data() + i*3u, text_v.data() + i*3u + 2u, value_v, 16).ec != std::errc{})
+			throw std::invalid_argument(std::format("Invalid MAC address '{}'.", text_v));
+		mac_v[i] = std::byte(value_v);
+	}
+	return mac_v;
+}
+
+/* BOOTREQUEST with the broadcast flag set, the fixed part is 236 bytes, the magic cookie and options follow */
+static auto bench_discover(std::uint32_t xid_v, std::array<std::byte, 6u> const& mac_v) -> std::vector<std::byte>
+{
+	std::vector<std::byte> packet_v(236u);
+	packet_v[0] = std::byte{ 1u };		/* op = BOOTREQUEST */
+	packet_v[1] = std::byte{ 1u };		/* htype = Ethernet */
+	packet_v[2] = std::byte{ 6u };		/* hlen */
+	for (auto i = 0u; i < 4u; ++i)
+		packet_v[4u + i] = std::byte((xid_v >> (24u - 8u*i)) & 0xffu);
+	packet_v[10] = std::byte{ 0x80u };	/* flags = broadcast */
+	std::ranges::copy(mac_v, packet_v.begin() + 28);
+	/* magic cookie, DHCPDISCOVER, asking for subnet mask and router */
+	for (auto byte_v : { 0x63u, 0x82u, 0x53u, 0x63u, 53u, 1u, 1u, 55u, 2u, 1u, 3u, 255u })
+		packet_v.push_back(std::byte(byte_v));
+	return packet_v;
+}
+
+auto bench_dhcp(arguments& args) -> int
+{
+	using namespace std::string_view_literals;
+	using namespace std::chrono_literals;
+	const auto target_v = address_v4(args.value_or("-T"sv, "127.0.0.1:67"sv));
+	const auto local_v = address_v4(args.value_or("-L"sv, "0.0.0.0:68"sv));
+	const auto mac_v = bench_mac(args.value_or("-M"sv, "00:1c:7e:35:ed:20"sv));
+	const auto count_v = std::max(args.value_or("-N"sv, 10000u), 1u);
+	const auto window_v = std::max(args.value_or("-W"sv, 1u), 1u);
+
+	/* replies are broadcast to the port the DISCOVER came from */
+	socket_udp socket_v{ local_v };
+	socket_v.option<so_broadcast>(so_true);
+	socket_v.receive_buffer(4 << 20);
+	socket_v.timeout_recv(200ms);
+
+	/* a DISCOVER is index xid - base_v, its slot goes back to zero once answered or given up on */
+	const auto base_v = std::random_device{}();
+	std::vector<clock_type::time_point> sent_at_v(count_v);
+	std::vector<std::uint32_t> latencies_v;
+	latencies_v.reserve(count_v);
+	std::array<std::byte, 0x10000u> buffer_v;
+	auto next_v = 0u;
+	auto outstanding_v = 0u;
+
+	const auto start_v = clock_type::now();
+	while (next_v < count_v || outstanding_v > 0u)
+	{
+		for (; next_v < count_v && outstanding_v < window_v; ++next_v, ++outstanding_v)
+		{
+			const auto packet_v = bench_discover(base_v + next_v, mac_v);
+			std::span<const std::byte> bytes_v{ packet_v };
+			sent_at_v[next_v] = clock_type::now();
+			socket_v.send(bytes_v, target_v, 0);
+		}
+		std::span<std::byte> bits_v{ buffer_v };
+		address_v4 source_v;
+		try
+		{ socket_v.recv(bits_v, source_v, 0); }
+		catch (error_socket_timed_out const&)
+		{
+			/* the rest of those in flight are lost */
+			std::ranges::fill(std::span(sent_at_v).first(next_v), clock_type::time_point{});
+			outstanding_v = 0u;
+			continue;
+		}
+		const auto received_v = clock_type::now();
+		if (bits_v.size() < 236u || bits_v[0] != std::byte{ 2u })
+			continue;
+		const auto xid_v = (std::uint32_t(bits_v[4]) << 24u) | (std::uint32_t(bits_v[5]) << 16u) | (std::uint32_t(bits_v[6]) << 8u) | std::uint32_t(bits_v[7]);
+		const auto index_v = xid_v - base_v;
+		if (index_v >= next_v || sent_at_v[index_v] == clock_type::time_point{})
+			continue;
+		latencies_v.push_back((std::uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(received_v - sent_at_v[index_v]).count());
+		sent_at_v[index_v] = clock_type::time_point{};
+		--outstanding_v;
+	}
+	const auto seconds_v = std::chrono::duration<double>(clock_type::now() - start_v).count();
+
+	std::ranges::sort(latencies_v);
+	const auto percentile_v = [&] (double fraction_v) -> std::uint32_t
+	{
+		if (latencies_v.empty())
+			return 0u;
+		return latencies_v[std::min(latencies_v.size() - 1u, (std::size_t)(fraction_v * (double)latencies_v.size()))];
+	};
+	std::cout << std::format("{} DISCOVER to {}, {} in flight\n", count_v, target_v.to_string(), window_v);
+	std::cout << std::format("offers {} ({} lost), {:.0f}/s, p50 {}us p99 {}us p999 {}us max {}us\n",
+		latencies_v.size(), count_v - latencies_v.size(), (double)latencies_v.size() / seconds_v,
+		percentile_v(0.5), percentile_v(0.99), percentile_v(0.999), latencies_v.empty() ? 0u : latencies_v.back());
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <format>
+#include <vector>
+#include <array>
+#include <span>
+#include <string_view>
+
+#include "bench.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+bench_counter::bench_counter(socket_udp socket):
+	m_socket(std::move(socket))
+{
+	using namespace std::chrono_literals;
+	m_socket.receive_buffer(8 << 20);
+	m_socket.timeout_recv(100ms);
+	m_thread = std::jthread([this] (std::stop_token st)
+	{
+		std::vector<std::byte> storage_v(64u * 0x10000u);
+		std::array<std::span<std::byte>, 64u> buffers_v;
+		std::array<address_v4, 64u> sources_v;
+		while (!st.stop_requested())
+		{
+			for (auto i = 0u; i < buffers_v.size(); ++i)
+				buffers_v[i] = std::span(storage_v).subspan(i * 0x10000u, 0x10000u);
+			try
+			{ m_count.fetch_add(m_socket.recv_batch(buffers_v, sources_v, 0), std::memory_order_relaxed); }
+			catch (error_socket_timed_out const&)
+			{}
+		}
+	});
+}
+
+bench_counter::~bench_counter()
+{
+	m_thread.request_stop();
+}
+
+auto bench_counter::take() noexcept -> std::uint64_t
+{
+	return m_count.exchange(0u, std::memory_order_relaxed);
+}
+
+/* sends for the duration with `send_v`, which returns the datagrams it sent, prints the rates */
+template <typename F>
+static void bench_run(std::string_view name_v, std::chrono::seconds duration_v, std::size_t segment_v, bench_counter* sink_v, F&& send_v)
+{
+	if (sink_v)
+		sink_v->take();
+	std::uint64_t sent_v{ 0u };
+	const auto start_v = clock_type::now();
+	auto elapsed_v = clock_type::duration{};
+	while ((elapsed_v = clock_type::now() - start_v) < duration_v)
+		sent_v += send_v();
+	const auto seconds_v = std::chrono::duration<double>(elapsed_v).count();
+	std::cout << std::format("{:<10} {:>12.0f} datagrams/s {:>8.2f} Gbit/s", name_v, (double)sent_v / seconds_v, (double)sent_v * (double)segment_v * 8.0 / seconds_v / 1e9);
+	if (sink_v)
+		std::cout << std::format(", received {:.0f} datagrams/s", (double)sink_v->take() / seconds_v);
+	std::cout << "\n";
+}
+
+auto bench_gso(arguments& args) -> int
+{
+	using namespace std::string_view_literals;
+	const auto target_v = address_v4(args.value_or("-T"sv, "127.0.0.1:6999"sv));
+	const auto segment_v = (std::size_t)args.value_or("-S"sv, 1432u);
+	const auto burst_v = (std::size_t)args.value_or("-B"sv, 64u);
+	const auto duration_v = std::chrono::seconds(args.value_or("-D"sv, 3u));
+
+	/* a local target gets a sink counting what arrives, a remote one runs `bootpd_bench sink` */
+	std::unique_ptr<bench_counter> sink_v;
+	try
+	{ sink_v = std::make_unique<bench_counter>(socket_udp(target_v)); }
+	catch (std::exception const&)
+	{}
+
+	auto socket_v = socket_udp::make_unbound();
+	socket_v.send_buffer(4 << 20);
+	std::vector<std::byte> payload_v(segment_v * burst_v, std::byte{ 0x5a });
+
+	std::cout << std::format("{} byte datagrams to {}, {} per GSO send\n", segment_v, target_v.to_string(), burst_v);
+	bench_run("sendto"sv, duration_v, segment_v, sink_v.get(), [&] ()
+	{
+		std::span<const std::byte> datagram_v(payload_v.data(), segment_v);
+		socket_v.send(datagram_v, target_v, 0);
+		return 1u;
+	});
+	bench_run("gso"sv, duration_v, segment_v, sink_v.get(), [&] ()
+	{
+		const std::array<std::span<const std::byte>, 1u> pieces_v{ payload_v };
+		return socket_v.send_segmented(pieces_v, segment_v, target_v, 0);
+	});
+	return 0;
+}
+
+auto bench_sink(arguments& args) -> int
+{
+	using namespace std::string_view_literals;
+	using namespace std::chrono_literals;
+	const auto local_v = address_v4(args.value_or("-L"sv, "0.0.0.0:6999"sv));
+	const auto duration_v = args.value_or("-D"sv, 10u);
+
+	bench_counter sink_v(socket_udp{ local_v });
+	for (auto i = 0u; i < duration_v; ++i)
+	{
+		std::this_thread::sleep_for(1s);
+		std::cout << std::format("{} datagrams/s\n", sink_v.take());
+	}
+	return 0;
+}
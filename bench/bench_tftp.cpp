@@ -0,0 +1,219 @@
+#include <iostream>
+#include <format>
+#include <vector>
+#include <array>
+#include <span>
+#include <string>
+#include <optional>
+#include <limits>
+#include <charconv>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+#include "bench.hpp"
+
+using clock_type = std::chrono::steady_clock;
+
+static inline constexpr const std::uint16_t bench_opcode_rrq = 1u;
+static inline constexpr const std::uint16_t bench_opcode_data = 3u;
+static inline constexpr const std::uint16_t bench_opcode_ack = 4u;
+static inline constexpr const std::uint16_t bench_opcode_error = 5u;
+static inline constexpr const std::uint16_t bench_opcode_oack = 6u;
+
+/* retransmissions of the last ACK in a row before a transfer is given up */
+static inline constexpr const auto bench_max_timeouts = 10u;
+
+struct bench_transfer
+{
+	std::uint64_t		bytes{ 0u };
+	std::uint64_t		discarded{ 0u };	/* DATA that wasn't the next block, after a loss or a window sent again */
+	std::uint64_t		timeouts{ 0u };
+	double					seconds{ 0.0 };
+	std::string			error;
+	std::vector<std::uint32_t>	gaps;		/* microseconds between DATA of the same window, paced sends spread them out */
+};
+
+static auto bench_u16(std::span<const std::byte> bits_v, std::size_t offset_v) -> std::uint16_t
+{
+	return (std::uint16_t)((std::uint16_t(bits_v[offset_v]) << 8u) | std::uint16_t(bits_v[offset_v + 1u]));
+}
+
+/* the delay stands in for the round trip where netem isn't there to add one, the DATA meanwhile waits in the receive buffer */
+static void bench_ack(socket_udp const& socket_v, std::uint16_t block_v, address_v4 const& server_v, std::chrono::microseconds delay_v)
+{
+	if (delay_v.count() > 0)
+		std::this_thread::sleep_for(delay_v);
+	const std::array<std::byte, 4u> ack_v{ std::byte{ 0u }, std::byte{ bench_opcode_ack }, std::byte(block_v >> 8u), std::byte(block_v & 0xffu) };
+	std::span<const std::byte> bytes_v{ ack_v };
+	socket_v.send(bytes_v, server_v, 0);
+}
+
+/* value of `name` in an OACK, `default_v` when the server left it out */
+static auto bench_oack_value(std::span<const std::byte> bits_v, std::string_view name_v, std::uintmax_t default_v) -> std::uintmax_t
+{
+	const std::string_view text_v{ (const char*)bits_v.data() + 2u, bits_v.size() - 2u };
+	for (std::size_t offset_v = 0u; offset_v < text_v.size();)
+	{
+		const auto key_end_v = text_v.find('\0', offset_v);
+		if (key_end_v == std::string_view::npos)
+			break;
+		const auto value_end_v = text_v.find('\0', key_end_v + 1u);
+		const auto value_v = text_v.substr(key_end_v + 1u, value_end_v - key_end_v - 1u);
+		if (text_v.substr(offset_v, key_end_v - offset_v) == name_v)
+			std::from_chars(value_v.data(), value_v.data() + value_v.size(), default_v);
+		if (value_end_v == std::string_view::npos)
+			break;
+		offset_v = value_end_v + 1u;
+	}
+	return default_v;
+}
+
+/* one download, the client side of RFC 7440: an ACK at the end of each window, or right away to the last block in order after a gap */
+static auto bench_download(address_v4 const& server_v, std::string const& file_v, std::uintmax_t blksize_v, std::uintmax_t window_v, std::chrono::microseconds delay_v) -> bench_transfer
+{
+	using namespace std::chrono_literals;
+	using namespace std::string_view_literals;
+	bench_transfer result_v;
+	auto socket_v = socket_udp::make_unbound();
+	socket_v.receive_buffer(8 << 20);
+	socket_v.timeout_recv(1s);
+
+	std::string request_v{ '\0', (char)bench_opcode_rrq };
+	request_v += file_v + '\0' + "octet" + '\0';
+	if (blksize_v != 512u)
+		request_v += std::format("blksize{}{}{}", '\0', blksize_v, '\0');
+	if (window_v != 1u)
+		request_v += std::format("windowsize{}{}{}", '\0', window_v, '\0');
+	std::span<const std::byte> bytes_v{ (const std::byte*)request_v.data(), request_v.size() };
+
+	const auto start_v = clock_type::now();
+	socket_v.send(bytes_v, server_v, 0);
+	/* until the first answer the transfer has no server port yet, and without an OACK the server granted no option */
+	std::optional<address_v4> session_v;
+	auto granted_blksize_v = std::uintmax_t{ 512u };
+	auto granted_window_v = std::uintmax_t{ 1u };
+	std::uint16_t acked_v{ 0u };
+	std::uintmax_t in_window_v{ 0u };
+	bool gap_acked_v{ false };
+	auto arrived_v = clock_type::time_point{};
+	auto silent_v = 0u;
+	std::vector<std::byte> buffer_v(0x10000u);
+	while (true)
+	{
+		std::span<std::byte> bits_v{ buffer_v };
+		address_v4 source_v;
+		try
+		{ socket_v.recv(bits_v, source_v, 0); }
+		catch (error_socket_timed_out const&)
+		{
+			++result_v.timeouts;
+			if (++silent_v > bench_max_timeouts)
+			{
+				result_v.error = "timed out";
+				break;
+			}
+			if (session_v)
+				bench_ack(socket_v, acked_v, *session_v, delay_v);
+			else
+				socket_v.send(bytes_v, server_v, 0);
+			in_window_v = 0u;
+			continue;
+		}
+		if (bits_v.size() < 4u || (session_v && source_v != *session_v))
+			continue;
+		session_v = source_v;
+		silent_v = 0u;
+		const auto opcode_v = bench_u16(bits_v, 0u);
+		if (opcode_v == bench_opcode_error)
+		{
+			result_v.error = std::string((const char*)bits_v.data() + 4u, bits_v.size() - 4u);
+			break;
+		}
+		if (opcode_v == bench_opcode_oack)
+		{
+			granted_blksize_v = bench_oack_value(bits_v, "blksize"sv, 512u);
+			granted_window_v = bench_oack_value(bits_v, "windowsize"sv, 1u);
+			bench_ack(socket_v, 0u, source_v, delay_v);
+			continue;
+		}
+		if (opcode_v != bench_opcode_data)
+			continue;
+		if (bench_u16(bits_v, 2u) != (std::uint16_t)(acked_v + 1u))
+		{
+			++result_v.discarded;
+			if (!gap_acked_v)
+				bench_ack(socket_v, acked_v, source_v, delay_v);
+			gap_acked_v = true;
+			in_window_v = 0u;
+			continue;
+		}
+		const auto now_v = clock_type::now();
+		if (in_window_v > 0u)
+			result_v.gaps.push_back((std::uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(now_v - arrived_v).count());
+		arrived_v = now_v;
+		++acked_v;
+		gap_acked_v = false;
+		result_v.bytes += bits_v.size() - 4u;
+		const auto last_v = bits_v.size() - 4u < granted_blksize_v;
+		if (last_v || ++in_window_v >= granted_window_v)
+		{
+			bench_ack(socket_v, acked_v, source_v, delay_v);
+			in_window_v = 0u;
+		}
+		if (last_v)
+			break;
+	}
+	result_v.seconds = std::chrono::duration<double>(clock_type::now() - start_v).count();
+	return result_v;
+}
+
+auto bench_tftp(arguments& args) -> int
+{
+	using namespace std::string_view_literals;
+	const auto server_v = address_v4(args.value_or("-T"sv, "127.0.0.1:69"sv));
+	const auto file_v = std::string(args.value_or("-F"sv, ""sv));
+	const auto blksize_v = args.value_or("-B"sv, std::uintmax_t{ 1428u });
+	const auto window_v = args.value_or("-W"sv, std::uintmax_t{ 1u });
+	const auto clients_v = std::max(args.value_or("-N"sv, 1u), 1u);
+	const auto delay_v = std::chrono::microseconds(args.value_or("-R"sv, 0u));
+	if (file_v.empty())
+		throw std::invalid_argument("tftp needs the file to download, -F name.");
+
+	std::vector<bench_transfer> results_v(clients_v);
+	{
+		std::vector<std::jthread> threads_v;
+		for (auto i = 0u; i < clients_v; ++i)
+			threads_v.emplace_back([&, i] { results_v[i] = bench_download(server_v, file_v, blksize_v, window_v, delay_v); });
+	}
+
+	bench_transfer total_v;
+	auto slowest_v = std::numeric_limits<double>::max();
+	auto fastest_v = 0.0;
+	for (auto&& result_v : results_v)
+	{
+		if (!result_v.error.empty())
+			std::cout << std::format("transfer failed : {}\n", result_v.error);
+		total_v.bytes += result_v.bytes;
+		total_v.discarded += result_v.discarded;
+		total_v.timeouts += result_v.timeouts;
+		total_v.seconds = std::max(total_v.seconds, result_v.seconds);
+		total_v.gaps.insert(total_v.gaps.end(), result_v.gaps.begin(), result_v.gaps.end());
+		slowest_v = std::min(slowest_v, (double)result_v.bytes * 8.0 / result_v.seconds / 1e6);
+		fastest_v = std::max(fastest_v, (double)result_v.bytes * 8.0 / result_v.seconds / 1e6);
+	}
+	std::ranges::sort(total_v.gaps);
+	const auto gap_v = [&] (double fraction_v) -> std::uint32_t
+	{
+		if (total_v.gaps.empty())
+			return 0u;
+		return total_v.gaps[std::min(total_v.gaps.size() - 1u, (std::size_t)(fraction_v * (double)total_v.gaps.size()))];
+	};
+	std::cout << std::format("{} x {} from {}, blksize {}, windowsize {}, ACKs delayed {}us\n", clients_v, file_v, server_v.to_string(), blksize_v, window_v, delay_v.count());
+	std::cout << std::format("{} bytes in {:.3f} s, {:.1f} Mbit/s, {} blocks discarded, {} timeouts\n",
+		total_v.bytes, total_v.seconds, (double)total_v.bytes * 8.0 / total_v.seconds / 1e6, total_v.discarded, total_v.timeouts);
+	if (clients_v > 1u)
+		std::cout << std::format("slowest {:.1f} Mbit/s, fastest {:.1f} Mbit/s\n", slowest_v, fastest_v);
+	std::cout << std::format("DATA within a window {}us apart at the median, {}us at p99\n", gap_v(0.5), gap_v(0.99));
+	return 0;
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string_view>
+
+#include "bench.hpp"
+
+static void usage()
+{
+	std::cerr <<
+		"usage : bootpd_bench <mode> [options]\n"
+		"  gso   -T address:port [-S segment_size] [-B segments_per_send] [-D seconds]\n"
+		"  sink  -L address:port [-D seconds]\n"
+		"  tftp  -T address:port -F file [-B blksize] [-W windowsize] [-N clients] [-R ack_delay_us]\n"
+		"  dhcp  -T address:port [-L address:port] [-M mac] [-N discovers] [-W in_flight]\n";
+}
+
+int main(int argc, char** argv)
+{
+	using namespace std::string_view_literals;
+	try
+	{
+		arguments args(argc, argv);
+		const auto& positional_v = args.values(""sv);
+		const auto mode_v = positional_v.size() > 1u ? positional_v[1] : ""sv;
+		if (mode_v == "gso"sv)
+			return bench_gso(args);
+		if (mode_v == "sink"sv)
+			return bench_sink(args);
+		if (mode_v == "tftp"sv)
+			return bench_tftp(args);
+		if (mode_v == "dhcp"sv)
+			return bench_dhcp(args);
+		usage();
+		return 2;
+	}
+	catch (std::exception const& ex)
+	{
+		std::cerr << ex.what() << "\n";
+		return 1;
+	}
+}
@@ -21,3 +21,10 @@ static inline constexpr const std::uint8_t DHCP_OPCODE_RESPONSE = 2u;
 
 static inline constexpr const std::uint16_t DHCP_FLAGS_BROADCAST = 0x8000u;
 
+static inline constexpr const std::uint16_t DHCP_CLIENT_PORT = 68u;
+
+/* fixed field offsets into the BOOTP header */
+static inline constexpr const std::size_t DHCP_OFFSET_OPCODE = 0u;
+static inline constexpr const std::size_t DHCP_OFFSET_HARDWARE_ADDRESS = 28u;
+static inline constexpr const std::size_t DHCP_OFFSET_MAGIC_COOKIE = 236u;
+
@@ -1,6 +1,7 @@
 #include <string>
 #include <array>
 #include <format>
+#include <cstring>
 
 #include <common/socket_api.hpp>
 #include <common/byte_order.hpp>
@@ -186,12 +187,12 @@ auto dhcp_packet_v4::flags() const -> std::uint16_t
 
 auto dhcp_packet_v4::server_host_name() const -> std::string_view
 {
-	return { m_server_host_name, strnlen_s(m_server_host_name, sizeof(m_server_host_name)) };
+	return { m_server_host_name, strnlen(m_server_host_name, sizeof(m_server_host_name)) };
 }
 
 auto dhcp_packet_v4::boot_file_name() const -> std::string_view
 {
-	return { m_boot_file_name, strnlen_s(m_boot_file_name, sizeof(m_boot_file_name)) };
+	return { m_boot_file_name, strnlen(m_boot_file_name, sizeof(m_boot_file_name)) };
 }
 
 auto dhcp_packet_v4::message_type() const -> std::optional<std::uint8_t>
@@ -2,15 +2,39 @@
 #include <sstream>
 #include <format>
 #include <chrono>
+#include <charconv>
 
 #include <common/socket_error.hpp>
 #include <common/logger.hpp>
 #include <common/utility_case.hpp>
+#include <common/thread_affinity.hpp>
 
 #include "dhcp_consts_v4.hpp"
 #include "dhcp_server_v4.hpp"
 
+/* "00-1c-7e-35-ed-20" or "00:1c:7e:35:ed:20", as the client sections are named */
+static auto parse_mac_address(std::string_view text) -> std::optional<hardware_address_type>
+{
+	hardware_address_type mac_v{};
+	if (text.size() != mac_v.size() * 3u - 1u)
+		return std::nullopt;
+	for (auto i = 0u; i < mac_v.size(); ++i)
+	{
+		const auto digits_v = text.substr(i * 3u, 2u);
+		if (i > 0u && text[i * 3u - 1u] != '-' && text[i * 3u - 1u] != ':')
+			return std::nullopt;
+		if (std::from_chars(digits_v.data(), digits_v.data() + digits_v.size(), mac_v[i], 16).ptr != digits_v.data() + digits_v.size())
+			return std::nullopt;
+	}
+	return mac_v;
+}
+
 dhcp_server_v4::dhcp_server_v4()
+:	m_pool(POOL_SLOTS, POOL_SLOT_SIZE)
+{}
+
+dhcp_server_v4::worker_type::worker_type()
+:	pool(WORKER_POOL_SLOTS, POOL_SLOT_SIZE)
 {}
 
 dhcp_server_v4::dhcp_server_v4(config_ini const& cfg)
@@ -29,22 +53,102 @@ void dhcp_server_v4::initialize(config_ini const& cfg)
 	using namespace std::string_view_literals;
 	m_bind_address = address_v4(cfg.value_or("v4_bind_address"sv, "0.0.0.0"sv),
 		lexical_cast<uint16_t>(cfg.value_or("dhcp_listen_port"sv, "67"sv)));
+	m_worker_count = cfg.value_or("dhcp_workers"sv, 0u);
+	m_first_cpu = cfg.value_or("dhcp_first_cpu"sv, 0u);
+	m_busy_poll = cfg.value_or("dhcp_busy_poll"sv, 0);
+	/* a spinning thread answers what it receives itself, there is no responder to hand off to */
+	if (m_busy_poll > 0 && m_worker_count == 0u)
+		m_worker_count = 1u;
+	m_receive_buffer = cfg.value_or("dhcp_rcvbuf"sv, 0);
+	m_send_buffer = cfg.value_or("dhcp_sndbuf"sv, 0);
+	m_latency_stats = cfg.value_or("latency_stats"sv, false);
+	m_raw_interface = cfg.value_or("dhcp_raw_interface"sv, std::string());
+
+	const auto filter_v = cfg.value_or("dhcp_socket_filter"sv, std::string("bootrequest"));
+	if (filter_v == "none")
+		m_filter_mode = filter_mode::none;
+	else if (filter_v == "known_clients")
+		m_filter_mode = filter_mode::known_clients;
+	else if (filter_v == "bootrequest")
+		m_filter_mode = filter_mode::bootrequest;
+	else
+		Glog.warning("Unknown dhcp_socket_filter '{}', accepting only BOOTREQUEST packets.", filter_v);
 
-	for (auto&& client_mac : cfg.sections())
+	static constexpr const auto interface_prefix_v = "interface:"sv;
+	for (auto&& section_v : cfg.sections())
 	{
-		initialize_client(m_clients[std::string(client_mac)], cfg, lowercase(std::string(client_mac)));
+		if (section_v.starts_with(interface_prefix_v))
+		{
+			initialize_interface(cfg, section_v, section_v.substr(interface_prefix_v.size()));
+			continue;
+		}
+		/* TFTP scheduling classes, not clients */
+		if (section_v.starts_with("tftp_class:"sv))
+			continue;
+		initialize_client(m_clients[std::string(section_v)], cfg, lowercase(std::string(section_v)));
 	}
 }
 
 void dhcp_server_v4::start()
 {
 	using namespace std::chrono;
+	using namespace std::string_literals;
 	
+	if (!m_raw_interface.empty())
+	{
+		try
+		{
+			m_raw_socket = socket_packet(m_raw_interface);
+			Glog.info("* Unicasting DHCP replies as raw frames on '{}' ({}).", m_raw_interface, mac_address_to_string(m_raw_socket.hardware_address()));
+		}
+		catch (std::exception const& ex)
+		{ Glog.warning("* No raw reply path on '{}', broadcasting every reply : {}", m_raw_interface, ex.what()); }
+	}
+
+	for (auto&& [index_v, interface_v] : m_interfaces)
+		Glog.info("* Interface '{}' (#{}) served as {}.", interface_v.name, index_v, 
+			interface_v.server_address ? v4_address_to_string(interface_v.server_address) : "its own address"s);
+
+	if (m_worker_count > 0u)
+	{
+		Glog.info("Starting DHCP server, listening on '{}' with {} workers ... ", m_bind_address.to_string(), m_worker_count);
+		const auto cpu_count_v = available_cpu_count();
+		for (auto i = 0u; i < m_worker_count; ++i)
+		{
+			auto& worker_v = *m_workers.emplace_back(std::make_unique<worker_type>());
+			worker_v.socket = socket_udp::make_unbound();
+			worker_v.socket.option<so_reuseport>(so_true);
+			worker_v.socket.option<so_broadcast>(so_true);
+			configure_buffers(worker_v.socket);
+			enable_busy_poll(worker_v.socket);
+			worker_v.socket.bind(m_bind_address);
+			enable_timestamping(worker_v.socket);
+			enable_pktinfo(worker_v.socket);
+			attach_filter(worker_v.socket);
+			try
+			{ worker_v.socket.option<so_incoming_cpu>((std::int32_t)((m_first_cpu + i) % cpu_count_v)); }
+			catch (std::exception const& ex)
+			{ Glog.warning("SO_INCOMING_CPU not available : {}", ex.what()); }
+			worker_v.socket.timeout_idle(500ms);
+		}
+		for (auto i = 0u; i < m_worker_count; ++i)
+		{
+			auto& worker_v = *m_workers[i];
+			worker_v.thread = std::jthread([this, &worker_v, cpu_v = (m_first_cpu + i) % cpu_count_v](auto&& t){ thread_worker (t, worker_v, cpu_v); });
+		}
+		std::this_thread::sleep_for(10ms);
+		return;
+	}
+
 	Glog.info("Starting DHCP server, listening on '{}' ... ", m_bind_address.to_string());
 	
 	m_socket = m_bind_address.make_udp();
 	m_socket.option<so_broadcast>(so_true);
-	m_socket.timeout(500ms);		
+	m_socket.timeout_idle(500ms);		
+	configure_buffers(m_socket);
+	enable_timestamping(m_socket);
+	enable_pktinfo(m_socket);
+	attach_filter(m_socket);
 	m_thread_incoming = std::jthread([this](auto&& t){ thread_incoming (t); });	
 	m_thread_outgoing = std::jthread([this](auto&& t){ thread_outgoing (t); });
 	std::this_thread::sleep_for(10ms);
@@ -55,30 +159,196 @@ void dhcp_server_v4::cease()
 	Glog.info("Stopping DHCP server ... ");
 	m_thread_incoming.request_stop();
 	m_thread_outgoing.request_stop();
+	for (auto&& worker_v : m_workers)
+		worker_v->thread.request_stop();
 	if (m_thread_incoming.joinable())
 		m_thread_incoming.join();
 	if (m_thread_outgoing.joinable())
 		m_thread_outgoing.join();
+	for (auto&& worker_v : m_workers)
+		if (worker_v->thread.joinable())
+			worker_v->thread.join();
+
+	const auto pool_v = m_pool.statistics();
+	Glog.info("* Packet pool: {} packets, peak {} of {} slots in use, {} heap fallbacks.", 
+		pool_v.acquired, pool_v.peak_in_use, m_pool.slot_count(), pool_v.heap_fallbacks);
+	for (auto i = 0u; i < m_workers.size(); ++i)
+	{
+		const auto worker_pool_v = m_workers[i]->pool.statistics();
+		Glog.info("* Worker {} packet pool: {} packets, peak {} of {} slots in use, {} heap fallbacks.", 
+			i, worker_pool_v.acquired, worker_pool_v.peak_in_use, m_workers[i]->pool.slot_count(), worker_pool_v.heap_fallbacks);
+	}
+
+	if (m_filter_mode != filter_mode::none)
+	{
+		auto dropped_v = m_socket.drop_count().value_or(0u);
+		for (auto&& worker_v : m_workers)
+			dropped_v += worker_v->socket.drop_count().value_or(0u);
+		Glog.info("* Socket filter: {} packets accepted, {} dropped in the kernel (filtered or receive queue full).", m_received.load(), dropped_v);
+	}
+	if (m_socket.native_handle() != v4_socket_make_invalid())
+		log_socket("Socket", m_socket);
+	for (auto i = 0u; i < m_workers.size(); ++i)
+		log_socket(std::format("Worker {} socket", i), m_workers[i]->socket);
+	m_workers.clear();
+	dump_latency();
+}
+
+void dhcp_server_v4::attach_filter(socket_udp const& socket_v)
+{
+	if (m_filter_mode == filter_mode::none)
+		return;
+	if (!socket_v.attach_filter(make_filter()))
+		Glog.warning("* Socket filter not available, every datagram is checked in userspace.");
+}
+
+auto dhcp_server_v4::make_filter() const -> socket_filter_program
+{
+	using namespace socket_filter;
+	/* the filter sees the UDP header first, offsets below are into the BOOTP payload */
+	static constexpr const auto udp_v = 8u;
+	/* BPF_MAXINSNS */
+	static constexpr const auto max_instructions_v = 4096u;
+
+	socket_filter_program program_v
+	{
+		statement(load_byte, udp_v + DHCP_OFFSET_OPCODE),
+		jump(jump_equal, DHCP_OPCODE_REQUEST, 1u, 0u),
+		statement(ret, drop),
+		statement(load_word, udp_v + DHCP_OFFSET_MAGIC_COOKIE),
+		jump(jump_equal, DHCP_MAGIC_COOKIE, 1u, 0u),
+		statement(ret, drop)
+	};
+
+	if (m_filter_mode == filter_mode::known_clients)
+	{
+		socket_filter_program clients_v;
+		for (auto&& [client_mac, params_v] : m_clients)
+		{
+			const auto mac_v = parse_mac_address(client_mac);
+			if (!mac_v)
+				continue;
+			const auto& m = *mac_v;
+			/* each client gets its own accept, so no jump ever has to reach further than the next few instructions */
+			clients_v.insert(clients_v.end(),
+			{
+				statement(load_word, udp_v + DHCP_OFFSET_HARDWARE_ADDRESS),
+				jump(jump_equal, (std::uint32_t)m[0] << 24u | (std::uint32_t)m[1] << 16u | (std::uint32_t)m[2] << 8u | m[3], 0u, 3u),
+				statement(load_half, udp_v + DHCP_OFFSET_HARDWARE_ADDRESS + 4u),
+				jump(jump_equal, (std::uint32_t)m[4] << 8u | m[5], 0u, 1u),
+				statement(ret, accept)
+			});
+		}
+		if (program_v.size() + clients_v.size() + 1u <= max_instructions_v)
+		{
+			program_v.insert(program_v.end(), clients_v.begin(), clients_v.end());
+			program_v.push_back(statement(ret, drop));
+			return program_v;
+		}
+		Glog.warning("* Too many clients for the socket filter, accepting every BOOTREQUEST.");
+	}
+	program_v.push_back(statement(ret, accept));
+	return program_v;
+}
+
+void dhcp_server_v4::enable_timestamping(socket_udp const& socket_v)
+{
+	if (m_latency_stats && !socket_v.timestamping_enable())
+		Glog.warning("* SO_TIMESTAMPING not available, kernel and send latency won't be measured.");
+}
+
+void dhcp_server_v4::enable_pktinfo(socket_udp const& socket_v)
+{
+	/* bound to one address there is only one interface to serve, nothing to learn per packet */
+	if (m_bind_address.addr() != 0u)
+		return;
+	m_pktinfo = socket_v.pktinfo_enable();
+	if (!m_pktinfo)
+		Glog.warning("* IP_PKTINFO not available, replies leave through the interface of the default route.");
+}
+
+void dhcp_server_v4::configure_buffers(socket_udp const& socket_v)
+{
+	const auto receive_v = socket_v.receive_buffer(m_receive_buffer);
+	const auto send_v = socket_v.send_buffer(m_send_buffer);
+	if (receive_v < m_receive_buffer || send_v < m_send_buffer)
+		Glog.warning("* Socket buffers capped at {}/{} bytes, raise net.core.rmem_max/wmem_max or run with CAP_NET_ADMIN.", receive_v, send_v);
+	if (!socket_v.overflow_enable())
+		Glog.warning("* SO_RXQ_OVFL not available, packets dropped in the kernel won't be reported as they happen.");
+}
+
+void dhcp_server_v4::enable_busy_poll(socket_udp const& socket_v)
+{
+	if (m_busy_poll <= 0)
+		return;
+	/* above net.core.busy_read this needs CAP_NET_ADMIN, spinning on the socket still works without it */
+	try
+	{ 
+		socket_v.option<so_busy_poll>(m_busy_poll);
+		socket_v.option<so_prefer_busy_poll>(so_true);
+	}
+	catch (std::exception const& ex)
+	{ Glog.warning("* SO_BUSY_POLL not available, spinning without polling the device queue : {}", ex.what()); }
+}
+
+void dhcp_server_v4::count_dropped(std::uint32_t& seen_v, std::uint32_t dropped_v) const
+{
+	/* the counter is cumulative and includes what the socket filter rejected, only the growth is news */
+	if (dropped_v <= seen_v)
+		return;
+	Glog.warning("{} packets dropped in the kernel since the last DHCP packet (socket filter or full receive buffer, see dhcp_rcvbuf).", dropped_v - seen_v);
+	seen_v = dropped_v;
+}
+
+void dhcp_server_v4::log_socket(std::string_view name_v, socket_udp const& socket_v) const
+{
+	Glog.info("* {}: {} byte receive buffer, {} byte send buffer, {} packets dropped in the kernel.", name_v,
+		socket_v.option<so_rcvbuf>(), socket_v.option<so_sndbuf>(), socket_v.drop_count().value_or(0u));
+}
+
+void dhcp_server_v4::dump_latency() const
+{
+	if (m_latency_stats)
+		m_latency.dump("DHCP");
 }
 
 void dhcp_server_v4::thread_incoming(std::stop_token st)
 {
 	using namespace std::chrono_literals;
 	Glog.info("* Receiver thread started.");	
+	const auto interrupt_v = socket_reactor::this_thread().interrupt_on(st);
+
+	std::array<packet_buffer, MAX_BATCH> buffers_v;
+	std::array<address_v4, MAX_BATCH> sources_v;
+	std::array<socket_datagram_info, MAX_BATCH> infos_v;
+	std::uint32_t dropped_v{ 0u };
+	std::vector<packet_queue_type::value_type> packets_v;
+	packets_v.reserve(MAX_BATCH);
+
 	while (!st.stop_requested())
 	{
 		try
 		{
-			auto [source, packet] = m_socket.recv(0);
-			if (packet.size() < 1)
+			for (auto&& buffer_v : buffers_v)
+				if (!buffer_v) buffer_v = m_pool.acquire();
+			const auto count_v = m_socket.recv_batch(std::nothrow, buffers_v, sources_v, infos_v, 0);
+			if (!count_v)
+			{
+				if (count_v.error() != std::errc::timed_out)
+					Glog.error("Failed to receive DHCP packets, {}.", count_v.error().message());
 				continue;
-			Glog.info("Received {} bytes from '{}'.", packet.size(), source.to_string());
-			m_packets.push(std::tuple{ std::move(source), std::move(packet) });
+			}
+			m_received.fetch_add(*count_v, std::memory_order_relaxed);
+			count_dropped(dropped_v, infos_v[*count_v - 1u].dropped);
+			for (auto i = 0u; i < *count_v; ++i)
+			{
+				if (buffers_v[i].size() < 1)
+					continue;
+				Glog.info("Received {} bytes from '{}'.", buffers_v[i].size(), sources_v[i].to_string());
+				packets_v.emplace_back(sources_v[i], std::move(buffers_v[i]), received_times(infos_v[i].timestamp), infos_v[i].local);
+			}
+			m_packets.push_batch(packets_v);
 		}
-		catch (error_socket_timed_out const& e)
-		{ continue; }
-		catch (error_stop_requested const& e)
-		{ break; }
 		catch (std::exception& ex)
 		{
 			Glog.error("{}", ex.what());
@@ -92,50 +362,232 @@ void dhcp_server_v4::thread_outgoing(std::stop_token st)
 	using namespace std::string_literals;
 	
 	Glog.info("* Responder thread started.");
+
+	std::vector<packet_queue_type::value_type> packets_v;
+	reply_batch_type batch_v;
+
 	while (!st.stop_requested())
 	{
 		try
 		{
-			auto [source, packet_bits] = m_packets.pop(st);			
-			dhcp_packet_v4 packet_v(packet_bits);
+			packets_v.clear();
+			if (const auto popped_v = m_packets.pop_batch(std::nothrow, packets_v, MAX_BATCH, st); !popped_v)
+			{
+				if (popped_v.error() == std::errc::operation_canceled)
+					break;
+				continue;
+			}
+			respond(m_socket, packets_v, batch_v);
+		}
+		catch (std::exception const& ex)
+		{
+			Glog.error("{}", ex.what());
+		}
+	}
+	Glog.info("* Responder thread stopped.");
+}
+
+void dhcp_server_v4::thread_worker(std::stop_token st, worker_type& worker_v, unsigned cpu_v)
+{
+	if (!this_thread_pin_to(cpu_v))
+		Glog.warning("* Failed to pin DHCP worker to CPU {}.", cpu_v);
+	if (m_busy_poll > 0)
+		Glog.info("* Worker thread started on CPU {}, busy polling.", cpu_v);
+	else
+		Glog.info("* Worker thread started on CPU {}.", cpu_v);
+	const auto interrupt_v = socket_reactor::this_thread().interrupt_on(st);
 
-			if (packet_v.opcode() != DHCP_OPCODE_REQUEST)
+	std::array<packet_buffer, MAX_BATCH> buffers_v;
+	std::array<address_v4, MAX_BATCH> sources_v;
+	std::array<socket_datagram_info, MAX_BATCH> infos_v;
+	std::uint32_t dropped_v{ 0u };
+	std::vector<packet_queue_type::value_type> packets_v;
+	reply_batch_type batch_v;
+	packets_v.reserve(MAX_BATCH);
+
+	while (!st.stop_requested())
+	{
+		try
+		{
+			packets_v.clear();
+			for (auto&& buffer_v : buffers_v)
+				if (!buffer_v) buffer_v = worker_v.pool.acquire();
+			const auto count_v = m_busy_poll > 0
+				? worker_v.socket.poll_batch(std::nothrow, buffers_v, sources_v, infos_v, 0)
+				: worker_v.socket.recv_batch(std::nothrow, buffers_v, sources_v, infos_v, 0);
+			if (!count_v)
+			{
+				if (count_v.error() != std::errc::timed_out)
+					Glog.error("Failed to receive DHCP packets, {}.", count_v.error().message());
+				continue;
+			}
+			if (*count_v == 0u)
 				continue;
-			
-			if (packet_v.is_message_type(DHCP_MESSAGE_TYPE_DISCOVER) 
-			  ||packet_v.is_message_type(DHCP_MESSAGE_TYPE_REQUEST))
+			m_received.fetch_add(*count_v, std::memory_order_relaxed);
+			count_dropped(dropped_v, infos_v[*count_v - 1u].dropped);
+			for (auto i = 0u; i < *count_v; ++i)
 			{
-				const auto mac_address_v = lowercase(mac_address_to_string (packet_v.hardware_address()));				
-				
-				if (!m_clients.count(mac_address_v))
-					throw std::runtime_error("No configuration found for client : "s + mac_address_v);
-
-				const auto& offer_params_v = m_clients.at(mac_address_v);
-				auto offer_packet_v = make_offer (packet_v, offer_params_v);
-				
-				if (packet_v.is_message_type(DHCP_MESSAGE_TYPE_DISCOVER)) {
-					Glog.info("Responding to '{}' (transaction {:#08x}) DHCP.DISCOVER packet with DHCP.OFFER packet.", source.to_string(), packet_v.transaction_id());
-					offer_packet_v.message_type(DHCP_MESSAGE_TYPE_OFFER);
-				}
-				else if (packet_v.is_message_type(DHCP_MESSAGE_TYPE_REQUEST)) {
-					Glog.info("Responding to '{}' (transaction {:#08x}) DHCP.REQUEST packet with DHCP.ACK packet.", source.to_string(), packet_v.transaction_id());
-					offer_packet_v.message_type(DHCP_MESSAGE_TYPE_ACK);
-				}
+				if (buffers_v[i].size() < 1)
+					continue;
+				Glog.info("Received {} bytes from '{}'.", buffers_v[i].size(), sources_v[i].to_string());
+				packets_v.emplace_back(sources_v[i], std::move(buffers_v[i]), received_times(infos_v[i].timestamp), infos_v[i].local);
+			}
+			respond(worker_v.socket, packets_v, batch_v);
+		}
+		catch (std::exception const& ex)
+		{
+			Glog.error("{}", ex.what());
+		}
+	}
+	Glog.info("* Worker thread stopped.");
+}
+
+void dhcp_server_v4::respond(socket_udp const& socket_v, std::span<const packet_queue_type::value_type> packets_v, reply_batch_type& batch_v) const
+{
+	using std::chrono::system_clock;
 
-				m_socket.send(offer_packet_v, address_v4::everyone().port(source.port()), 0u);
-				continue;	
-			}								
+	batch_v.replies.clear();
+	batch_v.buffers.clear();
+	batch_v.targets.clear();
+	batch_v.sources.clear();
+	batch_v.frames.clear();
+
+	for (auto&& [source, packet_bits, times, local] : packets_v)
+	{
+		try
+		{
+			const auto started_v = m_latency_stats ? system_clock::now() : socket_timestamp{};
+			m_latency.queue.record(times.received, started_v);
+			if (auto reply_v = make_reply(source, local, packet_bits.bytes()); reply_v.has_value())
+			{
+				auto reply_bits_v = serialize_to_vector(*reply_v);
+				if (wants_unicast(source, local, *reply_v))
+					batch_v.frames.emplace_back(unicast_frame(source, local, *reply_v, reply_bits_v));
+				else
+				{
+					batch_v.replies.emplace_back(std::move(reply_bits_v));
+					batch_v.targets.emplace_back(address_v4::everyone().port(source.port()));
+					batch_v.sources.emplace_back(local);
+				}
+			}
+			if (m_latency_stats)
+				m_latency.process.record(started_v, system_clock::now());
 		}
-		catch (error_socket_timed_out const& e)
-		{ continue; }
-		catch (error_stop_requested const& e)
-		{ break; }
 		catch (std::exception const& ex)
 		{
 			Glog.error("{}", ex.what());
 		}
 	}
-	Glog.info("* Responder thread stopped.");
+	
+	if (!batch_v.frames.empty())
+	{
+		batch_v.frame_buffers.assign(batch_v.frames.begin(), batch_v.frames.end());
+		try
+		{ m_raw_socket.send_batch(batch_v.frame_buffers); }
+		catch (std::exception const& ex)
+		{ Glog.error("Failed to unicast DHCP replies, {}.", ex.what()); }
+	}
+
+	batch_v.buffers.assign(batch_v.replies.begin(), batch_v.replies.end());
+	if (!m_latency_stats)
+	{
+		if (const auto sent_v = socket_v.send_batch(std::nothrow, batch_v.buffers, batch_v.targets, batch_v.sources, 0u); !sent_v)
+			Glog.error("Failed to send DHCP replies, {}.", sent_v.error().message());
+		return;
+	}
+
+	/* stamps left over from an earlier batch would be measured against the wrong start */
+	batch_v.transmitted.resize(MAX_BATCH);
+	while (socket_v.timestamping_reap(batch_v.transmitted) > 0u)
+		;
+	const auto sending_v = system_clock::now();
+	if (const auto sent_v = socket_v.send_batch(std::nothrow, batch_v.buffers, batch_v.targets, batch_v.sources, 0u); !sent_v)
+		Glog.error("Failed to send DHCP replies, {}.", sent_v.error().message());
+	const auto stamped_v = socket_v.timestamping_reap(batch_v.transmitted);
+	for (auto i = 0u; i < stamped_v; ++i)
+		m_latency.send.record(sending_v, batch_v.transmitted[i]);
+}
+
+auto dhcp_server_v4::wants_unicast(address_v4 const& source, socket_local const& local, dhcp_packet_v4 const& reply_v) const -> bool
+{
+	/* RFC 2131 4.1, broadcast only if the client asked for it, relayed requests go back through the UDP socket */
+	return m_raw_socket
+		&& (local.interface == 0u || local.interface == m_raw_socket.interface_index())
+		&& !(reply_v.flags() & DHCP_FLAGS_BROADCAST)
+		&& source.port() == DHCP_CLIENT_PORT
+		&& reply_v.your_address() != 0u
+		&& reply_v.hardware_address().size() == std::tuple_size_v<hardware_address_type>;
+}
+
+auto dhcp_server_v4::unicast_frame(address_v4 const& source, socket_local const& local, dhcp_packet_v4 const& reply_v, std::span<const std::byte> reply_bits) const -> std::vector<std::byte>
+{
+	hardware_address_type target_mac_v;
+	std::ranges::copy(reply_v.hardware_address(), target_mac_v.begin());
+	/* bound to any, the local address of the request or else the server address handed out is the best guess at ours */
+	const auto server_v = m_bind_address.addr() ? m_bind_address.addr() : (local.address ? local.address : reply_v.server_address());
+	std::vector<std::byte> frame_v(udp_frame_overhead + reply_bits.size());
+	make_udp_frame(frame_v, 
+		m_raw_socket.hardware_address(), address_v4(server_v, m_bind_address.port()), 
+		target_mac_v, address_v4(reply_v.your_address(), source.port()), 
+		reply_bits);
+	return frame_v;
+}
+
+auto dhcp_server_v4::received_times(socket_timestamp kernel_v) const -> packet_times
+{
+	if (!m_latency_stats)
+		return {};
+	const auto received_v = std::chrono::system_clock::now();
+	m_latency.kernel.record(kernel_v, received_v);
+	return { kernel_v, received_v };
+}
+
+auto dhcp_server_v4::make_reply(address_v4 const& source, socket_local const& local, std::span<const std::byte> packet_bits) const -> std::optional<dhcp_packet_v4>
+{
+	using namespace std::string_literals;
+
+	dhcp_packet_v4 packet_v(packet_bits);
+
+	if (packet_v.opcode() != DHCP_OPCODE_REQUEST)
+		return std::nullopt;
+	
+	if (!packet_v.is_message_type(DHCP_MESSAGE_TYPE_DISCOVER) 
+	  &&!packet_v.is_message_type(DHCP_MESSAGE_TYPE_REQUEST))
+		return std::nullopt;
+
+	const auto mac_address_v = lowercase(mac_address_to_string (packet_v.hardware_address()));				
+	
+	if (!m_clients.count(mac_address_v))
+		throw std::runtime_error("No configuration found for client : "s + mac_address_v);
+
+	const auto& client_params_v = m_clients.at(mac_address_v);
+	const auto interface_it = m_interfaces.find(local.interface);
+	if (interface_it == m_interfaces.end())
+		return make_response(source, packet_v, client_params_v);
+
+	/* the interface section wins over the client section, the server is whatever address the request reached */
+	const auto& interface_v = interface_it->second;
+	auto offer_params_v = client_params_v;
+	offer_params_v.server_address = interface_v.server_address ? interface_v.server_address : local.address;
+	offer_params_v.dhcp_options.set(0x36u, offer_params_v.server_address);
+	for (auto&& code_v : { 0x01u, 0x03u, 0x07u, 0x36u })
+		offer_params_v.dhcp_options.assign((std::uint8_t)code_v, interface_v.dhcp_options);
+	return make_response(source, packet_v, offer_params_v);
+}
+
+auto dhcp_server_v4::make_response(address_v4 const& source, dhcp_packet_v4 const& packet_v, offer_params const& offer_params_v) const -> dhcp_packet_v4
+{
+	auto offer_packet_v = make_offer (packet_v, offer_params_v);
+	
+	if (packet_v.is_message_type(DHCP_MESSAGE_TYPE_DISCOVER)) {
+		Glog.info("Responding to '{}' (transaction {:#08x}) DHCP.DISCOVER packet with DHCP.OFFER packet.", source.to_string(), packet_v.transaction_id());
+		offer_packet_v.message_type(DHCP_MESSAGE_TYPE_OFFER);
+	}
+	else if (packet_v.is_message_type(DHCP_MESSAGE_TYPE_REQUEST)) {
+		Glog.info("Responding to '{}' (transaction {:#08x}) DHCP.REQUEST packet with DHCP.ACK packet.", source.to_string(), packet_v.transaction_id());
+		offer_packet_v.message_type(DHCP_MESSAGE_TYPE_ACK);
+	}
+	return offer_packet_v;
 }
 
 void dhcp_server_v4::initialize_client(offer_params& params_v, config_ini const& cfg, std::string_view client_mac)
@@ -165,14 +617,39 @@ void dhcp_server_v4::initialize_client(offer_params& params_v, config_ini const&
 	params_v.dhcp_options.set(0x43u, params_v.boot_file_name);	
 }
 
-auto dhcp_server_v4::make_offer(dhcp_packet_v4 const& source_v, offer_params const& params_v) -> dhcp_packet_v4
+void dhcp_server_v4::initialize_interface(config_ini const& cfg, std::string_view section, std::string_view interface_name)
+{
+	using namespace std::string_view_literals;
+
+	const auto index_v = v4_interface_index(interface_name);
+	if (index_v == 0u)
+	{
+		Glog.warning("Unknown network interface '{}', ignoring [{}].", interface_name, section);
+		return;
+	}
+
+	config_ini::section_type iface(section);
+	auto& params_v = m_interfaces[index_v];
+	params_v.name = interface_name;
+	params_v.server_address = v4_parse_address(cfg.value_or(iface["v4_server_address"sv], "0.0.0.0"sv));
+	if (const auto mask_v = cfg.value(iface["v4_subnet_mask"sv]); mask_v)
+		params_v.dhcp_options.set(0x01u, v4_parse_address(*mask_v));
+	if (const auto router_v = cfg.value(iface["v4_router_address"sv]); router_v)
+		params_v.dhcp_options.set(0x03u, v4_parse_address(*router_v));
+	if (const auto log_v = cfg.value(iface["v4_log_server_address"sv]); log_v)
+		params_v.dhcp_options.set(0x07u, v4_parse_address(*log_v));
+	if (const auto dhcp_v = cfg.value(iface["v4_dhcp_server_address"sv]); dhcp_v)
+		params_v.dhcp_options.set(0x36u, v4_parse_address(*dhcp_v));
+}
+
+auto dhcp_server_v4::make_offer(dhcp_packet_v4 const& source_v, offer_params const& params_v) const -> dhcp_packet_v4
 {
 	return (dhcp_packet_v4()
 		.opcode(DHCP_OPCODE_RESPONSE)
 		.hardware_type(DHCP_HARDWARE_TYPE_ETHERNET)
 		.hardware_address(source_v.hardware_address())
 		.number_of_hops(0)
-		.flags(DHCP_FLAGS_BROADCAST)
+		.flags(m_raw_socket ? (source_v.flags() & DHCP_FLAGS_BROADCAST) : DHCP_FLAGS_BROADCAST)
 		.seconds_elapsed(source_v.seconds_elapsed())
 		.transaction_id(source_v.transaction_id())
 		.client_address(params_v.client_address)
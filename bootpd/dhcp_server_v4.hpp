@@ -2,19 +2,42 @@
 
 #include <thread>
 #include <mutex>
+#include <array>
+#include <span>
+#include <vector>
+#include <optional>
+#include <memory>
+#include <atomic>
+#include <unordered_map>
 
 #include <common/config_ini.hpp>
 #include <common/lexical_cast.hpp>
 #include <common/concurrent_queue.hpp>
 #include <common/address_v4.hpp>
 #include <common/socket_udp.hpp>
+#include <common/packet_pool.hpp>
+#include <common/latency_histogram.hpp>
+#include <common/socket_packet.hpp>
 
 #include "dhcp_options_v4.hpp"
 #include "dhcp_packet_v4.hpp"
 
 struct dhcp_server_v4
 {
-	using packet_queue_type = concurrent_queue<std::tuple<address_v4, std::vector<std::byte>>>;
+	static inline const constexpr auto MAX_BATCH = 16u;
+	static inline const constexpr auto POOL_SLOTS = 256u;
+	static inline const constexpr auto POOL_SLOT_SIZE = 0x2400u;
+	static inline const constexpr auto WORKER_POOL_SLOTS = 64u;
+
+	using packet_queue_type = concurrent_queue<std::tuple<address_v4, packet_buffer, packet_times, socket_local>>;
+
+	/* what the in-kernel socket filter lets through to userspace */
+	enum struct filter_mode
+	{
+		none,						/* everything */
+		bootrequest,		/* op = BOOTREQUEST with the DHCP magic cookie */
+		known_clients		/* same, and only hardware addresses with a section in the config */
+	};
 	
 	dhcp_server_v4();
 	dhcp_server_v4(config_ini const&);
@@ -24,6 +47,9 @@ struct dhcp_server_v4
 
 	void start();
 	void cease();
+
+	/* logs the latency histograms, when enabled with `latency_stats` */
+	void dump_latency() const;
 	
 
 protected:
@@ -39,19 +65,86 @@ protected:
 	};	
 	
 	using client_map_type = std::unordered_map<std::string, offer_params>;
+
+	/* [interface:NAME] section, overrides the server identity for clients on that interface */
+	struct interface_params
+	{
+		std::string				name;
+		std::uint32_t			server_address;		/* 0 = the local address the request arrived on */
+		dhcp_options_v4		dhcp_options;			/* only the options the section sets */
+	};
+
+	using interface_map_type = std::unordered_map<std::uint32_t, interface_params>;
+
+	/* scratch space for one batch of replies, kept per thread to avoid reallocating */
+	struct reply_batch_type
+	{
+		std::vector<std::vector<std::byte>>			replies;
+		std::vector<std::span<const std::byte>>	buffers;
+		std::vector<address_v4>									targets;
+		std::vector<socket_local>								sources;
+		std::vector<socket_timestamp>						transmitted;
+		std::vector<std::vector<std::byte>>			frames;
+		std::vector<std::span<const std::byte>>	frame_buffers;
+	};
+
+	/* SO_REUSEPORT shard, receives, decides and replies on its own core */
+	struct worker_type
+	{
+		worker_type();
+
+		socket_udp		socket;
+		packet_pool		pool;
+		std::jthread	thread;
+	};
 	
 	void initialize_client(offer_params& client_v, config_ini const& cfg, std::string_view client_mac);
-	auto make_offer(dhcp_packet_v4 const& packet, offer_params const& client_v) -> dhcp_packet_v4;
+	void initialize_interface(config_ini const& cfg, std::string_view section, std::string_view interface_name);
+	auto make_offer(dhcp_packet_v4 const& packet, offer_params const& client_v) const -> dhcp_packet_v4;
+	auto make_reply(address_v4 const& source, socket_local const& local, std::span<const std::byte> packet_bits) const -> std::optional<dhcp_packet_v4>;
+	auto make_response(address_v4 const& source, dhcp_packet_v4 const& packet_v, offer_params const& offer_params_v) const -> dhcp_packet_v4;
+	void respond(socket_udp const& socket_v, std::span<const packet_queue_type::value_type> packets_v, reply_batch_type& batch_v) const;
+
+	/* the reply goes out as a unicast Ethernet frame through m_raw_socket, see unicast_frame() */
+	auto wants_unicast(address_v4 const& source, socket_local const& local, dhcp_packet_v4 const& reply_v) const -> bool;
+	auto unicast_frame(address_v4 const& source, socket_local const& local, dhcp_packet_v4 const& reply_v, std::span<const std::byte> reply_bits) const -> std::vector<std::byte>;
+
+	/* records the kernel to userspace latency of a datagram that was just received */
+	auto received_times(socket_timestamp kernel_v) const -> packet_times;
 	
 private:
 	void thread_incoming(std::stop_token st);
 	void thread_outgoing(std::stop_token st);
+	void thread_worker(std::stop_token st, worker_type& worker_v, unsigned cpu_v);
+	void enable_timestamping(socket_udp const& socket_v);
+	void attach_filter(socket_udp const& socket_v);
+	void enable_pktinfo(socket_udp const& socket_v);
+	void configure_buffers(socket_udp const& socket_v);
+	void enable_busy_poll(socket_udp const& socket_v);
+	void count_dropped(std::uint32_t& seen_v, std::uint32_t dropped_v) const;
+	void log_socket(std::string_view name_v, socket_udp const& socket_v) const;
+	auto make_filter() const -> socket_filter_program;
 	
 
 	socket_udp					m_socket;	
+	packet_pool					m_pool;
 	packet_queue_type		m_packets;
 	address_v4					m_bind_address;
 	client_map_type     m_clients;
+	interface_map_type	m_interfaces;
+	bool								m_pktinfo{ false };
+	unsigned						m_worker_count{ 0u };
+	unsigned						m_first_cpu{ 0u };
+	std::int32_t				m_busy_poll{ 0 };
+	std::int32_t				m_receive_buffer{ 0 };
+	std::int32_t				m_send_buffer{ 0 };
+	bool								m_latency_stats{ false };
+	std::string					m_raw_interface;
+	filter_mode					m_filter_mode{ filter_mode::bootrequest };
+	std::atomic<std::uint64_t>	m_received{ 0u };
+	socket_packet				m_raw_socket;
+	mutable packet_latency	m_latency;
+	std::vector<std::unique_ptr<worker_type>> m_workers;
 	std::jthread				m_thread_incoming;
 	std::jthread				m_thread_outgoing;
 };
@@ -61,6 +61,11 @@ int main(int argc, char** argv)
     {
       using namespace std::chrono_literals;
       std::this_thread::sleep_for(1s);
+      if (control_c::dump_requested())
+      {
+        dhcp_server_v.dump_latency();
+        tftp_server_v.dump_latency();
+      }
     }
     return 0;
   }
@@ -74,6 +79,8 @@ int main(int argc, char** argv)
     Glog.debug("current_path : {}"sv, std::filesystem::current_path().string());
     Glog.fatal("Unknown unhandled exception");
   }
+#if defined(_WIN32)
   system("pause");
+#endif
   return -1;
 }
@@ -6,3 +6,8 @@ static inline constexpr const std::uint16_t TFTP_OPCODE_DATA = 3;
 static inline constexpr const std::uint16_t TFTP_OPCODE_ACK = 4;
 static inline constexpr const std::uint16_t TFTP_OPCODE_ERROR = 5;
 static inline constexpr const std::uint16_t TFTP_OPCODE_OACK = 6;
+
+/* RFC 2348, the largest also leaves the DATA datagram within a 64 KiB IPv4 packet (65507 bytes of UDP payload) */
+static inline constexpr const std::uintmax_t TFTP_MIN_BLKSIZE = 8u;
+static inline constexpr const std::uintmax_t TFTP_MAX_BLKSIZE = 65464u;
+static_assert(TFTP_MAX_BLKSIZE + 4u <= 65507u);
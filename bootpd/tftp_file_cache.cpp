@@ -0,0 +1,202 @@
+#include <fstream>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+
+#include <common/logger.hpp>
+#include <common/read_only_file.hpp>
+
+#include "tftp_file_cache.hpp"
+#include "tftp_consts.hpp"
+
+static inline constexpr const std::uintmax_t tftp_header_size = 4u;
+
+tftp_file_cache::tftp_file_cache(std::uintmax_t budget)
+:	m_budget{ budget }
+{}
+
+tftp_file_cache::~tftp_file_cache()
+{
+	cease();
+}
+
+void tftp_file_cache::start(unsigned threads)
+{
+	for (auto i = 0u; i < std::max(threads, 1u); ++i)
+		m_loaders.emplace_back([this](auto&& st){ thread_loader (st); });
+}
+
+/* loads still queued are dropped, their entries stay failed until evicted */
+void tftp_file_cache::cease()
+{
+	for (auto&& thread_v : m_loaders)
+		thread_v.request_stop();
+	for (auto&& thread_v : m_loaders)
+		if (thread_v.joinable())
+			thread_v.join();
+	m_loaders.clear();
+}
+
+void tftp_file_cache::budget(std::uintmax_t bytes)
+{
+	std::unique_lock lock(m_lock);
+	m_budget = bytes;
+	evict_for(0u);
+}
+
+auto tftp_file_cache::budget() const noexcept -> std::uintmax_t
+{
+	std::unique_lock lock(m_lock);
+	return m_budget;
+}
+
+auto tftp_file_cache::key_hash::operator () (key_type const& key) const noexcept -> std::size_t
+{
+	auto hash_v = std::hash<std::string>{}(key.path);
+	hash_v ^= std::hash<std::uint64_t>{}(key.inode) + 0x9e3779b9u + (hash_v << 6u) + (hash_v >> 2u);
+	hash_v ^= std::hash<std::uintmax_t>{}(key.size) + 0x9e3779b9u + (hash_v << 6u) + (hash_v >> 2u);
+	hash_v ^= std::hash<std::int64_t>{}((std::int64_t)key.modified.time_since_epoch().count()) + 0x9e3779b9u + (hash_v << 6u) + (hash_v >> 2u);
+	hash_v ^= std::hash<std::uintmax_t>{}(key.block_size) + 0x9e3779b9u + (hash_v << 6u) + (hash_v >> 2u);
+	return hash_v;
+}
+
+auto tftp_file_cache::block_offset(std::uintmax_t number, std::uintmax_t block_size) noexcept -> std::uintmax_t
+{
+	return (number - 1u)*(block_size + tftp_header_size);
+}
+
+/* the last block is always shorter than the block size, possibly empty, but never without its header */
+auto tftp_file_cache::snapshot_size(std::uintmax_t file_size, std::uintmax_t block_size) noexcept -> std::uintmax_t
+{
+	return file_size + (file_size / block_size + 1u)*tftp_header_size;
+}
+
+/* every block but the last is full, the last one at least has its header */
+auto tftp_file_cache::file_size(std::uintmax_t snapshot_size, std::uintmax_t block_size) noexcept -> std::uintmax_t
+{
+	const auto full_v = snapshot_size / (block_size + tftp_header_size);
+	return full_v*block_size + snapshot_size - full_v*(block_size + tftp_header_size) - tftp_header_size;
+}
+
+auto tftp_file_cache::acquire(std::filesystem::path const& path, std::uintmax_t block_size) -> pending_type
+{
+	using namespace std::chrono_literals;
+	key_type key_v
+	{
+		.path				= path.lexically_normal().string(),
+		.inode			= read_only_file::identity(path),
+		.size				= std::filesystem::file_size(path),
+		.modified		= std::filesystem::last_write_time(path),
+		.block_size	= block_size
+	};
+	const auto bytes_v = snapshot_size(key_v.size, block_size);
+
+	std::unique_lock lock(m_lock);
+	if (bytes_v > m_budget || m_loaders.empty())
+		return {};
+	if (const auto it = m_entries.find(key_v); it != m_entries.end())
+	{
+		m_recent.splice(m_recent.begin(), m_recent, it->second.recent);
+		const auto& snapshot_v = it->second.snapshot;
+		if (snapshot_v.wait_for(0s) != std::future_status::ready)
+		{
+			++m_statistics.loading;
+			return snapshot_v;
+		}
+		if (is_failed(snapshot_v))
+			return {};
+		++m_statistics.hits;
+		return snapshot_v;
+	}
+	/* the space is taken now, so concurrent misses for other files can't overcommit the budget while this one loads */
+	++m_statistics.misses;
+	evict_for(bytes_v);
+	load_type load_v{ key_v, path, {} };
+	auto snapshot_v = load_v.loader.get_future().share();
+	m_recent.push_front(key_v);
+	m_entries.emplace(key_v, entry_type{ snapshot_v, m_recent.begin() });
+	m_statistics.used += bytes_v;
+	m_loads.push(std::move(load_v));
+	return snapshot_v;
+}
+
+auto tftp_file_cache::statistics() const -> statistics_type
+{
+	std::unique_lock lock(m_lock);
+	return m_statistics;
+}
+
+auto tftp_file_cache::is_failed(pending_type const& snapshot) -> bool
+{
+	if (snapshot.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+	try
+	{ snapshot.get(); }
+	catch (...)
+	{ return true; }
+	return false;
+}
+
+void tftp_file_cache::thread_loader(std::stop_token st)
+{
+	while (!st.stop_requested())
+	{
+		auto load_v = m_loads.pop(std::nothrow, st);
+		if (load_v)
+			run(*load_v);
+	}
+}
+
+void tftp_file_cache::run(load_type& load_v)
+{
+	using namespace std::string_view_literals;
+	try
+	{
+		load_v.loader.set_value(load(load_v.path, load_v.key.size, load_v.key.block_size));
+	}
+	catch (std::exception const& e)
+	{
+		/* later requests try again */
+		Glog.warning("Failed to load '{}' into the file cache, {}."sv, load_v.path.string(), e.what());
+		load_v.loader.set_exception(std::current_exception());
+		std::unique_lock lock(m_lock);
+		if (const auto it = m_entries.find(load_v.key); it != m_entries.end() && is_failed(it->second.snapshot))
+		{
+			m_statistics.used -= snapshot_size(load_v.key.size, load_v.key.block_size);
+			m_recent.erase(it->second.recent);
+			m_entries.erase(it);
+		}
+	}
+}
+
+auto tftp_file_cache::load(std::filesystem::path const& path, std::uintmax_t size, std::uintmax_t block_size) -> snapshot_type
+{
+	using namespace std::string_literals;
+	auto bytes_v = std::make_shared<std::vector<std::byte>>(snapshot_size(size, block_size));
+	std::ifstream stream_v(path, std::ios::binary);
+	for (std::uintmax_t number_v = 1u, offset_v = 0u; offset_v <= size; ++number_v, offset_v += block_size)
+	{
+		auto block_v = bytes_v->data() + block_offset(number_v, block_size);
+		block_v[0] = std::byte(TFTP_OPCODE_DATA >> 8u);
+		block_v[1] = std::byte(TFTP_OPCODE_DATA & 0xffu);
+		block_v[2] = std::byte((number_v >> 8u) & 0xffu);
+		block_v[3] = std::byte(number_v & 0xffu);
+		const auto length_v = std::min(size - offset_v, block_size);
+		if (length_v > 0u && !stream_v.read((char*)block_v + tftp_header_size, (std::streamsize)length_v))
+			throw std::runtime_error("Failed to read file into the cache: "s + path.string());
+	}
+	return bytes_v;
+}
+
+/* drops least recently used entries until `size` more bytes fit, readers keep theirs alive */
+void tftp_file_cache::evict_for(std::uintmax_t size)
+{
+	while (!m_recent.empty() && m_statistics.used + size > m_budget)
+	{
+		const auto it = m_entries.find(m_recent.back());
+		m_statistics.used -= snapshot_size(it->first.size, it->first.block_size);
+		++m_statistics.evictions;
+		m_entries.erase(it);
+		m_recent.pop_back();
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <future>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <stop_token>
+
+#include <common/concurrent_queue.hpp>
+
+/*
+ * Immutable snapshots of the files served over TFTP, shared by every
+ * session that reads the same file with the same block size. A snapshot is
+ * the file in wire format, every block preceded by its DATA header, so a
+ * block is sent (and resent) from an offset into it without any copying.
+ *
+ * Snapshots are keyed by path, inode, size, modification time and block
+ * size, a file replaced on disk gets a fresh one while transfers still
+ * running keep the bytes they started with.
+ *
+ * Entries are evicted least recently used first to stay within the budget,
+ * a snapshot lives on for as long as a reader holds on to it.
+ *
+ * Snapshots are loaded by threads of their own, a miss queues the load and
+ * returns right away. The transfer that missed, and any other asking while
+ * it loads, get the pending load and read the file themselves until it is
+ * ready, then carry on from the snapshot.
+ */
+struct tftp_file_cache
+{
+	using snapshot_type = std::shared_ptr<const std::vector<std::byte>>;
+	/* ready on a hit, a failed load throws from get() */
+	using pending_type = std::shared_future<snapshot_type>;
+
+	struct statistics_type
+	{
+		std::uint64_t		hits{ 0u };
+		std::uint64_t		misses{ 0u };
+		std::uint64_t		loading{ 0u };		/* asked for while their snapshot was still loading */
+		std::uint64_t		evictions{ 0u };
+		std::uintmax_t	used{ 0u };
+	};
+
+	/* zero budget disables the cache */
+	tftp_file_cache(std::uintmax_t budget = 0u);
+	tftp_file_cache(tftp_file_cache const&) = delete;
+	tftp_file_cache& operator = (tftp_file_cache const&) = delete;
+ ~tftp_file_cache();
+
+	/* nothing is cached until the loaders are started */
+	void start(unsigned threads);
+	void cease();
+
+	void budget(std::uintmax_t bytes);
+	auto budget() const noexcept -> std::uintmax_t;
+
+	/* not valid() when the cache is disabled, the snapshot is larger than the whole budget or failed to load */
+	auto acquire(std::filesystem::path const& path, std::uintmax_t block_size) -> pending_type;
+	auto statistics() const -> statistics_type;
+
+	/* where block `number` (1 based) of a snapshot starts, and how long it is with its header */
+	static auto block_offset(std::uintmax_t number, std::uintmax_t block_size) noexcept -> std::uintmax_t;
+	static auto snapshot_size(std::uintmax_t file_size, std::uintmax_t block_size) noexcept -> std::uintmax_t;
+	/* the other way around, how long the file in a snapshot is */
+	static auto file_size(std::uintmax_t snapshot_size, std::uintmax_t block_size) noexcept -> std::uintmax_t;
+
+private:
+	struct key_type
+	{
+		std::string													path;
+		std::uint64_t												inode;
+		std::uintmax_t											size;
+		std::filesystem::file_time_type			modified;
+		std::uintmax_t											block_size;
+
+		bool operator == (key_type const&) const = default;
+	};
+
+	struct key_hash
+	{
+		auto operator () (key_type const& key) const noexcept -> std::size_t;
+	};
+
+	struct entry_type
+	{
+		pending_type												snapshot;
+		std::list<key_type>::iterator				recent;
+	};
+
+	struct load_type
+	{
+		key_type												key;
+		std::filesystem::path						path;
+		std::promise<snapshot_type>			loader;
+	};
+
+	void thread_loader(std::stop_token st);
+	void run(load_type& load_v);
+	static auto load(std::filesystem::path const& path, std::uintmax_t size, std::uintmax_t block_size) -> snapshot_type;
+	static auto is_failed(pending_type const& snapshot) -> bool;
+	void evict_for(std::uintmax_t size);
+
+	mutable std::mutex	m_lock;
+	std::unordered_map<key_type, entry_type, key_hash> m_entries;
+	std::list<key_type>	m_recent;		/* most recently used first */
+	std::uintmax_t			m_budget{ 0u };
+	statistics_type			m_statistics;
+	concurrent_queue<load_type>	m_loads;
+	std::vector<std::jthread>		m_loaders;
+};
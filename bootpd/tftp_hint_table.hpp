@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+/*
+ * What the server remembers about a client from one transfer to its next,
+ * keyed by IPv4 address. Past `capacity` clients the least recently used is
+ * forgotten, so requests from ever new addresses can't grow it without bound.
+ * Not synchronized, the owner locks around it.
+ */
+template <typename Value>
+struct tftp_hint_table
+{
+	static inline const constexpr std::size_t DEFAULT_CAPACITY = 4096u;
+
+	tftp_hint_table(std::size_t capacity = DEFAULT_CAPACITY)
+	:	m_capacity{ std::max<std::size_t>(capacity, 1u) }
+	{}
+
+	/* nullptr when there is none, a hit makes the client the most recent */
+	auto find(std::uint32_t client) -> Value*
+	{
+		const auto it = m_entries.find(client);
+		if (it == m_entries.end())
+			return nullptr;
+		m_recent.splice(m_recent.begin(), m_recent, it->second.recent);
+		return &it->second.value;
+	}
+
+	void assign(std::uint32_t client, Value value)
+	{
+		if (const auto value_v = find(client); value_v)
+		{
+			*value_v = std::move(value);
+			return;
+		}
+		m_recent.push_front(client);
+		m_entries.emplace(client, entry_type{ std::move(value), m_recent.begin() });
+		if (m_entries.size() > m_capacity)
+		{
+			m_entries.erase(m_recent.back());
+			m_recent.pop_back();
+		}
+	}
+
+	void erase(std::uint32_t client)
+	{
+		const auto it = m_entries.find(client);
+		if (it == m_entries.end())
+			return;
+		m_recent.erase(it->second.recent);
+		m_entries.erase(it);
+	}
+
+	auto size() const noexcept -> std::size_t
+	{ return m_entries.size(); }
+
+private:
+	struct entry_type
+	{
+		Value														value;
+		std::list<std::uint32_t>::iterator	recent;
+	};
+
+	std::unordered_map<std::uint32_t, entry_type>	m_entries;
+	std::list<std::uint32_t>	m_recent;		/* most recently used first */
+	std::size_t								m_capacity;
+};
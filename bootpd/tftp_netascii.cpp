@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <exception>
+
+#include <common/read_only_file.hpp>
+#include <common/logger.hpp>
+
+#include "tftp_netascii.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TFTP_NETASCII_SSE2
+#endif
+
+/* first LF or CR in [first, last), 16 bytes at a time where SSE2 is there */
+static auto netascii_find(const unsigned char* first, const unsigned char* last) noexcept -> const unsigned char*
+{
+#if defined(TFTP_NETASCII_SSE2)
+	const auto lf_v = _mm_set1_epi8('\n');
+	const auto cr_v = _mm_set1_epi8('\r');
+	for (; last - first >= 16; first += 16)
+	{
+		const auto block_v = _mm_loadu_si128((const __m128i*)first);
+		const auto found_v = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block_v, lf_v), _mm_cmpeq_epi8(block_v, cr_v)));
+		if (found_v != 0u)
+			return first + std::countr_zero(found_v);
+	}
+#endif
+	while (first < last && *first != '\n' && *first != '\r')
+		++first;
+	return first;
+}
+
+auto netascii_growth(std::span<const std::byte> bytes) noexcept -> std::size_t
+{
+	auto first_v = (const unsigned char*)bytes.data();
+	const auto last_v = first_v + bytes.size();
+	std::size_t count_v = 0u;
+#if defined(TFTP_NETASCII_SSE2)
+	const auto lf_v = _mm_set1_epi8('\n');
+	const auto cr_v = _mm_set1_epi8('\r');
+	while (last_v - first_v >= 16)
+	{
+		/* a match is -1 in its lane, each lane counts up to 255 before they are added up */
+		auto sums_v = _mm_setzero_si128();
+		for (auto i = 0u; i < 255u && last_v - first_v >= 16; ++i, first_v += 16)
+		{
+			const auto block_v = _mm_loadu_si128((const __m128i*)first_v);
+			sums_v = _mm_sub_epi8(sums_v, _mm_or_si128(_mm_cmpeq_epi8(block_v, lf_v), _mm_cmpeq_epi8(block_v, cr_v)));
+		}
+		const auto total_v = _mm_sad_epu8(sums_v, _mm_setzero_si128());
+		count_v += (std::size_t)_mm_cvtsi128_si32(total_v) + (std::size_t)_mm_extract_epi16(total_v, 4);
+	}
+#endif
+	for (; first_v < last_v; ++first_v)
+		count_v += *first_v == '\n' || *first_v == '\r';
+	return count_v;
+}
+
+/* runs without LF or CR are copied in bulk */
+auto netascii_encode(std::span<const std::byte> bytes, std::byte* out) noexcept -> std::size_t
+{
+	auto first_v = (const unsigned char*)bytes.data();
+	const auto last_v = first_v + bytes.size();
+	auto next_v = (unsigned char*)out;
+	while (first_v < last_v)
+	{
+		const auto found_v = netascii_find(first_v, last_v);
+		std::memcpy(next_v, first_v, (std::size_t)(found_v - first_v));
+		next_v += found_v - first_v;
+		if (found_v == last_v)
+			break;
+		*next_v++ = '\r';
+		*next_v++ = *found_v == '\n' ? '\n' : '\0';
+		first_v = found_v + 1;
+	}
+	return (std::size_t)(next_v - (unsigned char*)out);
+}
+
+auto tftp_netascii_index::make(std::filesystem::path const& path) -> tftp_netascii_index
+{
+	read_only_file file_v(path);
+	file_v.advise_sequential();
+	tftp_netascii_index index_v;
+	std::vector<std::byte> piece_v(tftp_netascii_chunk);
+	for (std::uintmax_t offset_v = 0u;; offset_v += tftp_netascii_chunk)
+	{
+		const auto read_v = file_v.read(offset_v, piece_v);
+		if (read_v == 0u)
+			break;
+		index_v.offsets.push_back(index_v.size);
+		index_v.size += read_v + netascii_growth({ piece_v.data(), read_v });
+		if (read_v < piece_v.size())
+			break;
+	}
+	return index_v;
+}
+
+tftp_netascii_cache::tftp_netascii_cache(std::size_t capacity)
+:	m_capacity{ std::max<std::size_t>(capacity, 1u) }
+{}
+
+auto tftp_netascii_cache::key_hash::operator () (key_type const& key) const noexcept -> std::size_t
+{
+	auto hash_v = std::hash<std::string>{}(key.path);
+	hash_v ^= std::hash<std::uintmax_t>{}(key.size) + 0x9e3779b9u + (hash_v << 6u) + (hash_v >> 2u);
+	hash_v ^= std::hash<std::int64_t>{}((std::int64_t)key.modified.time_since_epoch().count()) + 0x9e3779b9u + (hash_v << 6u) + (hash_v >> 2u);
+	return hash_v;
+}
+
+tftp_netascii_cache::~tftp_netascii_cache()
+{
+	cease();
+}
+
+void tftp_netascii_cache::start(unsigned threads)
+{
+	for (auto i = 0u; i < std::max(threads, 1u); ++i)
+		m_indexers.emplace_back([this](auto&& st){ thread_indexer (st); });
+}
+
+/* passes still queued are dropped, transfers waiting for them fail */
+void tftp_netascii_cache::cease()
+{
+	for (auto&& thread_v : m_indexers)
+		thread_v.request_stop();
+	for (auto&& thread_v : m_indexers)
+		if (thread_v.joinable())
+			thread_v.join();
+	m_indexers.clear();
+}
+
+auto tftp_netascii_cache::acquire(std::filesystem::path const& path) -> pending_type
+{
+	key_type key_v
+	{
+		.path			= path.lexically_normal().string(),
+		.size			= std::filesystem::file_size(path),
+		.modified	= std::filesystem::last_write_time(path)
+	};
+	load_type load_v;
+	pending_type index_v;
+	{
+		std::unique_lock lock(m_lock);
+		if (const auto it = m_entries.find(key_v); it != m_entries.end())
+		{
+			m_recent.splice(m_recent.begin(), m_recent, it->second.recent);
+			return it->second.index;
+		}
+		load_v = load_type{ key_v, path, {} };
+		index_v = load_v.loader.get_future().share();
+		m_recent.push_front(key_v);
+		m_entries.emplace(std::move(key_v), entry_type{ index_v, m_recent.begin() });
+		while (m_entries.size() > m_capacity)
+		{
+			m_entries.erase(m_recent.back());
+			m_recent.pop_back();
+		}
+		if (!m_indexers.empty())
+		{
+			m_loads.push(std::move(load_v));
+			return index_v;
+		}
+	}
+	run(load_v);
+	return index_v;
+}
+
+void tftp_netascii_cache::thread_indexer(std::stop_token st)
+{
+	while (!st.stop_requested())
+	{
+		auto load_v = m_loads.pop(std::nothrow, st);
+		if (load_v)
+			run(*load_v);
+	}
+}
+
+void tftp_netascii_cache::run(load_type& load_v)
+{
+	using namespace std::string_view_literals;
+	try
+	{
+		load_v.loader.set_value(std::make_shared<const tftp_netascii_index>(tftp_netascii_index::make(load_v.path)));
+	}
+	catch (std::exception const& e)
+	{
+		/* later requests try again */
+		Glog.warning("Failed to index '{}' for netascii, {}."sv, load_v.path.string(), e.what());
+		load_v.loader.set_exception(std::current_exception());
+		std::unique_lock lock(m_lock);
+		if (const auto it = m_entries.find(load_v.key); it != m_entries.end())
+		{
+			m_recent.erase(it->second.recent);
+			m_entries.erase(it);
+		}
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <stop_token>
+
+#include <common/concurrent_queue.hpp>
+
+/*
+ * netascii (RFC 764 NVT ASCII, as TFTP sends it): LF goes out as CR LF and a
+ * bare CR as CR NUL, everything else as is. Only the two grow, so the size of
+ * the translation is the file size plus the number of LFs and CRs in it.
+ */
+
+/* raw bytes translated at a time, the index keeps where each piece starts in the translation */
+static inline constexpr const std::uintmax_t tftp_netascii_chunk = 0x40000u;
+
+/* bytes the translation of `bytes` adds, one per LF and one per CR */
+auto netascii_growth(std::span<const std::byte> bytes) noexcept -> std::size_t;
+
+/* translates `bytes` into `out`, which needs room for bytes.size() + netascii_growth(bytes), returns the bytes written */
+auto netascii_encode(std::span<const std::byte> bytes, std::byte* out) noexcept -> std::size_t;
+
+struct tftp_netascii_index
+{
+	std::uintmax_t							size{ 0u };		/* of the translation */
+	std::vector<std::uintmax_t>	offsets;			/* where piece i, raw bytes from i*tftp_netascii_chunk on, starts in the translation */
+
+	/* one pass over the file */
+	static auto make(std::filesystem::path const& path) -> tftp_netascii_index;
+};
+
+/*
+ * Indexes of recently served text files, keyed by path, size and modification
+ * time, so the size a netascii transfer announces takes a pass over the file
+ * only the first time. The least recently used go first past `capacity` entries.
+ *
+ * The pass runs on threads of their own, a miss queues it and returns right
+ * away, requests for the same file while it runs wait for the same index.
+ */
+struct tftp_netascii_cache
+{
+	using index_type = std::shared_ptr<const tftp_netascii_index>;
+	/* a failed pass throws from get() */
+	using pending_type = std::shared_future<index_type>;
+
+	static inline const constexpr std::size_t DEFAULT_CAPACITY = 64u;
+
+	tftp_netascii_cache(std::size_t capacity = DEFAULT_CAPACITY);
+	tftp_netascii_cache(tftp_netascii_cache const&) = delete;
+	tftp_netascii_cache& operator = (tftp_netascii_cache const&) = delete;
+ ~tftp_netascii_cache();
+
+	/* until the indexers are started, a miss is indexed by the caller */
+	void start(unsigned threads);
+	void cease();
+
+	auto acquire(std::filesystem::path const& path) -> pending_type;
+
+private:
+	struct key_type
+	{
+		std::string											path;
+		std::uintmax_t									size;
+		std::filesystem::file_time_type	modified;
+
+		bool operator == (key_type const&) const = default;
+	};
+
+	struct key_hash
+	{
+		auto operator () (key_type const& key) const noexcept -> std::size_t;
+	};
+
+	struct entry_type
+	{
+		pending_type									index;
+		std::list<key_type>::iterator	recent;
+	};
+
+	struct load_type
+	{
+		key_type										key;
+		std::filesystem::path				path;
+		std::promise<index_type>		loader;
+	};
+
+	void thread_indexer(std::stop_token st);
+	void run(load_type& load_v);
+
+	std::mutex					m_lock;
+	std::unordered_map<key_type, entry_type, key_hash> m_entries;
+	std::list<key_type>	m_recent;		/* most recently used first */
+	std::size_t					m_capacity;
+	concurrent_queue<load_type>	m_loads;
+	std::vector<std::jthread>		m_indexers;
+};
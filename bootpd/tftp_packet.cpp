@@ -18,6 +18,7 @@ auto tftp_packet::error_code_to_string(error_category_type value) noexcept
 	case unknown_transfer_id: return "Unknown transfer ID."s;
 	case file_already_exists: return "File already exists."s;
 	case no_such_user:				return "No such user."s;
+	case option_negotiation:	return "Option negotiation failed."s;
 	default:									return "Unknown error code ("s + std::to_string(value) + ")"s;	
 	}		
 }
@@ -19,7 +19,8 @@ struct tftp_packet
 		illegal_operation,
 		unknown_transfer_id,
 		file_already_exists,
-		no_such_user		
+		no_such_user,
+		option_negotiation		/* RFC 2347 */
 	};
 
 	static auto error_code_to_string(error_category_type value) noexcept -> std::string; 
@@ -1,36 +1,405 @@
+#include <stdexcept>
+#include <system_error>
+#include <array>
+#include <memory>
+#include <format>
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+
+#include <common/io_ring.hpp>
+
 #include "tftp_reader.hpp"
+#include "tftp_consts.hpp"
+
+static inline constexpr const std::size_t tftp_header_size = 4u;
+
+/* below this MSG_ZEROCOPY costs more in page pinning and notifications than the copy it saves */
+static inline constexpr const std::uintmax_t tftp_zerocopy_min_blksize = 0x2000u;
+
+/* the classic engine reads this much at a time, at offsets aligned to tftp_read_alignment, and has the kernel read the next chunk ahead */
+static inline constexpr const std::uintmax_t tftp_read_chunk = 0x100000u;
+static inline constexpr const std::uintmax_t tftp_read_alignment = 0x1000u;
+
+/* blocks handed to one GSO send at most, the kernel takes up to 64 segments and 64k bytes anyway */
+static inline constexpr const std::uintmax_t tftp_burst_blocks = 64u;
+
+/* after this many completions, a kernel that copied every one of them won't do any better */
+static inline constexpr const std::uint32_t tftp_zerocopy_probe_count = 32u;
+
+/* DATA headers for every block number, immutable so zero-copy sends can point into them */
+static auto data_header(std::uintmax_t number) -> std::span<const std::byte>
+{
+	static const auto headers_v = [] ()
+	{
+		auto table_v = std::make_unique<std::byte[]>(0x10000u * tftp_header_size);
+		for (auto i = 0u; i < 0x10000u; ++i)
+		{
+			table_v[i*tftp_header_size + 0u] = std::byte(TFTP_OPCODE_DATA >> 8u);
+			table_v[i*tftp_header_size + 1u] = std::byte(TFTP_OPCODE_DATA & 0xffu);
+			table_v[i*tftp_header_size + 2u] = std::byte((i >> 8u) & 0xffu);
+			table_v[i*tftp_header_size + 3u] = std::byte(i & 0xffu);
+		}
+		return table_v;
+	}();
+	return { headers_v.get() + (number & 0xffffu) * tftp_header_size, tftp_header_size };
+}
+
+/* true once the datagram is handed to the kernel, false when it didn't fit, anything else throws */
+static auto is_sent(socket_result<std::size_t> const& sent_v) -> bool
+{
+	if (sent_v)
+		return true;
+	if (sent_v.error() == std::errc::operation_would_block)
+		return false;
+	v4_socket_throw(sent_v.error(), "send operation timed out.", "failed to send DATA packet");
+}
 
-tftp_reader::tftp_reader(std::filesystem::path path, std::uintmax_t length, std::uintmax_t blksiz,  bool is_binary):
-	m_stream (path, is_binary ? std::ios::binary : 0u),
+auto to_string(tftp_io_engine engine) -> std::string_view
+{
+	switch (engine)
+	{
+	case tftp_io_engine::uring:
+		return "io_uring";
+	case tftp_io_engine::zerocopy:
+		return "zerocopy";
+	case tftp_io_engine::cached:
+		return "cached";
+	default:
+		return "classic";
+	}
+}
+
+tftp_reader::tftp_reader(std::filesystem::path path, std::uintmax_t length, std::uintmax_t blksiz,  bool is_binary, tftp_io_engine engine, tftp_file_cache::pending_type snapshot,
+	tftp_netascii_cache::index_type netascii):
 	m_length (length ? length : std::filesystem::file_size(path)),
 	m_blksiz (blksiz),
-	m_buffer (blksiz),
-	m_number (0u)
-{ next(); }
+	m_number (0u),
+	m_engine (engine)
+{
+	/* io_uring, the mapping and the cache only move raw bytes, netascii is translated on the classic path */
+	if (!is_binary)
+	{
+		m_engine = tftp_io_engine::classic;
+		m_netascii = netascii ? std::move(netascii) : std::make_shared<const tftp_netascii_index>(tftp_netascii_index::make(path));
+		m_length = m_netascii->size;
+	}
+	if (snapshot.valid() && is_binary)
+		m_pending = std::move(snapshot);
+	if (m_engine == tftp_io_engine::uring && !io_ring::is_supported())
+		m_engine = tftp_io_engine::classic;
+	if (m_pending.valid())
+	{
+		adopt();
+		if (m_snapshot)
+		{
+			m_length = std::min<std::uintmax_t>(m_length, tftp_file_cache::file_size(m_snapshot->size(), m_blksiz));
+			next();
+			return;
+		}
+	}
+	if (m_engine == tftp_io_engine::uring)
+	{
+		m_pending = {};
+		uring_setup(path);
+	}
+	if (m_engine == tftp_io_engine::zerocopy)
+	{
+		m_mapping = mapped_file(path);
+		m_length = std::min<std::uintmax_t>(m_length, m_mapping.size());
+	}
+	if (m_engine == tftp_io_engine::classic || m_engine == tftp_io_engine::uring)
+	{
+		m_file = read_only_file(path);
+		m_file.advise_sequential();
+	}
+	next();
+}
 
-auto tftp_reader::data() -> tftp_packet
+tftp_reader::~tftp_reader()
 {
-	return tftp_packet::make_data((m_number & 0xffffu), m_buffer);
+	if (m_engine != tftp_io_engine::uring)
+		return;
+	auto& ring_v = io_ring::this_thread();
+	if (m_ring_queued)
+		ring_v.submit();
+	if (m_socket_slot >= 0)
+		ring_v.unregister(m_socket_slot);
+	ring_v.unregister(m_file_slot);
 }
 
-auto tftp_reader::next() -> tftp_reader&
+void tftp_reader::uring_setup(std::filesystem::path const& path)
+{
+	try
+	{
+		auto& ring_v = io_ring::this_thread();
+		if (ring_v.buffer_size() < m_blksiz + tftp_header_size)
+		{
+			m_engine = tftp_io_engine::classic;
+			return;
+		}
+		m_file_slot = ring_v.register_file(path);
+	}
+	catch (std::exception const&)
+	{ m_engine = tftp_io_engine::classic; }
+}
+
+auto tftp_reader::data() -> tftp_packet
 {
-	const auto offset = m_number*m_blksiz;
-	const auto length = std::min(m_length - offset, m_blksiz);
-	m_buffer.clear();
-	if (length > 0)
+	/* the ring's buffers belong to sends in flight, the block is read for the copy */
+	if (m_engine == tftp_io_engine::uring)
 	{
-		m_buffer.resize(length);
-		m_stream.seekg(offset, std::ios::beg);		
-		m_stream.read((char*)m_buffer.data(), length);
+		m_chunk.resize((std::size_t)size());
+		if (m_file.read((m_number - 1u)*m_blksiz, m_chunk) < m_chunk.size())
+			throw std::runtime_error(std::format("Failed to read block {} from file, it ended early.", m_number));
+		return tftp_packet::make_data((m_number & 0xffffu), m_chunk);
 	}
+	if (m_snapshot)
+		return tftp_packet::make_data((m_number & 0xffffu), pieces()[0].subspan(tftp_header_size));
+	return tftp_packet::make_data((m_number & 0xffffu), pieces()[1]);
+}
+
+auto tftp_reader::next() -> tftp_reader&
+{
+	/* other engines only read the block when it is sent, together with the send */
 	++m_number;
+	if (m_pending.valid() && (m_number - 1u)*m_blksiz % tftp_read_chunk < m_blksiz)
+		adopt();
+	if (m_engine == tftp_io_engine::classic)
+		fill();
 	return *this;
 }
 
+/* keeps the chunk holding the current block loaded, while the kernel already reads the one after it */
+void tftp_reader::fill()
+{
+	const auto offset_v = (m_number - 1u)*m_blksiz;
+	const auto length_v = size();
+	if (length_v == 0u || (offset_v >= m_chunk_offset && offset_v + length_v <= m_chunk_offset + m_chunk.size()))
+		return;
+	if (m_netascii)
+	{
+		fill_netascii(offset_v, length_v);
+		return;
+	}
+	m_chunk_offset = offset_v & ~(tftp_read_alignment - 1u);
+	m_chunk.resize((std::size_t)std::min(std::max(tftp_read_chunk, m_blksiz + tftp_read_alignment), m_length - m_chunk_offset));
+	if (m_file.read(m_chunk_offset, m_chunk) < m_chunk.size())
+		throw std::runtime_error(std::format("Failed to read block {} from file, it ended early.", m_number));
+	m_file.advise_willneed(m_chunk_offset + m_chunk.size(), std::max(tftp_read_chunk, m_blksiz + tftp_read_alignment));
+}
+
+/* switches to the snapshot once the cache finished loading it, where the next chunk of the file would be read,
+   a snapshot of a file that changed since the transfer started or a load that failed leave the reader as it is */
+void tftp_reader::adopt()
+{
+	using namespace std::chrono_literals;
+	if (m_pending.wait_for(0s) != std::future_status::ready)
+		return;
+	auto pending_v = std::exchange(m_pending, {});
+	tftp_file_cache::snapshot_type snapshot_v;
+	try
+	{ snapshot_v = pending_v.get(); }
+	catch (std::exception const&)
+	{ return; }
+	if (!snapshot_v || (m_number > 0u && tftp_file_cache::file_size(snapshot_v->size(), m_blksiz) != m_length))
+		return;
+	m_snapshot = std::move(snapshot_v);
+	if (m_engine != tftp_io_engine::zerocopy)
+		m_engine = tftp_io_engine::cached;
+	m_file = {};
+	m_chunk = {};
+}
+
+/* translates the raw piece the block starts in and the one after it, a block never spans more than two */
+void tftp_reader::fill_netascii(std::uintmax_t offset_v, std::uintmax_t length_v)
+{
+	thread_local std::vector<std::byte> raw_v;
+	const auto& offsets_v = m_netascii->offsets;
+	const auto piece_v = (std::uintmax_t)(std::ranges::upper_bound(offsets_v, offset_v) - offsets_v.begin() - 1);
+	raw_v.resize((std::size_t)(2u*tftp_netascii_chunk));
+	const auto read_v = m_file.read(piece_v*tftp_netascii_chunk, raw_v);
+	m_chunk.resize(2u*read_v);
+	m_chunk.resize(netascii_encode({ raw_v.data(), read_v }, m_chunk.data()));
+	m_chunk_offset = offsets_v[(std::size_t)piece_v];
+	if (offset_v + length_v > m_chunk_offset + m_chunk.size())
+		throw std::runtime_error(std::format("Failed to read block {} from file, it changed since it was indexed.", m_number));
+	m_file.advise_willneed((piece_v + 2u)*tftp_netascii_chunk, 2u*tftp_netascii_chunk);
+}
+
+auto tftp_reader::pieces() const noexcept -> std::array<std::span<const std::byte>, 2u>
+{
+	if (m_snapshot)
+		return { std::span<const std::byte>(*m_snapshot).subspan(tftp_file_cache::block_offset(m_number, m_blksiz), tftp_header_size + size()), {} };
+	if (m_engine == tftp_io_engine::classic)
+		return { data_header(m_number), std::span<const std::byte>(m_chunk).subspan((m_number - 1u)*m_blksiz - m_chunk_offset, size()) };
+	return { data_header(m_number), m_mapping.bytes().subspan((m_number - 1u)*m_blksiz, size()) };
+}
+
+auto tftp_reader::seek(std::uintmax_t number) -> tftp_reader&
+{
+	if (number == m_number)
+		return *this;
+	m_number = number - 1u;
+	return next();
+}
+
+auto tftp_reader::send(socket_udp const& socket, address_v4 const& target) -> bool
+{
+	if (m_engine == tftp_io_engine::uring)
+		return uring_send(socket, target);
+	if (m_engine == tftp_io_engine::zerocopy)
+		return zerocopy_send(socket, target);
+	return is_sent(socket.try_send_gather(std::nothrow, pieces(), target, 0));
+}
+
+auto tftp_reader::send_burst(socket_udp const& socket, address_v4 const& target, std::uintmax_t last) -> std::uintmax_t
+{
+	/* the mapping and io_uring engines send block by block, the cache and the classic chunk have the blocks at hand */
+	const auto blocks_v = std::min({ last, count(), m_number + tftp_burst_blocks - 1u }) + 1u - std::min(last, m_number);
+	if (!m_segmented || blocks_v < 2u || (!m_snapshot && m_engine != tftp_io_engine::classic))
+		return send(socket, target) ? 1u : 0u;
+
+	thread_local std::vector<std::span<const std::byte>> pieces_v;
+	pieces_v.clear();
+	const auto end_v = m_number + blocks_v;
+	const auto block_size_v = [&] (std::uintmax_t number_v) { return std::min(m_length - std::min(m_length, (number_v - 1u)*m_blksiz), m_blksiz); };
+	if (m_snapshot)
+	{
+		/* ready made packets follow each other in the snapshot, the burst is a single piece */
+		const auto from_v = tftp_file_cache::block_offset(m_number, m_blksiz);
+		const auto to_v = tftp_file_cache::block_offset(end_v - 1u, m_blksiz) + tftp_header_size + block_size_v(end_v - 1u);
+		pieces_v.push_back(std::span<const std::byte>(*m_snapshot).subspan(from_v, to_v - from_v));
+	}
+	else
+	{
+		/* as far as the loaded chunk goes, the next block may need the next chunk */
+		for (auto number_v = m_number; number_v < end_v; ++number_v)
+		{
+			const auto offset_v = (number_v - 1u)*m_blksiz;
+			if (offset_v + block_size_v(number_v) > m_chunk_offset + m_chunk.size())
+				break;
+			pieces_v.push_back(data_header(number_v));
+			pieces_v.push_back(std::span<const std::byte>(m_chunk).subspan(offset_v - m_chunk_offset, block_size_v(number_v)));
+		}
+	}
+
+	const auto sent_v = socket.try_send_segmented(std::nothrow, pieces_v, m_blksiz + tftp_header_size, target, 0);
+	if (!is_sent(sent_v))
+		return 0u;
+	if (*sent_v == 0u)
+	{
+		m_segmented = false;
+		return send(socket, target) ? 1u : 0u;
+	}
+	/* every block sent was within the chunk, no need to fill it again */
+	m_number += *sent_v - 1u;
+	return *sent_v;
+}
+
+void tftp_reader::flush()
+{
+	if (!m_ring_queued)
+		return;
+	m_ring_queued = false;
+	io_ring::this_thread().submit();
+}
+
+auto tftp_reader::unsent() -> std::optional<std::uintmax_t>
+{
+	if (m_engine != tftp_io_engine::uring)
+		return std::nullopt;
+	return io_ring::this_thread().take_unsent(m_socket_slot);
+}
+
+/* queues the read of the block linked to its send, the worker takes the completions and the buffer goes back to the ring */
+auto tftp_reader::uring_send(socket_udp const& socket, address_v4 const& target) -> bool
+{
+	using namespace std::string_literals;
+	auto& ring_v = io_ring::this_thread();
+	if (m_socket_handle != socket.native_handle())
+	{
+		flush();
+		if (m_socket_slot >= 0)
+			ring_v.unregister(m_socket_slot);
+		m_socket_slot = -1;
+		try
+		{ m_socket_slot = ring_v.register_socket(socket.native_handle()); }
+		catch (std::exception const&)
+		{
+			/* the fixed file table is full, this transfer carries on the classic path */
+			ring_v.unregister(m_file_slot);
+			m_file_slot = -1;
+			m_engine = tftp_io_engine::classic;
+			fill();
+			return send(socket, target);
+		}
+		m_socket_handle = socket.native_handle();
+	}
+	if (const auto error_v = ring_v.slot_error(m_file_slot))
+		throw std::runtime_error(std::format("Failed to read block from file, error : {}", std::generic_category().message(-error_v)));
+	if (const auto error_v = ring_v.slot_error(m_socket_slot))
+		throw std::runtime_error("Failed to send DATA packet, error : "s + std::generic_category().message(-error_v));
+
+	const auto length_v = size();
+	auto buffer_v = ring_v.acquire_buffer();
+	if (!buffer_v)
+	{
+		flush();
+		ring_v.complete();
+		buffer_v = ring_v.acquire_buffer();
+	}
+	/* every buffer is in flight, the block is copied and sent right away, possibly ahead of this window's sends still in the ring */
+	if (!buffer_v)
+	{
+		thread_local std::vector<std::byte> copy_v;
+		copy_v.resize((std::size_t)length_v);
+		if (m_file.read((m_number - 1u)*m_blksiz, copy_v) < copy_v.size())
+			throw std::runtime_error(std::format("Failed to read block {} from file, it ended early.", m_number));
+		return is_sent(socket.try_send_gather(std::nothrow, std::array<std::span<const std::byte>, 2u>{ data_header(m_number), copy_v }, target, 0));
+	}
+
+	std::ranges::copy(data_header(m_number), ring_v.buffer(*buffer_v).begin());
+	if (length_v > 0u)
+		ring_v.prepare_read(m_file_slot, *buffer_v, tftp_header_size, length_v, (m_number - 1u)*m_blksiz);
+	ring_v.prepare_send(m_socket_slot, *buffer_v, tftp_header_size + length_v, target, m_number);
+	m_ring_queued = true;
+	return true;
+}
+
+auto tftp_reader::zerocopy_send(socket_udp const& socket, address_v4 const& target) -> bool
+{
+	if (m_socket_handle != socket.native_handle())
+	{
+		m_socket_handle = socket.native_handle();
+		m_zerocopy = m_blksiz >= tftp_zerocopy_min_blksize && socket.zerocopy_enable();
+	}
+
+	const auto pieces_v = pieces();
+
+	if (!m_zerocopy)
+		return is_sent(socket.try_send_gather(std::nothrow, pieces_v, target, 0));
+
+	/* completions only say the kernel let go of the pages, the mapping outlives them anyway */
+	const auto reaped_v = socket.zerocopy_reap();
+	m_zerocopy_status.completed += reaped_v.completed;
+	m_zerocopy_status.copied += reaped_v.copied;
+	if (m_zerocopy_status.completed >= tftp_zerocopy_probe_count && m_zerocopy_status.copied == m_zerocopy_status.completed)
+	{
+		/* loopback or a device without scatter-gather, pinning pages only adds overhead */
+		m_zerocopy = false;
+		return is_sent(socket.try_send_gather(std::nothrow, pieces_v, target, 0));
+	}
+	if (!is_sent(socket.try_send_zerocopy(std::nothrow, pieces_v, target, 0)))
+		return false;
+	++m_zerocopy_sent;
+	return true;
+}
+
 auto tftp_reader::size() const noexcept -> std::uintmax_t
 {
-	return m_buffer.size();
+	const auto offset = (m_number - 1u)*m_blksiz;
+	return offset < m_length ? std::min(m_length - offset, m_blksiz) : 0u;
 }
 
 auto tftp_reader::number() const noexcept -> std::uintmax_t
@@ -40,7 +409,12 @@ auto tftp_reader::number() const noexcept -> std::uintmax_t
 
 auto tftp_reader::last() const noexcept -> bool
 {
-	return m_buffer.size() < m_blksiz;
+	return size() < m_blksiz;
+}
+
+auto tftp_reader::count() const noexcept -> std::uintmax_t
+{
+	return m_length / m_blksiz + 1u;
 }
 
 auto tftp_reader::total_size() const noexcept -> std::uintmax_t
@@ -48,5 +422,17 @@ auto tftp_reader::total_size() const noexcept -> std::uintmax_t
 	return m_length;
 }
 
+auto tftp_reader::engine() const noexcept -> tftp_io_engine
+{
+	return m_engine;
+}
 
+auto tftp_reader::zerocopy_sent() const noexcept -> std::uintmax_t
+{
+	return m_zerocopy_sent;
+}
 
+auto tftp_reader::zerocopy_status() const noexcept -> socket_zerocopy_status
+{
+	return m_zerocopy_status;
+}
@@ -2,25 +2,98 @@
 
 #include <cstdint>
 #include <cstddef>
-#include <fstream>
+#include <vector>
 #include <filesystem>
+#include <string_view>
+#include <array>
+#include <span>
+#include <optional>
+
+#include <common/socket_udp.hpp>
+#include <common/address_v4.hpp>
+#include <common/mapped_file.hpp>
+#include <common/read_only_file.hpp>
 
 #include "tftp_packet.hpp"
+#include "tftp_file_cache.hpp"
+#include "tftp_netascii.hpp"
+
+enum struct tftp_io_engine
+{
+	classic,	/* pread of large chunks with kernel readahead, blocks sent from the chunk */
+	uring,		/* linked READ_FIXED + SENDMSG on the thread's io_ring */
+	zerocopy,	/* header + payload straight from a file mapping, MSG_ZEROCOPY for large blocks */
+	cached		/* ready made DATA packets in a tftp_file_cache snapshot, picked per transfer, not configured */
+};
+
+auto to_string(tftp_io_engine engine) -> std::string_view;
 
 struct tftp_reader
-{	
-	tftp_reader(std::filesystem::path path, std::uintmax_t length = 0u, std::uintmax_t block_size = 512u, bool is_binary = true);
+{
+	/* with a snapshot for this block size, binary transfers send from it and never touch the disk, zerocopy keeps MSG_ZEROCOPY,
+	   one still loading is taken over at a chunk boundary once it's ready, io_uring transfers keep the ring,
+	   netascii transfers send the translation and take the file's index when there is one, otherwise make it */
+	tftp_reader(std::filesystem::path path, std::uintmax_t length = 0u, std::uintmax_t block_size = 512u, bool is_binary = true, tftp_io_engine engine = tftp_io_engine::classic,
+		tftp_file_cache::pending_type snapshot = {}, tftp_netascii_cache::index_type netascii = {});
+	tftp_reader(tftp_reader const&) = delete;
+	tftp_reader& operator = (tftp_reader const&) = delete;
+ ~tftp_reader();
+
 	auto data() -> tftp_packet;
 	auto next() -> tftp_reader&;
-	auto size() const noexcept -> std::uintmax_t;	
+	/* positions the reader at an arbitrary block, 1 based, for going back to the first unacknowledged one */
+	auto seek(std::uintmax_t number) -> tftp_reader&;
+	/* never waits for the socket, false when its send buffer is full and the block has to be sent again once it is writable */
+	auto send(socket_udp const& socket, address_v4 const& target) -> bool;
+	/* sends the blocks from this one up to `last` in one UDP GSO send where the engine has them at hand, block by block otherwise,
+	   leaves the reader on the last block sent and returns how many went out, 0 when the socket buffer is full */
+	auto send_burst(socket_udp const& socket, address_v4 const& target, std::uintmax_t last) -> std::uintmax_t;
+	/* io_uring engine only, submits what send() queued since, one chain so the blocks leave in order */
+	void flush();
+	/* io_uring engine only, the first block the ring had no room for in the socket buffer since the last call */
+	auto unsent() -> std::optional<std::uintmax_t>;
+	auto size() const noexcept -> std::uintmax_t;
 	auto number() const noexcept -> std::uintmax_t;
 	auto last() const noexcept -> bool;
+	/* blocks in the transfer, the last one is always shorter than the block size, possibly empty */
+	auto count() const noexcept -> std::uintmax_t;
 	auto total_size() const noexcept -> std::uintmax_t;
-		
+	auto engine() const noexcept -> tftp_io_engine;
+
+	/* zerocopy engine only, sends issued and completions reported back by the kernel so far */
+	auto zerocopy_sent() const noexcept -> std::uintmax_t;
+	auto zerocopy_status() const noexcept -> socket_zerocopy_status;
+
 private:
-	std::ifstream  m_stream;
+	void uring_setup(std::filesystem::path const& path);
+	auto uring_send(socket_udp const& socket, address_v4 const& target) -> bool;
+	auto zerocopy_send(socket_udp const& socket, address_v4 const& target) -> bool;
+	void fill();
+	void adopt();
+	void fill_netascii(std::uintmax_t offset_v, std::uintmax_t length_v);
+	/* the current DATA packet, one piece from the snapshot, or header and payload from the mapping */
+	auto pieces() const noexcept -> std::array<std::span<const std::byte>, 2u>;
+
 	std::uintmax_t m_length;
 	std::uintmax_t m_blksiz;
-	std::vector<std::byte> m_buffer;
 	std::uintmax_t m_number;
-};
\ No newline at end of file
+
+	tftp_io_engine	m_engine;
+	int							m_file_slot{ -1 };
+	int							m_socket_slot{ -1 };
+	int_socket_type	m_socket_handle{ v4_socket_make_invalid() };
+	bool						m_ring_queued{ false };	/* sends prepared on the ring and not submitted yet */
+	bool						m_segmented{ true };		/* cleared once the route refuses UDP_SEGMENT */
+
+	read_only_file					m_file;
+	std::vector<std::byte>	m_chunk;
+	std::uintmax_t					m_chunk_offset{ 0u };
+	tftp_netascii_cache::index_type	m_netascii;		/* netascii only, m_chunk then holds translated bytes */
+
+	mapped_file							m_mapping;
+	tftp_file_cache::snapshot_type	m_snapshot;
+	tftp_file_cache::pending_type		m_pending;		/* the snapshot the cache was still loading when the transfer started */
+	bool										m_zerocopy{ false };
+	std::uintmax_t					m_zerocopy_sent{ 0u };
+	socket_zerocopy_status	m_zerocopy_status;
+};
@@ -0,0 +1,170 @@
+#include <algorithm>
+
+#include "tftp_scheduler.hpp"
+
+void tftp_scheduler::configure(std::uintmax_t rate, std::uintmax_t short_file)
+{
+	std::unique_lock lock(m_lock);
+	m_rate = rate;
+	m_short_file = short_file;
+	/* 20 ms worth, at least a turn of weight 1 */
+	m_burst = (std::intmax_t)std::max(rate / 50u, QUANTUM);
+	m_tokens = m_burst;
+	m_refilled = clock_type::now();
+}
+
+void tftp_scheduler::weight(address_v4 const& address, unsigned weight)
+{
+	std::unique_lock lock(m_lock);
+	m_weights.insert_or_assign(address.addr(), std::clamp(weight, 1u, MAX_WEIGHT));
+}
+
+auto tftp_scheduler::weight(address_v4 const& address) const -> unsigned
+{
+	std::unique_lock lock(m_lock);
+	if (const auto it = m_weights.find(address.addr()); it != m_weights.end())
+		return it->second;
+	if (const auto it = m_weights.find(0u); it != m_weights.end())
+		return it->second;
+	return 1u;
+}
+
+auto tftp_scheduler::rate() const noexcept -> std::uintmax_t
+{ return m_rate; }
+
+auto tftp_scheduler::enroll(address_v4 const& client, std::uintmax_t size) -> flow_type
+{
+	if (m_rate == 0u)
+		return 0u;
+	const auto weight_v = weight(client);
+	std::unique_lock lock(m_lock);
+	const auto flow_v = m_next_flow++;
+	m_flows.emplace(flow_v, flow_state{ .weight = weight_v, .remaining = size, .is_short = m_short_file > 0u && size <= m_short_file });
+	m_statistics.peak_flows = std::max(m_statistics.peak_flows, m_flows.size());
+	return flow_v;
+}
+
+void tftp_scheduler::leave(flow_type flow)
+{
+	if (flow == 0u)
+		return;
+	std::unique_lock lock(m_lock);
+	m_flows.erase(flow);
+	std::erase(m_round, flow);
+	std::erase(m_short, flow);
+}
+
+auto tftp_scheduler::admit(flow_type flow, std::uintmax_t bytes) -> bool
+{
+	if (flow == 0u)
+		return true;
+	std::unique_lock lock(m_lock);
+	auto& flow_v = m_flows.at(flow);
+	if (flow_v.is_granted)
+	{
+		flow_v.is_granted = false;
+		return true;
+	}
+	const auto is_waiting_v = flow_v.pending > 0u;
+	flow_v.pending = std::max<std::uintmax_t>(bytes, 1u);
+	if (!is_waiting_v)
+	{
+		/* a flow that still has enough of its turn left carries on ahead of the others */
+		if (flow_v.is_short)
+			m_short.push_back(flow);
+		else if (flow_v.in_turn && flow_v.deficit >= flow_v.pending)
+			m_round.push_front(flow);
+		else
+		{
+			flow_v.in_turn = false;
+			m_round.push_back(flow);
+		}
+	}
+	refill(clock_type::now());
+	serve();
+	if (flow_v.is_granted)
+	{
+		flow_v.is_granted = false;
+		return true;
+	}
+	if (!is_waiting_v)
+		++m_statistics.deferred;
+	return false;
+}
+
+auto tftp_scheduler::retry_at() const -> clock_type::time_point
+{
+	using std::chrono::duration;
+	using std::chrono::duration_cast;
+	std::unique_lock lock(m_lock);
+	const auto now_v = clock_type::now();
+	if (m_rate == 0u || m_tokens >= 0)
+		return now_v + RETRY;
+	/* nobody gets anything before the bucket is out of debt */
+	const auto wait_v = duration_cast<clock_type::duration>(duration<double>((double)-m_tokens / (double)m_rate));
+	return now_v + std::max<clock_type::duration>(wait_v, RETRY);
+}
+
+auto tftp_scheduler::statistics() const -> statistics_type
+{
+	std::unique_lock lock(m_lock);
+	return m_statistics;
+}
+
+void tftp_scheduler::refill(clock_type::time_point now)
+{
+	using std::chrono::duration;
+	const auto tokens_v = (std::intmax_t)(duration<double>(now - m_refilled).count() * (double)m_rate);
+	if (tokens_v <= 0)
+		return;
+	m_tokens = std::min(m_burst, m_tokens + tokens_v);
+	m_refilled = now;
+}
+
+/* hands out what is in the bucket, a window larger than that still goes and leaves the bucket in debt. Short
+   flows, and flows with enough left of their turn, may take it into debt by up to a burst, a lock-step client
+   then isn't held up once per block until the bucket refills */
+void tftp_scheduler::serve()
+{
+	while (m_tokens > -m_burst && !m_short.empty())
+	{
+		const auto it = std::ranges::min_element(m_short, {}, [this](flow_type flow_v) { return m_flows.at(flow_v).remaining; });
+		auto& flow_v = m_flows.at(*it);
+		m_short.erase(it);
+		++m_statistics.short_first;
+		grant(flow_v);
+	}
+	while (!m_round.empty())
+	{
+		auto& flow_v = m_flows.at(m_round.front());
+		if (m_tokens <= (flow_v.in_turn && flow_v.deficit >= flow_v.pending ? -m_burst : 0))
+			break;
+		if (!flow_v.in_turn)
+		{
+			const auto quantum_v = QUANTUM*flow_v.weight;
+			flow_v.deficit = std::min(flow_v.deficit + quantum_v, std::max(quantum_v, flow_v.pending));
+			flow_v.in_turn = true;
+		}
+		if (flow_v.deficit < flow_v.pending)
+		{
+			/* not enough for the whole window this turn, the rest of the round goes first */
+			flow_v.in_turn = false;
+			m_round.push_back(m_round.front());
+			m_round.pop_front();
+			continue;
+		}
+		flow_v.deficit -= flow_v.pending;
+		m_round.pop_front();
+		grant(flow_v);
+	}
+}
+
+void tftp_scheduler::grant(flow_state& flow)
+{
+	m_tokens -= (std::intmax_t)flow.pending;
+	flow.remaining -= std::min(flow.remaining, flow.pending);
+	++m_statistics.admitted;
+	m_statistics.bytes += flow.pending;
+	flow.pending = 0u;
+	flow.is_granted = true;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+#include <common/address_v4.hpp>
+
+/*
+ * Shares the TFTP egress between the transfers running at the same time. A
+ * transfer is a flow that asks for the bytes of its next window before sending
+ * it, and the bytes come out of one token bucket filled at the configured rate.
+ *
+ * Flows waiting for bytes are served by deficit round robin, each turn is worth
+ * QUANTUM bytes times the weight of the client, so a client with twice the
+ * weight sends twice as much while the bucket is the bottleneck. Flows for files
+ * no larger than the short file size skip the round and go first, the one with
+ * the least left to send first, so small boot files get through a busy link.
+ *
+ * A flow that isn't admitted asks again at retry_at(), the transfer workers
+ * drive it by its deadline like any other timer. Without a rate every window
+ * is admitted right away, the socket buffers and the wire decide as before.
+ */
+struct tftp_scheduler
+{
+	using clock_type = std::chrono::steady_clock;
+	using flow_type = std::uint64_t;
+
+	/* bytes a flow of weight 1 may send per turn, a full window of the largest blocks */
+	static inline const constexpr std::uintmax_t QUANTUM = 0x10000u;
+	/* how often a waiting flow asks again, at most */
+	static inline const constexpr auto RETRY = std::chrono::milliseconds(1);
+	/* weights are clamped to 1 .. MAX_WEIGHT */
+	static inline const constexpr auto MAX_WEIGHT = 64u;
+
+	struct statistics_type
+	{
+		std::uint64_t		admitted{ 0u };
+		std::uint64_t		deferred{ 0u };		/* windows that had to wait for their turn */
+		std::uint64_t		short_first{ 0u };	/* windows of short files sent ahead of the round */
+		std::uintmax_t	bytes{ 0u };
+		std::size_t			peak_flows{ 0u };
+	};
+
+	tftp_scheduler() = default;
+	tftp_scheduler(tftp_scheduler const&) = delete;
+	tftp_scheduler& operator = (tftp_scheduler const&) = delete;
+
+	/* bytes per second, 0 = no cap, files of at most `short_file` bytes go first, 0 = none do */
+	void configure(std::uintmax_t rate, std::uintmax_t short_file);
+	/* weight of the client at `address`, the one set for any is the default for clients without their own */
+	void weight(address_v4 const& address, unsigned weight);
+	auto weight(address_v4 const& address) const -> unsigned;
+	auto rate() const noexcept -> std::uintmax_t;
+
+	/* a flow for a transfer of `size` bytes to `client`, 0 when there is no cap and so nothing to schedule */
+	auto enroll(address_v4 const& client, std::uintmax_t size) -> flow_type;
+	void leave(flow_type flow);
+	/* true when the flow may send `bytes` now, otherwise it waits for its turn, asking again replaces the request */
+	auto admit(flow_type flow, std::uintmax_t bytes) -> bool;
+	/* when a flow that wasn't admitted should ask again */
+	auto retry_at() const -> clock_type::time_point;
+	auto statistics() const -> statistics_type;
+
+private:
+	struct flow_state
+	{
+		std::uintmax_t	weight{ 1u };
+		std::uintmax_t	remaining{ 0u };		/* of the file, short flows with less left go first */
+		std::uintmax_t	deficit{ 0u };				/* never more than a turn's worth, or the window waiting */
+		std::uintmax_t	pending{ 0u };			/* bytes of the window waiting, 0 = none */
+		bool						is_short{ false };
+		bool						is_granted{ false };	/* the bytes are paid for, the next admit() takes them */
+		bool						in_turn{ false };		/* got its quantum on this visit, what is left of it still counts */
+	};
+
+	void refill(clock_type::time_point now);
+	void serve();
+	void grant(flow_state& flow);
+
+	mutable std::mutex	m_lock;
+	std::uintmax_t			m_rate{ 0u };
+	std::uintmax_t			m_short_file{ 0u };
+	std::intmax_t				m_burst{ 0 };
+	std::intmax_t				m_tokens{ 0 };			/* goes below zero when a window is larger than what was left */
+	clock_type::time_point	m_refilled;
+	std::unordered_map<std::uint32_t, unsigned>	m_weights;
+	std::unordered_map<flow_type, flow_state>		m_flows;
+	std::deque<flow_type>		m_round;		/* flows waiting their turn, the front one is served next */
+	std::vector<flow_type>	m_short;		/* short flows waiting, served before the round */
+	flow_type								m_next_flow{ 1u };
+	statistics_type					m_statistics;
+};
@@ -1,11 +1,16 @@
 #include <chrono>
 #include <functional>
 #include <filesystem>
+#include <unordered_map>
+#include <queue>
+#include <algorithm>
 
 #include <common/logger.hpp>
 #include <common/address_v4.hpp>
 #include <common/socket_udp.hpp>
 #include <common/socket_error.hpp>
+#include <common/io_ring.hpp>
+#include <common/thread_affinity.hpp>
 
 #include "tftp_server_v4.hpp"
 #include "tftp_packet.hpp"
@@ -13,10 +18,12 @@
 
 
 tftp_server_v4::tftp_server_v4()
+:	m_pool(POOL_SLOTS, POOL_SLOT_SIZE)
 {
 }
 
 tftp_server_v4::tftp_server_v4(config_ini const& cfg)
+:	tftp_server_v4()
 {
 	initialize(cfg);
 }
@@ -31,14 +38,121 @@ void tftp_server_v4::initialize(config_ini const& cfg)
 	using namespace std::string_view_literals;
 	m_address = cfg.value_or("v4_bind_address"sv, address_v4::any()).port(cfg.value_or("tftp_listen_port"sv, 69));
 	m_base_dir = cfg.value_or("tftp_base_dir"sv, std::filesystem::path("./"));	
+	m_io_engine = tftp_io_engine::classic;
+	m_latency_stats = cfg.value_or("latency_stats"sv, false);
+	m_receive_buffer = cfg.value_or("tftp_rcvbuf"sv, 0);
+	m_send_buffer = cfg.value_or("tftp_sndbuf"sv, 0);
+	m_file_cache.budget(cfg.value_or("tftp_cache_size"sv, std::uintmax_t{ 0u }));
+	m_multicast = cfg.value_or("tftp_multicast_address"sv, address_v4::any()).port(cfg.value_or("tftp_multicast_port"sv, 1758));
+	m_multicast_ttl = (std::uint8_t)std::clamp(cfg.value_or("tftp_multicast_ttl"sv, 1u), 1u, 255u);
+	m_multicast_used.assign(m_multicast.addr() != 0u ? std::clamp(cfg.value_or("tftp_multicast_groups"sv, 16u), 1u, 256u) : 0u, false);
+	m_upload_writers = cfg.value_or("tftp_upload_writers"sv, 2u);
+	m_cache_loaders = cfg.value_or("tftp_cache_loaders"sv, 2u);
+	m_uring_buffers = std::clamp(cfg.value_or("tftp_uring_buffers"sv, 64u), 1u, 4096u);
+	m_upload_limit = cfg.value_or("tftp_upload_max_size"sv, std::uintmax_t{ 0x4000000u });
+	const auto upload_v = cfg.value_or("tftp_upload"sv, std::string("off"));
+	if (upload_v == "create")
+		m_upload_mode = tftp_upload_mode::create;
+	else if (upload_v == "overwrite")
+		m_upload_mode = tftp_upload_mode::overwrite;
+	else if (upload_v != "off")
+		Glog.warning("Unknown tftp_upload '{}', uploads are off.", upload_v);
+	m_pacing_rate = cfg.value_or("tftp_pacing_rate"sv, std::uint64_t{ 0u });
+	m_pacing_auto = cfg.value_or("tftp_pacing_auto"sv, false);
+	m_scheduler.configure(cfg.value_or("tftp_rate_limit"sv, std::uintmax_t{ 0u }), cfg.value_or("tftp_short_file"sv, std::uintmax_t{ 0u }));
+	initialize_weights(cfg);
+	m_worker_count = cfg.value_or("tftp_workers"sv, 0u);
+	if (m_worker_count == 0u)
+		m_worker_count = available_cpu_count();
+	const auto engine_v = cfg.value_or("tftp_io_engine"sv, std::string("classic"));
+	if (engine_v == "uring")
+	{
+		if (io_ring::is_supported())
+		{
+			m_io_engine = tftp_io_engine::uring;
+			io_ring::configure(m_uring_buffers, 0x10000u);
+		}
+		else
+			Glog.warning("io_uring is not available, falling back to the classic TFTP data path.");
+	}
+	else if (engine_v == "zerocopy")
+		m_io_engine = tftp_io_engine::zerocopy;
+	else if (engine_v != "classic")
+		Glog.warning("Unknown tftp_io_engine '{}', using the classic TFTP data path.", engine_v);
+}
+
+void tftp_server_v4::initialize_weights(config_ini const& cfg)
+{
+	using namespace std::string_view_literals;
+	static constexpr const auto class_prefix_v = "tftp_class:"sv;
+	m_scheduler.weight(address_v4::any(), cfg.value_or("tftp_weight"sv, 1u));
+	for (auto&& section_v : cfg.sections())
+	{
+		if (section_v.empty() || section_v.starts_with(class_prefix_v) || section_v.starts_with("interface:"sv))
+			continue;
+		config_ini::section_type client_v(section_v);
+		const auto address_v = cfg.value_or(client_v["v4_your_address"sv], address_v4::any());
+		if (address_v.addr() == 0u)
+			continue;
+		auto weight_v = cfg.value_as<unsigned>(client_v["tftp_weight"sv]);
+		if (const auto class_v = cfg.value(client_v["tftp_class"sv]); !weight_v && class_v)
+		{
+			const auto section_s = std::string(class_prefix_v) + std::string(*class_v);
+			weight_v = cfg.value_as<unsigned>(config_ini::section_type(section_s)["tftp_weight"sv]);
+			if (!weight_v)
+				Glog.warning("No tftp_weight in [{}] for client {}, using the default.", section_s, section_v);
+		}
+		if (weight_v)
+			m_scheduler.weight(address_v, *weight_v);
+	}
 }
 
 void tftp_server_v4::start()
 {
 	using namespace std::chrono_literals;
-	Glog.info("Starting TFTP server on '{}', with root at '{}' ... ", m_address.to_string(), std::filesystem::absolute(m_base_dir).string());
+	Glog.info("Starting TFTP server on '{}', with root at '{}' ({} data path, {} workers) ... ", m_address.to_string(), std::filesystem::absolute(m_base_dir).string(), 
+		to_string(m_io_engine), m_worker_count);
 	m_sock = m_address.make_udp();
-	m_sock.timeout(500ms);	
+	m_sock.timeout_idle(500ms);	
+	const auto receive_v = m_sock.receive_buffer(m_receive_buffer);
+	const auto send_v = m_sock.send_buffer(m_send_buffer);
+	if (receive_v < m_receive_buffer || send_v < m_send_buffer)
+		Glog.warning("* Socket buffers capped at {}/{} bytes, raise net.core.rmem_max/wmem_max or run with CAP_NET_ADMIN.", receive_v, send_v);
+	if (!m_sock.overflow_enable())
+		Glog.warning("* SO_RXQ_OVFL not available, packets dropped in the kernel won't be reported as they happen.");
+	if (m_latency_stats && !m_sock.timestamping_enable())
+		Glog.warning("* SO_TIMESTAMPING not available, kernel latency won't be measured.");
+	/* bound to any, sessions answer from the address each request was sent to */
+	if (m_io_engine == tftp_io_engine::uring)
+		Glog.info("* Keeping up to {} blocks in flight on each worker's io_uring.", m_uring_buffers);
+	if (m_file_cache.budget() > 0u)
+	{
+		Glog.info("* Caching up to {} bytes of file contents, loaded by {} threads.", m_file_cache.budget(), std::max(m_cache_loaders, 1u));
+		m_file_cache.start(m_cache_loaders);
+	}
+	m_netascii_cache.start(m_cache_loaders);
+	if (!m_multicast_used.empty())
+		Glog.info("* Multicast transfers (RFC 2090) to up to {} groups from '{}'.", m_multicast_used.size(), m_multicast.to_string());
+	if (m_address.addr() == 0u && !m_sock.pktinfo_enable())
+		Glog.warning("* IP_PKTINFO not available, sessions answer from the address of the default route.");
+	if (m_pacing_rate > 0u && !m_sock.pacing_rate(~std::uint64_t{ 0u }))
+	{
+		Glog.warning("* SO_MAX_PACING_RATE not available, transfers won't be paced.");
+		m_pacing_rate = 0u;
+	}
+	if (m_pacing_rate > 0u)
+		Glog.info("* Pacing each transfer {} {} bytes per second (needs the fq qdisc on the way out).", m_pacing_auto ? "at up to" : "at", m_pacing_rate);
+	if (m_scheduler.rate() > 0u)
+		Glog.info("* Sending at most {} bytes per second, shared by client weight.", m_scheduler.rate());
+	if (m_upload_mode != tftp_upload_mode::off)
+	{
+		Glog.info("* Uploads allowed ({}, up to {} bytes), written behind by {} threads.", to_string(m_upload_mode), m_upload_limit, std::max(m_upload_writers, 1u));
+		m_write_behind.start(m_upload_writers);
+	}
+	for (auto i = 0u; i < m_worker_count; ++i)
+		m_workers.emplace_back(std::make_unique<worker_type>());
+	for (auto&& worker_v : m_workers)
+		worker_v->thread = std::jthread([this, &worker_v = *worker_v](auto&& st){ thread_worker (st, worker_v); });
 	m_thread_incoming = std::jthread([this](auto&& st){ thread_incoming (st); });
 	m_thread_outgoing = std::jthread([this](auto&& st){ thread_outgoing (st); });
 	std::this_thread::sleep_for(10ms);
@@ -55,6 +169,39 @@ void tftp_server_v4::cease()
 		m_thread_outgoing.request_stop();
 		m_thread_outgoing.join();
 	}
+	for (auto&& worker_v : m_workers)
+		worker_v->thread.request_stop();
+	for (auto&& worker_v : m_workers)
+		if (worker_v->thread.joinable())
+			worker_v->thread.join();
+	m_workers.clear();
+	/* after the workers, uploads they cut short still have to be thrown away */
+	m_write_behind.cease();
+	m_file_cache.cease();
+	m_netascii_cache.cease();
+
+	const auto pool_v = m_pool.statistics();
+	Glog.info("* Packet pool: {} packets, peak {} of {} slots in use, {} heap fallbacks.", 
+		pool_v.acquired, pool_v.peak_in_use, m_pool.slot_count(), pool_v.heap_fallbacks);
+	if (const auto cache_v = m_file_cache.statistics(); m_file_cache.budget() > 0u)
+		Glog.info("* File cache: {} hits, {} misses, {} started while loading, {} evictions, {} of {} bytes in use.",
+			cache_v.hits, cache_v.misses, cache_v.loading, cache_v.evictions, cache_v.used, m_file_cache.budget());
+	if (const auto upload_v = m_write_behind.statistics(); m_upload_mode != tftp_upload_mode::off)
+		Glog.info("* Uploads: {} on disk, {} failed, {} bytes written in {} batches.",
+			upload_v.committed, upload_v.failed, upload_v.written, upload_v.batches);
+	if (const auto scheduler_v = m_scheduler.statistics(); m_scheduler.rate() > 0u)
+		Glog.info("* Scheduler: {} windows sent ({} bytes), {} waited for their turn, {} of short files went first, peak {} transfers.",
+			scheduler_v.admitted, scheduler_v.bytes, scheduler_v.deferred, scheduler_v.short_first, scheduler_v.peak_flows);
+	if (m_sock.native_handle() != v4_socket_make_invalid())
+		Glog.info("* Socket: {} byte receive buffer, {} byte send buffer, {} packets dropped in the kernel.",
+			m_sock.option<so_rcvbuf>(), m_sock.option<so_sndbuf>(), m_sock.drop_count().value_or(0u));
+	dump_latency();
+}
+
+void tftp_server_v4::dump_latency() const
+{
+	if (m_latency_stats)
+		m_latency.dump("TFTP");
 }
 
 auto tftp_server_v4::address() const noexcept -> address_v4 const&
@@ -63,78 +210,188 @@ auto tftp_server_v4::address() const noexcept -> address_v4 const&
 auto tftp_server_v4::base_dir() const noexcept -> path const&
 { return m_base_dir; }
 
+auto tftp_server_v4::io_engine() const noexcept -> tftp_io_engine
+{ return m_io_engine; }
+
+auto tftp_server_v4::file_cache() const noexcept -> tftp_file_cache&
+{ return m_file_cache; }
+
+auto tftp_server_v4::netascii_cache() const noexcept -> tftp_netascii_cache&
+{ return m_netascii_cache; }
+
+auto tftp_server_v4::upload_mode() const noexcept -> tftp_upload_mode
+{ return m_upload_mode; }
+
+auto tftp_server_v4::upload_limit() const noexcept -> std::uintmax_t
+{ return m_upload_limit; }
+
+auto tftp_server_v4::write_behind() const noexcept -> tftp_write_behind&
+{ return m_write_behind; }
+
+auto tftp_server_v4::scheduler() const noexcept -> tftp_scheduler&
+{ return m_scheduler; }
+
+auto tftp_server_v4::window_hint(address_v4 const& client, std::uintmax_t requested) const -> std::uintmax_t
+{
+	std::unique_lock lock(m_window_lock);
+	const auto hint_v = m_window_hints.find(client.addr());
+	return hint_v ? std::min(requested, *hint_v) : requested;
+}
+
+/* halves after a lossy transfer, doubles back after a clean one until the cap is gone */
+void tftp_server_v4::window_update(address_v4 const& client, std::uintmax_t granted, bool lossy) const
+{
+	std::unique_lock lock(m_window_lock);
+	if (lossy)
+	{
+		m_window_hints.assign(client.addr(), std::max<std::uintmax_t>(granted / 2u, 1u));
+		return;
+	}
+	const auto hint_v = m_window_hints.find(client.addr());
+	if (!hint_v || granted < *hint_v)
+		return;
+	if (*hint_v * 2u >= tftp_session_v4::MAX_WINDOW)
+		m_window_hints.erase(client.addr());
+	else
+		*hint_v *= 2u;
+}
+
+auto tftp_server_v4::pacing_rate() const noexcept -> std::uint64_t
+{ return m_pacing_rate; }
+
+auto tftp_server_v4::pacing_auto() const noexcept -> bool
+{ return m_pacing_auto; }
+
+auto tftp_server_v4::pacing_hint(address_v4 const& client) const -> std::uint64_t
+{
+	std::unique_lock lock(m_window_lock);
+	const auto hint_v = m_pacing_hints.find(client.addr());
+	return hint_v ? std::min(m_pacing_rate, *hint_v) : m_pacing_rate;
+}
+
+/* the rate a transfer ended at is where the client's next one starts, back at the full rate it is forgotten */
+void tftp_server_v4::pacing_update(address_v4 const& client, std::uint64_t rate) const
+{
+	if (!m_pacing_auto)
+		return;
+	std::unique_lock lock(m_window_lock);
+	if (rate >= m_pacing_rate)
+		m_pacing_hints.erase(client.addr());
+	else
+		m_pacing_hints.assign(client.addr(), rate);
+}
+
+/* consecutive addresses from tftp_multicast_address, all on the same port */
+auto tftp_server_v4::multicast_acquire() const -> std::optional<address_v4>
+{
+	std::unique_lock lock(m_multicast_lock);
+	const auto it = std::ranges::find(m_multicast_used, false);
+	if (it == m_multicast_used.end())
+		return std::nullopt;
+	*it = true;
+	return m_multicast.addr(m_multicast.addr() + (std::uint32_t)(it - m_multicast_used.begin()));
+}
+
+void tftp_server_v4::multicast_release(address_v4 const& group) const
+{
+	std::unique_lock lock(m_multicast_lock);
+	if (const auto index_v = (std::size_t)(group.addr() - m_multicast.addr()); index_v < m_multicast_used.size())
+		m_multicast_used[index_v] = false;
+}
+
+auto tftp_server_v4::multicast_ttl() const noexcept -> std::uint8_t
+{ return m_multicast_ttl; }
+
 void tftp_server_v4::thread_incoming(std::stop_token st)
 {
 	using namespace std::string_view_literals;
 	Glog.info("* Receiver thread started.");
+	const auto interrupt_v = socket_reactor::this_thread().interrupt_on(st);
+
+	std::array<packet_buffer, MAX_BATCH> buffers_v;
+	std::array<address_v4, MAX_BATCH> sources_v;
+	std::array<socket_datagram_info, MAX_BATCH> infos_v;
+	std::uint32_t dropped_v{ 0u };
+	std::vector<event_type> events_v;
+	events_v.reserve(MAX_BATCH);
+
 	while (!st.stop_requested()) 
 	{
 		try
 		{
-			auto[source, packet_bits] = m_sock.recv(0);
-			if (packet_bits.empty()) 
+			for (auto&& buffer_v : buffers_v)
+				if (!buffer_v) buffer_v = m_pool.acquire();
+			const auto count_v = m_sock.recv_batch(std::nothrow, buffers_v, sources_v, infos_v, 0);
+			if (!count_v)
+			{
+				if (count_v.error() != std::errc::timed_out)
+					Glog.error("Failed to receive TFTP packets, {}."sv, count_v.error().message());
 				continue;
-			Glog.info("Received {} byte TFTP packet from '{}' ... ", packet_bits.size(), source.to_string());
-			m_events.emplace(event_packet_type(std::move(source), std::move(packet_bits)));
+			}
+			/* cumulative, only the growth since the last batch is news */
+			if (const auto last_v = infos_v[*count_v - 1u].dropped; last_v > dropped_v)
+			{
+				Glog.warning("{} packets dropped in the kernel since the last TFTP packet (full receive buffer, see tftp_rcvbuf).", last_v - dropped_v);
+				dropped_v = last_v;
+			}
+			const auto received_v = m_latency_stats ? std::chrono::system_clock::now() : socket_timestamp{};
+			for (auto i = 0u; i < *count_v; ++i)
+			{
+				if (buffers_v[i].empty()) 
+					continue;
+				Glog.info("Received {} byte TFTP packet from '{}' ... ", buffers_v[i].size(), sources_v[i].to_string());
+				m_latency.kernel.record(infos_v[i].timestamp, received_v);
+				events_v.emplace_back(event_packet_type(sources_v[i], std::move(buffers_v[i]), packet_times{ infos_v[i].timestamp, received_v }, infos_v[i].local));
+			}
+			m_events.push_batch(events_v);
 		}
-		catch (error_socket_timed_out const&)
-		{ continue; }
 		catch (std::exception const& e)
 		{ Glog.error("{}"sv, e.what()); }
 	}
 	Glog.info("* Receiver thread stopped.");
 }
 
-auto tftp_server_v4::session_notify(tftp_session_v4 const* who) -> tftp_server_v4&
-{
-	m_events.push(event_notify_type(who));
-	return *this;
-}
-
 template<typename T>
-auto tftp_server_v4::visit_packet(T const& packet_v, address_v4 const& source_v) -> tftp_server_v4&
+auto tftp_server_v4::visit_packet(T const&, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&
 {
-	m_sock.send(tftp_packet::make_error(tftp_packet::illegal_operation), source_v, 0);
+	/* from the local address the packet reached, as the sessions answer */
+	const auto error_v = serialize_to_vector(tftp_packet::make_error(tftp_packet::illegal_operation));
+	const std::span<const std::byte> buffer_v{ error_v };
+	if (const auto sent_v = m_sock.send_batch(std::nothrow, std::span{ &buffer_v, 1u }, std::span{ &source_v, 1u }, std::span{ &local_v, 1u }, 0u); !sent_v)
+		Glog.error("Failed to send TFTP error to '{}', {}.", source_v.to_string(), sent_v.error().message());
 	Glog.info("Ignoring non-request packet from '{}'.", source_v.to_string());
 	return *this;
 }
 
 auto tftp_server_v4::visit_event(event_packet_type const& event_v) -> tftp_server_v4&
 {
-	auto [source_v, packet_bits] = event_v;
-	tftp_packet packet_v (packet_bits);			
+	using std::chrono::system_clock;
+	auto const& [source_v, packet_bits, times_v, local_v] = event_v;
+	const auto started_v = m_latency_stats ? system_clock::now() : socket_timestamp{};
+	m_latency.queue.record(times_v.received, started_v);
+	tftp_packet packet_v (packet_bits.bytes());			
 	Glog.info("From '{}' received : {} ", source_v.to_string(), packet_v.to_string());
-	packet_v.visit([this, source_v](auto&& packet_v){ 
-		visit_packet(packet_v, source_v); 
+	packet_v.visit([this, source_v, local_v](auto&& packet_v){ 
+		visit_packet(packet_v, source_v, local_v); 
 	});
+	if (m_latency_stats)
+		m_latency.process.record(started_v, system_clock::now());
 	return *this;
 }
 
-auto tftp_server_v4::visit_event(event_notify_type const& event_v) -> tftp_server_v4&
+auto tftp_server_v4::visit_packet(tftp_packet::type_rrq const& packet_v, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&
 {
-	auto [session_ptr] = event_v;
-	if (session_ptr && (*session_ptr).is_done()) {
-		Glog.debug("Killing session {:#08x} ...", (std::uintptr_t)session_ptr);
-		m_session_list.erase (session_ptr);			
-	}
-	return *this;
-}
-
-auto tftp_server_v4::visit_packet(tftp_packet::type_rrq const& packet_v, address_v4 const& source_v) -> tftp_server_v4&
-{
-	auto session_ptr = std::make_unique<tftp_session_v4>(*this, source_v, packet_v);
-	m_session_list.emplace(session_ptr.get(), std::move(session_ptr));
+	dispatch(session_request_type(source_v, packet_v, local_v));
 	return *this;
 }
 
-auto tftp_server_v4::visit_packet(tftp_packet::type_wrq const& packet_v, address_v4 const& source_v) -> tftp_server_v4&
+auto tftp_server_v4::visit_packet(tftp_packet::type_wrq const& packet_v, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&
 {
-	auto session_ptr = std::make_unique<tftp_session_v4>(*this, source_v, packet_v);
-	m_session_list.emplace(session_ptr.get(), std::move(session_ptr));
+	dispatch(session_request_type(source_v, packet_v, local_v));
 	return *this;
 }
 
-auto tftp_server_v4::visit_packet(std::monostate const& packet_v, address_v4 const& source_v) -> tftp_server_v4&
+auto tftp_server_v4::visit_packet(std::monostate const&, address_v4 const&, socket_local const&) -> tftp_server_v4&
 {
 	throw std::logic_error("Empty packet, packet parsing failed.");
 	return *this;
@@ -147,20 +404,216 @@ void tftp_server_v4::thread_outgoing(std::stop_token st)
 
 	while (!st.stop_requested()) 
 	{
+		auto event_v = m_events.pop(std::nothrow, st);
+		if (!event_v)
+		{
+			if (event_v.error() == std::errc::operation_canceled)
+				break;
+			continue;
+		}
 		try
 		{											
-			std::visit([this](auto&& event_v) { 
-				visit_event(event_v); 
-			}, m_events.pop(st));							
+			visit_event(*event_v);
 		}
-		catch (error_socket_timed_out const&)
-		{ continue; }
-		catch (error_stop_requested const&)
-		{ break; }
 		catch (std::exception const& e)
 		{ Glog.error("{}"sv, e.what()); }		
 	}
 	Glog.info("* Responder thread stopped.");
 }
 
+/* requests that may share a multicast transfer all go to the worker that would be running it */
+void tftp_server_v4::dispatch(session_request_type request_v)
+{
+	const auto group_v = m_multicast_used.empty() ? std::string{} : tftp_session_v4::group_key(std::get<1>(request_v));
+	auto& worker_v = !group_v.empty() ? *m_workers[std::hash<std::string>{}(group_v) % m_workers.size()] : **std::ranges::min_element(m_workers, {}, [](auto const& worker_v) {
+		return worker_v->sessions.load(std::memory_order_relaxed);
+	});
+	worker_v.sessions.fetch_add(1u, std::memory_order_relaxed);
+	worker_v.requests.push(std::move(request_v));
+	worker_v.reactor.interrupt();
+}
+
+void tftp_server_v4::thread_worker(std::stop_token st, worker_type& worker_v)
+{
+	using namespace std::string_view_literals;
+	using namespace std::chrono_literals;
+	using std::chrono::duration_cast;
+	using std::chrono::milliseconds;
+	using clock_type = tftp_session_v4::clock_type;
+	/* one live entry per session, checked against the session's deadline when it comes up, so re-arming later is free */
+	using timer_type = std::pair<clock_type::time_point, int_socket_type>;
+	struct entry_type
+	{
+		std::unique_ptr<tftp_session_v4>	session;
+		clock_type::time_point						queued;		/* the timer entry that belongs to this session, others are stale */
+		socket_reactor::readiness_type		watched;
+	};
 
+	Glog.info("* Transfer worker started.");
+	const auto interrupt_v = worker_v.reactor.interrupt_on(st);
+
+	std::unordered_map<int_socket_type, entry_type> sessions_v;
+	std::unordered_map<std::string, int_socket_type> groups_v;	/* multicast transfers still taking clients */
+	std::priority_queue<timer_type, std::vector<timer_type>, std::greater<>> timers_v;
+	std::array<int_socket_type, MAX_READY> ready_v;
+	session_request_type request_v;
+
+	const auto erase_v = [&](int_socket_type handle_v) {
+		if (const auto it = groups_v.find(sessions_v.at(handle_v).session->group_key()); it != groups_v.end() && it->second == handle_v)
+			groups_v.erase(it);
+		worker_v.reactor.unwatch(handle_v);
+		sessions_v.erase(handle_v);
+		worker_v.sessions.fetch_sub(1u, std::memory_order_relaxed);
+	};
+
+	/* a session whose send buffer filled up is watched for writable as well, until it drained */
+	const auto rewatch_v = [&](int_socket_type handle_v, entry_type& entry_v) {
+		if (const auto readiness_v = entry_v.session->readiness(); readiness_v != entry_v.watched)
+		{
+			worker_v.reactor.watch(handle_v, readiness_v);
+			entry_v.watched = readiness_v;
+		}
+	};
+
+	/* false once the session is finished, whichever way */
+	const auto step_v = [&](tftp_session_v4& session_v, auto&& action_v) -> bool {
+		try
+		{
+			action_v(session_v);
+			return !session_v.is_done();
+		}
+		catch (std::exception const& e)
+		{ Glog.error("{}"sv, e.what()); }
+		return false;
+	};
+
+	/* completions of the worker's io_uring sends hand their buffers back, they are taken as they come */
+	auto ring_v = v4_socket_make_invalid();
+	if (m_io_engine == tftp_io_engine::uring)
+	{
+		try
+		{
+			ring_v = io_ring::this_thread().native_handle();
+			worker_v.reactor.watch(ring_v, socket_reactor::readiness_read);
+		}
+		catch (std::exception const& e)
+		{ Glog.warning("* io_uring not usable on this worker, its transfers take the classic path : {}"sv, e.what()); }
+	}
+
+	while (!st.stop_requested())
+	{
+		while (worker_v.requests.try_pop(request_v))
+		{
+			auto& [source_v, packet_v, local_v] = request_v;
+			auto joined_v = false;
+			if (const auto it = groups_v.find(tftp_session_v4::group_key(packet_v)); it != groups_v.end())
+				step_v(*sessions_v.at(it->second).session, [&](auto& s) { joined_v = s.join(source_v, packet_v); });
+			if (joined_v)
+			{
+				worker_v.sessions.fetch_sub(1u, std::memory_order_relaxed);
+				continue;
+			}
+			std::unique_ptr<tftp_session_v4> session_v;
+			try
+			{
+				session_v = std::make_unique<tftp_session_v4>(*this, source_v, std::move(packet_v), local_v);
+			}
+			catch (std::exception const& e)
+			{
+				Glog.error("{}"sv, e.what());
+				worker_v.sessions.fetch_sub(1u, std::memory_order_relaxed);
+				continue;
+			}
+			if (!step_v(*session_v, [](auto& s) { s.start(); }))
+			{
+				worker_v.sessions.fetch_sub(1u, std::memory_order_relaxed);
+				continue;
+			}
+			const auto handle_v = session_v->socket().native_handle();
+			const auto readiness_v = session_v->readiness();
+			worker_v.reactor.watch(handle_v, readiness_v);
+			const auto deadline_v = session_v->deadline();
+			timers_v.emplace(deadline_v, handle_v);
+			if (!session_v->group_key().empty())
+				groups_v.insert_or_assign(session_v->group_key(), handle_v);
+			sessions_v.insert_or_assign(handle_v, entry_type{ std::move(session_v), deadline_v, readiness_v });
+		}
+
+		/* without interrupts (Windows) new requests and stop requests are only noticed between waits */
+		auto timeout_v = socket_reactor::can_interrupt ? 0ms : 50ms;
+		if (!timers_v.empty())
+		{
+			const auto until_v = std::max<milliseconds>(duration_cast<milliseconds>(timers_v.top().first - clock_type::now()) + 1ms, 1ms);
+			timeout_v = timeout_v > 0ms ? std::min(timeout_v, until_v) : until_v;
+		}
+
+		try
+		{
+			const auto count_v = worker_v.reactor.wait_ready(ready_v, timeout_v);
+			for (auto i = 0u; i < count_v; ++i)
+			{
+				if (ready_v[i] == ring_v)
+				{
+					io_ring::this_thread().complete();
+					continue;
+				}
+				const auto it = sessions_v.find(ready_v[i]);
+				if (it == sessions_v.end())
+					continue;
+				if (!step_v(*it->second.session, [](auto& s) { s.on_readable(); })
+					|| ((it->second.watched & socket_reactor::readiness_write) && !step_v(*it->second.session, [](auto& s) { s.on_writable(); })))
+				{
+					erase_v(ready_v[i]);
+					continue;
+				}
+				rewatch_v(ready_v[i], it->second);
+				/* a shorter RTO moves the deadline forward, the queued entry would fire too late */
+				if (const auto deadline_v = it->second.session->deadline(); deadline_v < it->second.queued)
+				{
+					it->second.queued = deadline_v;
+					timers_v.emplace(deadline_v, ready_v[i]);
+				}
+			}
+			/* io_uring sends that found the socket full, whichever completion noticed it */
+			if (ring_v != v4_socket_make_invalid())
+			{
+				for (const auto handle_v : io_ring::this_thread().take_stalled())
+				{
+					const auto it = sessions_v.find(handle_v);
+					if (it == sessions_v.end())
+						continue;
+					if (!step_v(*it->second.session, [](auto& s) { s.on_stalled(); }))
+						erase_v(handle_v);
+					else
+						rewatch_v(handle_v, it->second);
+				}
+			}
+		}
+		catch (std::exception const& e)
+		{ Glog.error("{}"sv, e.what()); }
+
+		for (const auto now_v = clock_type::now(); !timers_v.empty() && timers_v.top().first <= now_v; )
+		{
+			const auto [deadline_v, handle_v] = timers_v.top();
+			timers_v.pop();
+			const auto it = sessions_v.find(handle_v);
+			if (it == sessions_v.end() || it->second.queued != deadline_v)
+				continue;
+			auto& session_v = *it->second.session;
+			if (session_v.deadline() <= now_v && !step_v(session_v, [](auto& s) { s.on_timeout(); }))
+			{
+				erase_v(handle_v);
+				continue;
+			}
+			rewatch_v(handle_v, it->second);
+			it->second.queued = session_v.deadline();
+			timers_v.emplace(it->second.queued, handle_v);
+		}
+	}
+
+	for (auto&& [handle_v, session_v] : sessions_v)
+		worker_v.reactor.unwatch(handle_v);
+	if (ring_v != v4_socket_make_invalid())
+		worker_v.reactor.unwatch(ring_v);
+	Glog.info("* Transfer worker stopped, {} transfers cut short.", sessions_v.size());
+}
@@ -2,8 +2,11 @@
 
 #include <common/address_v4.hpp>
 #include <common/socket_udp.hpp>
+#include <common/packet_pool.hpp>
 #include <common/config_ini.hpp>
 #include <common/concurrent_queue.hpp>
+#include <common/latency_histogram.hpp>
+#include <common/socket_reactor.hpp>
 
 #include <filesystem>
 #include <vector>
@@ -11,22 +14,46 @@
 #include <string_view>
 #include <stop_token>
 #include <tuple>
-#include <unordered_set>
+#include <array>
+#include <span>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
 
 #include "tftp_packet.hpp"
 #include "tftp_session_v4.hpp"
+#include "tftp_reader.hpp"
+#include "tftp_file_cache.hpp"
+#include "tftp_netascii.hpp"
+#include "tftp_writer.hpp"
+#include "tftp_hint_table.hpp"
+#include "tftp_scheduler.hpp"
 
 struct tftp_server_v4
 {
+	static inline const constexpr auto MAX_BATCH = 16u;
+	static inline const constexpr auto POOL_SLOTS = 256u;
+	static inline const constexpr auto POOL_SLOT_SIZE = 0x2400u;
+	static inline const constexpr auto MAX_READY = 64u;
+
 protected:
 	
-	using event_notify_type = std::tuple<tftp_session_v4 const *>;
-	using event_packet_type = std::tuple<address_v4, std::vector<std::byte>>;
+	using event_packet_type = std::tuple<address_v4, packet_buffer, packet_times, socket_local>;
+	using session_request_type = std::tuple<address_v4, tftp_session_v4::request_type, socket_local>;
 		
 	using path = std::filesystem::path;
-	using event_type = std::variant<event_packet_type, event_notify_type>;
+	using event_type = event_packet_type;
 	using event_queue = concurrent_queue<event_type>;
-	using session_list = std::unordered_map<tftp_session_v4 const *, std::unique_ptr<tftp_session_v4>>;
+
+	/* serves its share of the transfers as state machines, all of their sockets on one reactor */
+	struct worker_type
+	{
+		socket_reactor													reactor;
+		concurrent_queue<session_request_type>	requests;
+		std::atomic<std::size_t>								sessions{ 0u };
+		std::jthread														thread;
+	};
 
 public:
 
@@ -38,28 +65,83 @@ public:
   void start();
 	void cease();
 
+	/* logs the latency histograms, when enabled with `latency_stats` */
+	void dump_latency() const;
+
 	auto address() const noexcept -> address_v4 const&;
 	auto base_dir() const noexcept -> path const&;
-	auto session_notify(tftp_session_v4 const* who) -> tftp_server_v4&;
+	auto io_engine() const noexcept -> tftp_io_engine;
+	auto file_cache() const noexcept -> tftp_file_cache&;
+	auto netascii_cache() const noexcept -> tftp_netascii_cache&;
+	auto upload_mode() const noexcept -> tftp_upload_mode;
+	/* largest upload accepted, announced or received */
+	auto upload_limit() const noexcept -> std::uintmax_t;
+	auto write_behind() const noexcept -> tftp_write_behind&;
+	auto scheduler() const noexcept -> tftp_scheduler&;
+
+	/* RFC 7440 windows are fixed for a transfer, so loss adapts the windowsize granted to the client's next one */
+	auto window_hint(address_v4 const& client, std::uintmax_t requested) const -> std::uintmax_t;
+	void window_update(address_v4 const& client, std::uintmax_t granted, bool lossy) const;
+
+	/* SO_MAX_PACING_RATE for the transfers, 0 = not paced, with auto pacing each client starts where its last transfer ended */
+	auto pacing_rate() const noexcept -> std::uint64_t;
+	auto pacing_auto() const noexcept -> bool;
+	auto pacing_hint(address_v4 const& client) const -> std::uint64_t;
+	void pacing_update(address_v4 const& client, std::uint64_t rate) const;
+
+	/* RFC 2090 groups, one per running multicast transfer, empty when none is configured or all are taken */
+	auto multicast_acquire() const -> std::optional<address_v4>;
+	void multicast_release(address_v4 const& group) const;
+	auto multicast_ttl() const noexcept -> std::uint8_t;
 
 private:
 	auto visit_event(event_packet_type const& event_v) -> tftp_server_v4&;
-	auto visit_event(event_notify_type const& event_v) -> tftp_server_v4&;
 	
-	auto visit_packet(tftp_packet::type_rrq const& packet_v, address_v4 const& source_v) -> tftp_server_v4&;
-	auto visit_packet(tftp_packet::type_wrq const& packet_v, address_v4 const& source_v) -> tftp_server_v4&;
-	auto visit_packet(std::monostate const& packet_v, address_v4 const& source_v) -> tftp_server_v4&;
+	auto visit_packet(tftp_packet::type_rrq const& packet_v, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&;
+	auto visit_packet(tftp_packet::type_wrq const& packet_v, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&;
+	auto visit_packet(std::monostate const& packet_v, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&;
 	
-	template <typename T> auto visit_packet(T const& packet_v, address_v4 const& source_v) -> tftp_server_v4&;	
+	template <typename T> auto visit_packet(T const& packet_v, address_v4 const& source_v, socket_local const& local_v) -> tftp_server_v4&;	
 	
 	void thread_incoming(std::stop_token st);
 	void thread_outgoing(std::stop_token st);
+	void thread_worker(std::stop_token st, worker_type& worker_v);
+
+	/* hands the request to the worker with the fewest sessions */
+	void dispatch(session_request_type request_v);
+	/* tftp_weight of the client sections, or of the [tftp_class:name] their tftp_class names, by the client's address */
+	void initialize_weights(config_ini const& cfg);
 	 
 	address_v4		m_address;
 	path					m_base_dir;
+	tftp_io_engine	m_io_engine{ tftp_io_engine::classic };
 	socket_udp		m_sock;
+	packet_pool		m_pool;
 	event_queue		m_events;
-	session_list	m_session_list;
+	unsigned			m_worker_count{ 1u };
+	bool					m_latency_stats{ false };
+	std::int32_t	m_receive_buffer{ 0 };
+	std::int32_t	m_send_buffer{ 0 };
+	packet_latency	m_latency;
+	std::vector<std::unique_ptr<worker_type>> m_workers;
+	mutable tftp_file_cache	m_file_cache;
+	mutable tftp_netascii_cache	m_netascii_cache;
+	tftp_upload_mode	m_upload_mode{ tftp_upload_mode::off };
+	unsigned					m_upload_writers{ 2u };
+	unsigned					m_cache_loaders{ 2u };
+	unsigned					m_uring_buffers{ 64u };
+	std::uintmax_t		m_upload_limit{ 0x4000000u };
+	mutable tftp_write_behind	m_write_behind;
+	mutable tftp_scheduler	m_scheduler;
+	mutable std::mutex	m_window_lock;		/* also guards m_pacing_hints */
+	mutable tftp_hint_table<std::uintmax_t> m_window_hints;
+	std::uint64_t	m_pacing_rate{ 0u };
+	bool					m_pacing_auto{ false };
+	mutable tftp_hint_table<std::uint64_t> m_pacing_hints;
+	address_v4		m_multicast;
+	std::uint8_t	m_multicast_ttl{ 1u };
+	mutable std::mutex	m_multicast_lock;
+	mutable std::vector<bool>	m_multicast_used;
 
 	std::jthread	m_thread_incoming;
 	std::jthread	m_thread_outgoing;
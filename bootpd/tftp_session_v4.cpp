@@ -1,186 +1,843 @@
 #include "tftp_session_v4.hpp"
 #include "tftp_server_v4.hpp"
 #include "tftp_reader.hpp"
+#include "tftp_consts.hpp"
 
 #include <common/logger.hpp>
 
-#include <fstream>
+#include <array>
+#include <charconv>
 #include <chrono>
+#include <random>
 #include <algorithm>
+#include <type_traits>
+#include <utility>
 
-bool tftp_session_v4::is_done() const 
-{ return m_done; }
+tftp_session_v4::tftp_session_v4(tftp_server_v4 const& parent, address_v4 remote, request_type request, socket_local const& local)
+:	m_parent		{ parent },
+	m_remote		{ remote },
+	m_address		{ local.address ? address_v4(local.address, 0u) : parent.address().port(0) },
+	m_request		{ std::move(request) },
+	m_base_dir	{ parent.base_dir() },
+	m_engine		{ parent.io_engine() },
+	m_socket		{ m_address.make_udp() }
+{}
 
-void tftp_session_v4::io_thread(tftp_server_v4& parent_v, address_v4 remote_client_v, tftp_packet::type_rrq request_v, std::stop_token token_v)
+tftp_session_v4::~tftp_session_v4()
+{
+	m_parent.scheduler().leave(m_flow);
+	if (is_multicast())
+		m_parent.multicast_release(m_group);
+}
+
+bool tftp_session_v4::is_done() const
+{ return m_state == state_type::done; }
+
+auto tftp_session_v4::socket() const noexcept -> socket_udp const&
+{ return m_socket; }
+
+auto tftp_session_v4::deadline() const noexcept -> clock_type::time_point
+{ return m_deadline; }
+
+auto tftp_session_v4::state() const noexcept -> state_type
+{ return m_state; }
+
+auto tftp_session_v4::group_key() const noexcept -> std::string const&
+{ return m_group_key; }
+
+auto tftp_session_v4::is_multicast() const noexcept -> bool
+{ return m_group.addr() != 0u; }
+
+auto tftp_session_v4::group_key(request_type const& request) -> std::string
+{
+	using namespace std::string_literals;
+	const auto request_v = std::get_if<tftp_packet::type_rrq>(&request);
+	if (!request_v || request_v->xfermode != "octet"s || !request_v->options.contains("multicast"s))
+		return {};
+	const auto it = request_v->options.find("blksize"s);
+	return std::format("{}:{}", std::filesystem::path(request_v->filename).lexically_normal().generic_string(), it != request_v->options.end() ? it->second : "512"s);
+}
+
+auto tftp_session_v4::join(address_v4 remote, request_type const& request) -> bool
 {
-	using namespace std::chrono_literals;	
-	using namespace std::string_view_literals;
 	using namespace std::string_literals;
-	using std::chrono::system_clock;
+	using namespace std::string_view_literals;
+	if (m_state == state_type::done || !is_multicast())
+		return false;
+	/* the master asking again gets its OACK with the next retransmission */
+	if (remote == m_remote)
+		return true;
+	auto it = std::ranges::find(m_members, remote, &member_type::remote);
+	if (it == m_members.end())
+	{
+		const auto& options_v = std::get<tftp_packet::type_rrq>(request).options;
+		tftp_packet::dictionary_type oack_v;
+		for (auto&& [key_v, value_v] : m_oack)
+			if (options_v.contains(key_v))
+				oack_v.emplace(key_v, value_v);
+		it = m_members.insert(m_members.end(), member_type{ remote, std::move(oack_v) });
+		Glog.info("Client '{}' joined the multicast transfer of {} at block {} ({} clients waiting) ... "sv,
+			remote.to_string(), std::get<tftp_packet::type_rrq>(m_request).filename, m_acked + 1u, m_members.size());
+	}
+	auto oack_v = it->oack;
+	oack_v.insert_or_assign("multicast"s, multicast_option(false));
+	/* a client that doesn't get it asks again */
+	m_socket.try_send(std::nothrow, tftp_packet::make_oack(oack_v), remote, 0);
+	return true;
+}
 
+void tftp_session_v4::start()
+{
 	try
 	{
+		std::visit([this] (auto const& request_v) { start(request_v); }, m_request);
+	}
+	catch (...)
+	{
+		m_state = state_type::done;
+		throw;
+	}
+}
 
-		auto socket_v { m_address.make_udp() };
-		socket_v.timeout(1s);
-		validate_request(request_v, socket_v, remote_client_v);
+void tftp_session_v4::start(tftp_packet::type_rrq const& request_v)
+{
+	validate_request(request_v);
 
-		auto file_path_v { m_base_dir / request_v.filename };
-		validate_filepath(file_path_v, socket_v, remote_client_v);
+	auto file_path_v { m_base_dir / request_v.filename };
+	validate_filepath(file_path_v);
 
-		options_type options_v
+	/* netascii sends, and so announces, the translation rather than the file, it starts once the file is indexed */
+	m_progress = clock_type::now();
+	if (request_v.xfermode != "octet")
+	{
+		m_index = m_parent.netascii_cache().acquire(file_path_v);
+		m_state = state_type::indexing;
+		await_index();
+		return;
+	}
+	serve(request_v, file_path_v, {});
+}
+
+/* the netascii cache indexes the file on its own threads, the session looks again every INDEX_POLL until it's done */
+void tftp_session_v4::await_index()
+{
+	using namespace std::chrono_literals;
+	if (m_index.wait_for(0s) != std::future_status::ready)
+	{
+		if (clock_type::now() - m_progress >= MAX_RETRIES * m_options.timeout)
 		{
-			.blksize	= 512u,
-			.timeout	= 1u,
-			.tsize		= file_size(file_path_v)
-		};
-		
-		validate_options(options_v, request_v, socket_v, remote_client_v, token_v);		
-		socket_v.timeout(1s * options_v.timeout);
-		tftp_reader reader_v (file_path_v, options_v.tsize, options_v.blksize, request_v.xfermode == "octet");
-		
-		Glog.info("Starting transfer of {} to '{}' (file_size = {} bytes, blksize = {} bytes, timeout = {} sec)  ... "sv, 
-			request_v.filename, remote_client_v.to_string(), options_v.tsize, options_v.blksize, options_v.timeout);
-		
-		std::uint32_t retry_counter_v { MAX_RETRIES };		
-		for (;!token_v.stop_requested() && retry_counter_v > 0u; --retry_counter_v)
-		try
-		{			
-			socket_v.send(reader_v.data(), remote_client_v, 0);
-			auto [from_client_v, packet_bits_v] = socket_v.recv(0);		
-			validate_source(remote_client_v, from_client_v, socket_v);
-			tftp_packet packet_v(packet_bits_v);
-			validate_ack(packet_v, socket_v, remote_client_v, reader_v.number());	
-			retry_counter_v = MAX_RETRIES;
-			if (reader_v.last())
-				break;
-			reader_v.next();
+			m_state = state_type::done;
+			m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::undefined, "TFTP operation timed out."), m_remote, 0);
+			throw std::runtime_error("Failed to index file for netascii, too many retries.");
 		}
-		catch(error_socket_timed_out)
-		{ continue; }
+		m_deadline = clock_type::now() + INDEX_POLL;
+		return;
+	}
+	tftp_netascii_cache::index_type index_v;
+	try
+	{
+		index_v = std::exchange(m_index, {}).get();
+	}
+	catch (...)
+	{
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::undefined, "Failed to read file."), m_remote, 0);
+		throw;
+	}
+	const auto& request_v = std::get<tftp_packet::type_rrq>(m_request);
+	serve(request_v, m_base_dir / request_v.filename, std::move(index_v));
+}
+
+void tftp_session_v4::serve(tftp_packet::type_rrq const& request_v, std::filesystem::path const& file_path_v, tftp_netascii_cache::index_type netascii_v)
+{
+	using namespace std::string_view_literals;
+	using namespace std::chrono_literals;
+
+	const auto is_binary_v = !netascii_v;
+	m_options = options_type
+	{
+		.blksize	= 512u,
+		.timeout	= 1s,
+		.tsize		= netascii_v ? netascii_v->size : file_size(file_path_v)
+	};
+	validate_options(request_v);
+	m_rto = m_options.timeout;
+	m_progress = clock_type::now();
+	m_flow = m_parent.scheduler().enroll(m_remote, m_options.tsize);
+	pace(m_parent.pacing_hint(m_remote));
+	m_reader = std::make_unique<tftp_reader>(file_path_v, m_options.tsize, m_options.blksize, is_binary_v, m_engine,
+		is_binary_v ? m_parent.file_cache().acquire(file_path_v, m_options.blksize) : tftp_file_cache::pending_type{}, netascii_v);
+
+	Glog.info("Starting transfer of {} to '{}' (file_size = {} bytes, blksize = {} bytes, timeout = {} ms, windowsize = {})  ... "sv,
+		request_v.filename, m_remote.to_string(), m_options.tsize, m_options.blksize, m_options.timeout.count() / 1000.0, m_options.windowsize);
+	if (is_multicast())
+		Glog.info("* Multicast to '{}', other clients may join."sv, m_group.to_string());
+
+	m_state = m_oack.empty() ? state_type::data_sent : state_type::oack_sent;
+	transmit();
+	arm_timer();
+}
+
+void tftp_session_v4::start(tftp_packet::type_wrq const& request_v)
+{
+	using namespace std::string_literals;
+	using namespace std::string_view_literals;
+	using namespace std::chrono_literals;
+
+	if (m_parent.upload_mode() == tftp_upload_mode::off) {
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::access_violation, "Uploads are not allowed."), m_remote, 0);
+		throw std::runtime_error("Upload refused, see tftp_upload: "s + request_v.filename);
+	}
+	validate_request(request_v);
+
+	auto file_path_v { m_base_dir / request_v.filename };
+	validate_upload(request_v.filename, file_path_v);
+
+	m_options = options_type
+	{
+		.blksize	= 512u,
+		.timeout	= 1s,
+		.tsize		= 0u
+	};
+	validate_options(request_v);
+	/* the announced size gets preallocated, so it is held to the limit before anything is allocated */
+	if (m_options.tsize > m_parent.upload_limit()) {
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::disk_full), m_remote, 0);
+		throw std::runtime_error(std::format("Upload of {} bytes is larger than tftp_upload_max_size: {}"sv, m_options.tsize, request_v.filename));
+	}
+	m_rto = m_options.timeout;
+	m_progress = clock_type::now();
+	try
+	{
+		m_writer = std::make_unique<tftp_writer>(m_parent.write_behind(), file_path_v, m_options.tsize, m_parent.upload_mode() == tftp_upload_mode::overwrite);
+	}
+	catch (...)
+	{
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::disk_full), m_remote, 0);
+		throw;
+	}
+
+	Glog.info("Starting upload of {} from '{}' (file_size = {} bytes, blksize = {} bytes, timeout = {} ms, windowsize = {})  ... "sv,
+		request_v.filename, m_remote.to_string(), m_options.tsize, m_options.blksize, m_options.timeout.count() / 1000.0, m_options.windowsize);
+
+	m_state = m_oack.empty() ? state_type::ack_sent : state_type::oack_sent;
+	transmit();
+	arm_timer();
+}
+
+void tftp_session_v4::on_readable()
+{
+	using namespace std::string_view_literals;
+	thread_local std::array<std::byte, 0x10000u> buffer_v;
+
+	while (m_state != state_type::done)
+	{
+		std::span<std::byte> bits_v{ buffer_v };
+		address_v4 from_client_v;
+		const auto received_v = m_socket.poll(std::nothrow, bits_v, from_client_v, 0);
+		if (!received_v && received_v.error() == std::errc::operation_would_block)
+			return;
+		if (!received_v)
+			v4_socket_throw(received_v.error(), "receive operation timed out.", "failed to receive ACK packet");
+		if (on_member_packet(from_client_v, bits_v) || !validate_source(from_client_v))
+			continue;
+		on_packet(tftp_packet(bits_v));
+	}
+}
+
+void tftp_session_v4::on_packet(tftp_packet const& packet_v)
+{
+	using namespace std::string_view_literals;
 
-		if (!retry_counter_v) {
-			throw std::runtime_error("Failed to send DATA packet, too many retries."s);
+	if (m_writer)
+	{
+		on_data(packet_v);
+		return;
+	}
+
+	/* a multicast transfer outlives its master, as long as someone still waits for the file */
+	if (is_multicast() && packet_v.is<tftp_packet::type_error>() && !m_members.empty())
+	{
+		Glog.warning("Master client '{}' left the multicast transfer : {}"sv, m_remote.to_string(), packet_v.to_string());
+		promote();
+		return;
+	}
+
+	const auto acked_v = validate_ack(packet_v);
+	if (!acked_v)
+		return;
+
+	m_progress = clock_type::now();
+	if (!m_resending)
+		sample_rtt(m_progress - m_sent_at);
+	if (m_state == state_type::data_sent && *acked_v > m_acked && m_pacing > 0u && m_parent.pacing_auto())
+		sample_delivery(*acked_v - m_acked, m_progress - m_sent_at);
+	/* only a master that took over mid transfer can have every block already when answering the OACK */
+	if (m_state == state_type::oack_sent)
+		m_state = state_type::data_sent;
+	if (*acked_v == m_reader->count())
+	{
+		m_acked = *acked_v;
+		finish();
+		return;
+	}
+	/* an ACK short of the window end means the client hit a gap (RFC 7440), the window restarts after it */
+	m_acked = *acked_v;
+	transmit();
+	arm_timer();
+}
+
+void tftp_session_v4::on_data(tftp_packet const& packet_v)
+{
+	const auto block_v = validate_data(packet_v);
+	/* the last ACK went missing, the client sends its last block again */
+	if (m_state == state_type::closing)
+	{
+		transmit();
+		return;
+	}
+	if (!block_v)
+	{
+		/* a gap or a window sent again gets the ACK to the last block in order right away (RFC 7440), once per stall,
+		   unless that ACK is being held back */
+		if (!m_resending && m_state != state_type::writing)
+		{
+			m_resending = true;
+			transmit();
+			arm_timer();
 		}
+		return;
+	}
 
-		Glog.info("Finished sending {} to '{}' ... "sv, request_v.filename, remote_client_v.to_string());
+	const auto& data_v = packet_v.as<tftp_packet::type_data>().data;
+	if (m_writer->size() + data_v.size() > m_parent.upload_limit())
+	{
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::disk_full), m_remote, 0);
+		throw std::runtime_error(std::format("Upload of {} is larger than tftp_upload_max_size.", std::get<tftp_packet::type_wrq>(m_request).filename));
+	}
+	try
+	{
+		m_writer->append(data_v);
 	}
-	catch (std::exception const& e)
-	{ Glog.error("{}"sv, e.what()); }
 	catch (...)
-	{ Glog.error("Unhandled exception"sv); }
-	
-	m_done.store(true);
-	parent_v.session_notify(this);
+	{
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::disk_full), m_remote, 0);
+		throw;
+	}
+	m_acked = *block_v;
+	m_progress = clock_type::now();
+	m_resending = false;
+	m_state = state_type::ack_sent;
+	/* the data is only buffered, the write behind puts it on disk */
+	if (data_v.size() < m_options.blksize)
+		finish();
+	if (m_state == state_type::ack_sent && m_acked - m_sent >= m_options.windowsize && !m_writer->caught_up())
+	{
+		m_state = state_type::writing;
+		await_writer();
+		return;
+	}
+	if (m_state == state_type::closing || m_acked - m_sent >= m_options.windowsize)
+		transmit();
+	arm_timer();
+}
+
+/* the client sends the next window only once this one is ACKed, a disk slower than the network holds the ACK back
+   rather than queue up the whole upload in memory, the session looks again every WRITE_POLL */
+void tftp_session_v4::await_writer()
+{
+	if (!m_writer->caught_up())
+	{
+		if (clock_type::now() - m_progress >= MAX_RETRIES * m_options.timeout)
+		{
+			m_state = state_type::done;
+			m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::undefined, "TFTP operation timed out."), m_remote, 0);
+			throw std::runtime_error(std::format("Failed to write upload of {}, the disk fell too far behind.", std::get<tftp_packet::type_wrq>(m_request).filename));
+		}
+		m_deadline = clock_type::now() + WRITE_POLL;
+		return;
+	}
+	m_state = state_type::ack_sent;
+	transmit();
+	arm_timer();
 }
 
-void tftp_session_v4::validate_source(address_v4 const& remote_client_v, address_v4 const& from_client_v, socket_udp& socket_v)
+void tftp_session_v4::on_timeout()
 {
+	using namespace std::string_literals;
 	using namespace std::string_view_literals;
-	if (remote_client_v != from_client_v) {
-		std::string error = std::format("Expected packet from '{}', instead packet arrived from '{}', ignoring ..."sv, remote_client_v.to_string(), from_client_v.to_string());
-		socket_v.send(tftp_packet::make_error(tftp_packet::unknown_transfer_id, "Invalid source address."), from_client_v, 0);
+	if (m_state == state_type::done)
+		return;
+	if (m_state == state_type::closing)
+	{
+		m_state = state_type::done;
+		return;
+	}
+	if (m_state == state_type::indexing)
+	{
+		await_index();
+		return;
 	}
+	if (m_state == state_type::writing)
+	{
+		await_writer();
+		return;
+	}
+	/* the window is still waiting for its turn, nothing was lost */
+	if (m_paced != clock_type::time_point{})
+	{
+		transmit();
+		arm_timer();
+		return;
+	}
+	if (clock_type::now() - m_progress >= MAX_RETRIES * m_options.timeout && is_multicast() && !m_members.empty())
+	{
+		Glog.warning("Master client '{}' of the multicast transfer stopped responding."sv, m_remote.to_string());
+		promote();
+		return;
+	}
+	if (clock_type::now() - m_progress >= MAX_RETRIES * m_options.timeout)
+	{
+		const auto what_v = m_state == state_type::data_sent ? "DATA"s : m_state == state_type::ack_sent ? "ACK"s : "OACK"s;
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::undefined, "TFTP operation timed out."), m_remote, 0);
+		throw std::runtime_error("Failed to send " + what_v + " packet, too many retries.");
+	}
+	m_rto = std::min<clock_type::duration>(m_rto * 2, m_options.timeout);
+	transmit();
+	arm_timer();
 }
 
-void tftp_session_v4::validate_ack(tftp_packet const& packet_v, socket_udp& socket_v, address_v4 const& remote_client_v, std::uintmax_t number_v)
+/* (re)sends the window following the last acknowledged block */
+void tftp_session_v4::transmit()
+{
+	const auto now_v = clock_type::now();
+	if (m_state == state_type::oack_sent)
+	{
+		m_resending = m_sent_at != clock_type::time_point{};
+		m_sent_at = now_v;
+		m_blocked = !send_control(tftp_packet::make_oack(m_oack));
+		return;
+	}
+	if (m_writer)
+	{
+		m_sent = m_acked;
+		m_blocked = !send_control(tftp_packet::make_ack(m_acked & 0xffffu));
+		return;
+	}
+	const auto end_v = std::min(m_acked + m_options.windowsize, m_reader->count());
+	if (!m_parent.scheduler().admit(m_flow, (end_v - m_acked)*m_options.blksize))
+	{
+		if (m_paced == clock_type::time_point{})
+			m_paced = now_v;
+		return;
+	}
+	/* time spent waiting for the scheduler doesn't count against the client */
+	if (m_paced != clock_type::time_point{})
+	{
+		m_progress += now_v - m_paced;
+		m_paced = {};
+	}
+	const auto resent_v = std::min(m_sent, end_v) - m_acked;
+	m_resent += resent_v;
+	m_resending = resent_v > 0u;
+	m_sent_at = now_v;
+	m_window = end_v;
+	m_reader->seek(m_acked + 1u);
+	send_window();
+}
+
+/* sends from the reader's block to the end of the window, in GSO bursts where the reader can, until the socket buffer is full */
+void tftp_session_v4::send_window()
+{
+	const auto& target_v = is_multicast() ? m_group : m_remote;
+	for (;; m_reader->next())
+	{
+		if (m_reader->send_burst(m_socket, target_v, m_window) == 0u)
+		{
+			m_reader->flush();
+			m_blocked = true;
+			return;
+		}
+		m_sent = std::max(m_sent, m_reader->number());
+		if (m_reader->number() >= m_window)
+			break;
+	}
+	m_reader->flush();
+	m_blocked = false;
+}
+
+/* never waits for the socket, false when the send buffer is full */
+auto tftp_session_v4::send_control(tftp_packet const& packet_v) -> bool
+{
+	const auto sent_v = m_socket.try_send(std::nothrow, packet_v, m_remote, 0);
+	if (!sent_v && sent_v.error() != std::errc::operation_would_block)
+		v4_socket_throw(sent_v.error(), "send operation timed out.", "failed to send packet");
+	return sent_v.has_value();
+}
+
+/* the socket has room again, what didn't fit goes out now: the rest of the window, or the OACK or ACK again */
+void tftp_session_v4::on_writable()
+{
+	if (!m_blocked || m_state == state_type::done)
+		return;
+	if (m_state == state_type::data_sent)
+		send_window();
+	else
+		transmit();
+}
+
+/* the worker's io_uring couldn't send part of the window, it goes out again from there once the socket is writable */
+void tftp_session_v4::on_stalled()
+{
+	const auto unsent_v = m_reader ? m_reader->unsent() : std::nullopt;
+	if (!unsent_v || m_state != state_type::data_sent || *unsent_v <= m_acked || *unsent_v > m_window)
+		return;
+	m_reader->seek(*unsent_v);
+	m_blocked = true;
+}
+
+auto tftp_session_v4::readiness() const noexcept -> socket_reactor::readiness_type
+{
+	return m_blocked ? socket_reactor::readiness_type(socket_reactor::readiness_read | socket_reactor::readiness_write) : socket_reactor::readiness_read;
+}
+
+/* up to an eighth of the RTO on top, so sessions that lost packets together don't retransmit together,
+   a window waiting for its turn asks again when the scheduler says */
+void tftp_session_v4::arm_timer()
+{
+	if (m_paced != clock_type::time_point{})
+	{
+		m_deadline = m_parent.scheduler().retry_at();
+		return;
+	}
+	thread_local std::minstd_rand random_v{ std::random_device{}() };
+	std::uniform_int_distribution<clock_type::rep> jitter_v(0, m_rto.count() / 8);
+	m_deadline = clock_type::now() + m_rto + clock_type::duration(jitter_v(random_v));
+}
+
+/* auto pacing runs a quarter above the best rate recent windows got through at, fading by an eighth per window
+   so a slower path takes over, random loss leaves it alone and the ACK clock never has to wait for it */
+void tftp_session_v4::sample_delivery(std::uintmax_t blocks_v, clock_type::duration elapsed_v)
+{
+	using std::chrono::duration;
+	const auto seconds_v = std::max(duration<double>(elapsed_v).count(), 1e-6);
+	const auto rate_v = (std::uint64_t)((double)(blocks_v*m_options.blksize) / seconds_v);
+	m_delivery = std::max(rate_v, m_delivery - m_delivery / 8u);
+	pace(std::clamp<std::uint64_t>(m_delivery + m_delivery / 4u, MIN_PACING, std::max(m_parent.pacing_rate(), MIN_PACING)));
+}
+
+/* the socket only follows once the rate moved by a sixteenth, a lock-step transfer would make a call per block */
+void tftp_session_v4::pace(std::uint64_t rate_v)
+{
+	m_pacing = rate_v;
+	if (rate_v == 0u || (rate_v > m_pacing_applied ? rate_v - m_pacing_applied : m_pacing_applied - rate_v) < m_pacing_applied / 16u)
+		return;
+	if (m_socket.pacing_rate(rate_v))
+		m_pacing_applied = rate_v;
+	else
+		m_pacing = 0u;
+}
+
+/* RFC 6298, the negotiated timeout is where the RTO starts and how far it backs off */
+void tftp_session_v4::sample_rtt(clock_type::duration rtt_v)
+{
+	if (m_srtt == clock_type::duration::zero())
+	{
+		m_srtt = rtt_v;
+		m_rttvar = rtt_v / 2;
+	}
+	else
+	{
+		const auto error_v = m_srtt > rtt_v ? m_srtt - rtt_v : rtt_v - m_srtt;
+		m_rttvar = (3 * m_rttvar + error_v) / 4;
+		m_srtt = (7 * m_srtt + rtt_v) / 8;
+	}
+	m_rto = std::clamp<clock_type::duration>(m_srtt + std::max<clock_type::duration>(4 * m_rttvar, MIN_RTO), MIN_RTO, m_options.timeout);
+}
+
+void tftp_session_v4::finish()
+{
+	using namespace std::string_view_literals;
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+	if (m_writer)
+	{
+		m_writer->commit();
+		m_state = state_type::closing;
+		Glog.info("Finished receiving {} from '{}' ({} bytes) ... "sv, std::get<tftp_packet::type_wrq>(m_request).filename, m_remote.to_string(), m_writer->size());
+		return;
+	}
+	const auto& request_v = std::get<tftp_packet::type_rrq>(m_request);
+	Glog.info("Finished sending {} to '{}' ... "sv, request_v.filename, m_remote.to_string());
+	if (is_multicast() && !m_members.empty())
+	{
+		promote();
+		return;
+	}
+	m_state = state_type::done;
+	Glog.debug("* RTT: {} us smoothed, {} us deviation, {} us RTO.",
+		duration_cast<microseconds>(m_srtt).count(), duration_cast<microseconds>(m_rttvar).count(), duration_cast<microseconds>(m_rto).count());
+	if (m_options.windowsize > 1u)
+	{
+		/* one window sent again now and then is fine, past 1% of the blocks the window is too big for the path */
+		m_parent.window_update(m_remote, m_options.windowsize, m_resent * 100u > m_reader->count());
+		Glog.info("* Window: {} blocks, {} blocks sent again.", m_options.windowsize, m_resent);
+	}
+	if (m_pacing > 0u)
+	{
+		m_parent.pacing_update(m_remote, m_pacing);
+		Glog.info("* Pacing: ended at {} bytes per second.", m_pacing);
+	}
+	if (const auto zerocopy_v = m_reader->zerocopy_status(); m_reader->zerocopy_sent() > 0u)
+		Glog.info("* Zero-copy: {} sends, {} completed, {} copied by the kernel.", m_reader->zerocopy_sent(), zerocopy_v.completed, zerocopy_v.copied);
+}
+
+void tftp_session_v4::promote()
+{
+	using namespace std::string_literals;
+	using namespace std::string_view_literals;
+	m_remote = m_members.front().remote;
+	m_oack = std::move(m_members.front().oack);
+	m_oack.insert_or_assign("multicast"s, multicast_option(true));
+	m_members.pop_front();
+	Glog.info("Client '{}' is now the master of the multicast transfer of {} ({} clients waiting) ... "sv,
+		m_remote.to_string(), std::get<tftp_packet::type_rrq>(m_request).filename, m_members.size());
+	/* the new master answers the OACK with an ACK to the block before the first one it is missing */
+	m_state = state_type::oack_sent;
+	m_acked = 0u;
+	m_sent = 0u;
+	m_sent_at = {};
+	m_progress = clock_type::now();
+	transmit();
+	arm_timer();
+}
+
+/* clients waiting for their turn only get to leave, with an ERROR, anything else they send is ignored */
+auto tftp_session_v4::on_member_packet(address_v4 const& from_client_v, std::span<const std::byte> bits_v) -> bool
+{
+	using namespace std::string_view_literals;
+	const auto it = std::ranges::find(m_members, from_client_v, &member_type::remote);
+	if (it == m_members.end())
+		return false;
+	if (tftp_packet packet_v(bits_v); packet_v.is<tftp_packet::type_error>())
+	{
+		Glog.info("Client '{}' left the multicast transfer : {}"sv, from_client_v.to_string(), packet_v.to_string());
+		m_members.erase(it);
+	}
+	return true;
+}
+
+/* "addr,port,mc" (RFC 2090), mc tells the client whether it is the one to ACK */
+auto tftp_session_v4::multicast_option(bool is_master) const -> std::string
+{
+	return std::format("{},{},{}", v4_address_to_string(m_group.addr()), m_group.port(), is_master ? 1 : 0);
+}
+
+auto tftp_session_v4::validate_source(address_v4 const& from_client_v) -> bool
+{
+	using namespace std::string_view_literals;
+	if (m_remote != from_client_v) {
+		Glog.warning("Expected packet from '{}', instead packet arrived from '{}', ignoring ..."sv, m_remote.to_string(), from_client_v.to_string());
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::unknown_transfer_id, "Invalid source address."), from_client_v, 0);
+		return false;
+	}
+	return true;
+}
+
+/* duplicate ACKs of earlier blocks are ignored (RFC 1350, sorcerer's apprentice) */
+auto tftp_session_v4::validate_ack(tftp_packet const& packet_v) -> std::optional<std::uintmax_t>
 {
 	using namespace std::string_view_literals;
 	if (packet_v.is<tftp_packet::type_error>()) {
+		m_state = state_type::done;
 		throw std::runtime_error(std::format("Connection terminated : {}"sv, packet_v.to_string()));
 	}
 
 	if (!packet_v.is<tftp_packet::type_ack>()) {
-		socket_v.send(tftp_packet::make_error(tftp_packet::illegal_operation), remote_client_v, 0);
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::illegal_operation), m_remote, 0);
 		throw std::runtime_error(std::format("Expected ACK packet, received : {}"sv, packet_v.to_string()));
 	}
 
-	if (packet_v.as<tftp_packet::type_ack>().block_id != (number_v & 0xffffu)) {
-		socket_v.send(tftp_packet::make_error(tftp_packet::illegal_operation), remote_client_v, 0);
-		throw std::runtime_error(std::format("Expected ACK to block: {}, received : {}"sv, number_v & 0xffffu, packet_v.as<tftp_packet::type_ack>().block_id));
+	const auto block_id_v = packet_v.as<tftp_packet::type_ack>().block_id;
+	/* RFC 2090 block numbers don't wrap, and the master asks for the block after the one it ACKs, wherever that is */
+	if (is_multicast())
+	{
+		if (block_id_v > m_reader->count()) {
+			m_state = state_type::done;
+			m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::illegal_operation), m_remote, 0);
+			throw std::runtime_error(std::format("Expected ACK to blocks up to {}, received : {}"sv, m_reader->count(), block_id_v));
+		}
+		if (m_state != state_type::oack_sent && block_id_v <= m_acked)
+			return std::nullopt;
+		return block_id_v;
 	}
+
+	/* block numbers wrap, anything up to half the number space behind the last ACK is old news */
+	const auto ahead_v = (std::uint16_t)(block_id_v - (m_acked & 0xffffu));
+	if (m_state == state_type::oack_sent && block_id_v == 0u)
+		return 0u;
+	if (ahead_v == 0u || ahead_v >= 0x8000u)
+		return std::nullopt;
+
+	if (ahead_v > m_sent - m_acked) {
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::illegal_operation), m_remote, 0);
+		throw std::runtime_error(std::format("Expected ACK to blocks {}..{}, received : {}"sv, (m_acked + 1u) & 0xffffu, m_sent & 0xffffu, block_id_v));
+	}
+	return m_acked + ahead_v;
 }
 
-void tftp_session_v4::validate_request(tftp_packet::type_rrq const& request, socket_udp& socket_v, address_v4 const& remote_client)
+auto tftp_session_v4::validate_data(tftp_packet const& packet_v) -> std::optional<std::uintmax_t>
+{
+	using namespace std::string_view_literals;
+	if (packet_v.is<tftp_packet::type_error>()) {
+		m_state = state_type::done;
+		throw std::runtime_error(std::format("Connection terminated : {}"sv, packet_v.to_string()));
+	}
+
+	if (!packet_v.is<tftp_packet::type_data>()) {
+		m_state = state_type::done;
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::illegal_operation), m_remote, 0);
+		throw std::runtime_error(std::format("Expected DATA packet, received : {}"sv, packet_v.to_string()));
+	}
+
+	/* blocks past a gap are dropped, the client sends them again after the ACK */
+	if (packet_v.as<tftp_packet::type_data>().block_id != ((m_acked + 1u) & 0xffffu))
+		return std::nullopt;
+	return m_acked + 1u;
+}
+
+/* uploads stay below the base directory and go to a directory that is already there */
+void tftp_session_v4::validate_upload(std::string const& filename_v, std::filesystem::path const& file_path_v)
+{
+	using namespace std::string_literals;
+
+	const auto relative_v = std::filesystem::path(filename_v).lexically_normal();
+	if (relative_v.empty() || relative_v.has_root_path() || *relative_v.begin() == ".." || !relative_v.has_filename()) {
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::access_violation), m_remote, 0);
+		throw std::runtime_error("Upload outside of the base directory: "s + filename_v);
+	}
+
+	if (exists(file_path_v) && (m_parent.upload_mode() != tftp_upload_mode::overwrite || !is_regular_file(file_path_v))) {
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::file_already_exists), m_remote, 0);
+		throw std::runtime_error("File already exists: "s + file_path_v.string());
+	}
+
+	if (!is_directory(file_path_v.parent_path())) {
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::file_not_found), m_remote, 0);
+		throw std::runtime_error("Directory not found: "s + file_path_v.parent_path().string());
+	}
+}
+
+template <typename Request>
+void tftp_session_v4::validate_request(Request const& request)
 {
 	using namespace std::string_literals;
 
 	if (request.xfermode != "octet"s && request.xfermode != "netascii"s) {
-		socket_v.send(tftp_packet::make_error(tftp_packet::illegal_operation), remote_client, 0);
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::illegal_operation), m_remote, 0);
 		throw std::runtime_error("Unsupported transfer mode: "s + request.xfermode);
 	}
 }
 
-void tftp_session_v4::validate_options(options_type& options_v, tftp_packet::type_rrq const& request_v, socket_udp& socket_v, address_v4 const& remote_client_v, std::stop_token token_v)
+/* the value of a numeric option, empty when it isn't a number or doesn't fit */
+static auto option_number(std::string const& text_v) -> std::optional<std::uintmax_t>
+{
+	std::uintmax_t value_v{ 0u };
+	const auto [last_v, error_v] = std::from_chars(text_v.data(), text_v.data() + text_v.size(), value_v);
+	if (error_v != std::errc{} || last_v != text_v.data() + text_v.size())
+		return std::nullopt;
+	return value_v;
+}
+
+template <typename Request>
+void tftp_session_v4::validate_options(Request const& request_v)
 {
 	using namespace std::string_literals;
-	using namespace std::chrono_literals;
-	tftp_packet::dictionary_type oack_v;
+	using namespace std::string_view_literals;
+	static constexpr const auto is_upload_v = std::is_same_v<Request, tftp_packet::type_wrq>;
 
 	const auto& dict_v = request_v.options;
 
-	if (dict_v.empty ())
-		return;
-
+	/* everything after this divides by the block size, one out of range ends the transfer before it starts */
 	if (auto it = dict_v.find("blksize"s); it != dict_v.end()) {
-		options_v.blksize = std::stoull((*it).second);
-		oack_v.emplace(*it);
+		const auto blksize_v = option_number((*it).second);
+		if (!blksize_v || *blksize_v < TFTP_MIN_BLKSIZE || *blksize_v > TFTP_MAX_BLKSIZE) {
+			m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::option_negotiation), m_remote, 0);
+			throw std::runtime_error("Invalid blksize: "s + (*it).second);
+		}
+		m_options.blksize = *blksize_v;
+		m_oack.emplace("blksize"s, std::to_string(*blksize_v));
 	}
-	
+
+	/* a timeout that isn't a number is left out of the OACK, the client then keeps the default (RFC 2347) */
 	if (auto it = dict_v.find("timeout"s); it != dict_v.end()) {
-		options_v.timeout = std::stoull((*it).second);
-		oack_v.emplace(*it);
+		if (const auto value_v = option_number((*it).second); value_v) {
+			const auto seconds_v = std::clamp<std::uintmax_t>(*value_v, 1u, 255u);
+			m_options.timeout = std::chrono::seconds(seconds_v);
+			m_oack.emplace("timeout"s, std::to_string(seconds_v));
+		}
 	}
 
+	/* tftp-hpa's sub-second variant, in microseconds, wins over timeout */
+	if (auto it = dict_v.find("utimeout"s); it != dict_v.end()) {
+		if (const auto value_v = option_number((*it).second); value_v) {
+			m_options.timeout = std::chrono::microseconds(std::clamp<std::uintmax_t>(*value_v, 10000u, 255000000u));
+			m_oack.emplace("utimeout"s, std::to_string(m_options.timeout.count()));
+		}
+	}
+
+	/* a reader is told the size of the file, a writer tells the size of its upload (RFC 2349), the upload limit goes by it */
 	if (auto it = dict_v.find("tsize"s); it != dict_v.end()) {
-		oack_v.emplace("tsize"s, std::to_string(options_v.tsize));		
+		if (is_upload_v) {
+			const auto tsize_v = option_number((*it).second);
+			if (!tsize_v) {
+				m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::option_negotiation), m_remote, 0);
+				throw std::runtime_error("Invalid tsize: "s + (*it).second);
+			}
+			m_options.tsize = *tsize_v;
+		}
+		m_oack.emplace("tsize"s, std::to_string(m_options.tsize));
 	}
-	
-	std::uint32_t retry_counter_v { MAX_RETRIES };
-	for(;!token_v.stop_requested() && retry_counter_v > 0u; --retry_counter_v)
-	try
-	{				
-		socket_v.send(tftp_packet::make_oack(oack_v), remote_client_v, 0);
-		auto [from_client_v, packet_bits_v] = socket_v.recv(0);
-		validate_source(remote_client_v, from_client_v, socket_v);
-		tftp_packet packet_v(packet_bits_v);
-		validate_ack(packet_v, socket_v, remote_client_v, 0u);
-		return;
+
+	/* the server may grant less than asked, the client has to go with the OACK, one that isn't a number is left out of it */
+	if (auto it = dict_v.find("windowsize"s); it != dict_v.end()) {
+		if (const auto value_v = option_number((*it).second); value_v) {
+			const auto requested_v = std::clamp<std::uintmax_t>(*value_v, 1u, MAX_WINDOW);
+			m_options.windowsize = is_upload_v ? requested_v : m_parent.window_hint(m_remote, requested_v);
+			m_oack.emplace("windowsize"s, std::to_string(m_options.windowsize));
+		}
 	}
-	catch(error_socket_timed_out const&)
-	{ continue; }
-	
-	if (!retry_counter_v) {
-		Glog.error("OACK has timed out."s);
-		socket_v.send(tftp_packet::make_error(tftp_packet::undefined, "TFTP operation timed out."), remote_client_v, 0);
-		throw std::runtime_error("Failed to send OACK packet, too many retries."s);
+
+	/* RFC 2090, lock step with the master and block numbers that don't wrap, otherwise the client falls back to unicast */
+	if (!is_upload_v && dict_v.contains("multicast"s) && request_v.xfermode == "octet"s && m_options.tsize / m_options.blksize < 0xffffu) {
+		if (const auto group_v = m_parent.multicast_acquire(); group_v) {
+			m_group = *group_v;
+			m_group_key = group_key(m_request);
+			m_options.windowsize = 1u;
+			m_oack.erase("windowsize"s);
+			m_oack.emplace("multicast"s, multicast_option(true));
+			if (!m_socket.multicast_enable(m_address, m_parent.multicast_ttl()))
+				Glog.warning("Failed to set up multicast sends from '{}', the group may not be reached."sv, m_address.to_string());
+		}
 	}
 }
 
-void tftp_session_v4::validate_filepath(std::filesystem::path const& file_path_v, socket_udp& socket_v, address_v4 const& remote_client)
+void tftp_session_v4::validate_filepath(std::filesystem::path const& file_path_v)
 {
 	using namespace std::string_literals;
-	
+
 	if (!exists(file_path_v)) {
-		socket_v.send(tftp_packet::make_error(tftp_packet::file_not_found), remote_client, 0);
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::file_not_found), m_remote, 0);
 		throw std::runtime_error("File not found: "s + file_path_v.string());
 	}
 
 	if (!is_regular_file(file_path_v)) {
-		socket_v.send(tftp_packet::make_error(tftp_packet::file_not_found), remote_client, 0);
+		m_socket.try_send(std::nothrow, tftp_packet::make_error(tftp_packet::file_not_found), m_remote, 0);
 		throw std::runtime_error("Not a file: "s + file_path_v.string());
 	}
 }
-
-void tftp_session_v4::io_thread(tftp_server_v4& parent_v, address_v4 remote_client_v, tftp_packet::type_wrq request_v, std::stop_token token_v)
-{
-	using namespace std::chrono_literals;
-	auto socket_v = m_address.make_udp();
-	
-	socket_v.send(tftp_packet::make_error(tftp_packet::access_violation, "Not upload implemented."), remote_client_v, 0);
-
-	Glog.error("TFTP upload not implemented.");
-	m_done.store(true);
-	parent_v.session_notify(this);
-}
-
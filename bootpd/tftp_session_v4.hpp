@@ -1,56 +1,187 @@
 #pragma once
 
-#include <stop_token>
-#include <thread>
-#include <functional>
+#include <chrono>
+#include <memory>
+#include <variant>
+#include <optional>
 #include <filesystem>
+#include <deque>
+#include <string>
+#include <span>
 
 #include <common/address_v4.hpp>
+#include <common/socket_udp.hpp>
+#include <common/socket_reactor.hpp>
 #include <common/config_ini.hpp>
 
 #include  "tftp_packet.hpp"
+#include  "tftp_reader.hpp"
+#include  "tftp_writer.hpp"
+#include  "tftp_scheduler.hpp"
 
 
 struct tftp_server_v4;
 
+/*
+ * One transfer, driven by a tftp_server_v4 worker: start() once, then on_readable()
+ * whenever its socket has datagrams and on_timeout() whenever deadline() passes.
+ * Any of them throws when the transfer fails, the session is done either way.
+ *
+ * Sends never wait for the socket. When its buffer is full the session stops
+ * where it is, readiness() asks for writable too and on_writable() carries on.
+ * The io_uring data path queues the window on the worker's ring instead, sends
+ * the ring had no room for come back through on_stalled(), which does the same.
+ *
+ * A multicast transfer (RFC 2090) sends DATA to a group instead, paced by the ACKs
+ * of one master client. Other clients join() while it runs, and each of them takes
+ * over as master in turn to fetch the blocks it missed.
+ *
+ * An upload (WRQ) runs the other way round, the session ACKs the blocks and
+ * leaves writing them to the server's tftp_write_behind.
+ *
+ * Downloads send every window through the server's tftp_scheduler, a window
+ * that has to wait for its turn makes deadline() the time to ask again.
+ */
 struct tftp_session_v4
 {
+	/* a transfer without progress for MAX_RETRIES times the negotiated timeout fails */
 	static inline const constexpr auto MAX_RETRIES = 10u;
+	/* floor of the retransmission timeout, a LAN round trip is well below but scheduling isn't */
+	static inline const constexpr auto MIN_RTO = std::chrono::milliseconds(10);
+	/* largest windowsize granted (RFC 7440), also keeps a window well inside half the block number space */
+	static inline const constexpr auto MAX_WINDOW = 64u;
+	/* how often a netascii transfer looks whether its file was indexed */
+	static inline const constexpr auto INDEX_POLL = std::chrono::milliseconds(2);
+	/* how often an upload held back by its write behind looks again */
+	static inline const constexpr auto WRITE_POLL = std::chrono::milliseconds(2);
+	/* auto pacing never goes below this many bytes per second */
+	static inline const constexpr std::uint64_t MIN_PACING = 0x10000u;
+
+	using clock_type = std::chrono::steady_clock;
+	using request_type = std::variant<tftp_packet::type_rrq, tftp_packet::type_wrq>;
+
+	enum struct state_type
+	{
+		created,
+		indexing,		/* netascii, waiting for the index of the file to announce and send its translation */
+		oack_sent,		/* waiting for ACK 0 */
+		data_sent,		/* waiting for an ACK to the window (m_acked, m_sent] */
+		ack_sent,			/* upload, waiting for the blocks after m_acked */
+		writing,			/* upload, the ACK to m_acked waits for the write behind to catch up */
+		closing,			/* upload complete, the last ACK goes out again while the client may have missed it */
+		done
+	};
 
 	struct options_type
 	{
 		std::uintmax_t	blksize	{ 512u };
-		std::uintmax_t	timeout	{ 1u };
+		std::chrono::microseconds	timeout	{ std::chrono::seconds(1) };	/* initial and largest RTO */
 		std::uintmax_t	tsize		{ 0u };
+		std::uintmax_t	windowsize	{ 1u };
 	};
 
-	using notify_func_type = std::function<void(tftp_session_v4 const*)>;
+	/* the session socket binds to the local address the request arrived on, when known, so a multihomed server answers from it */
+	tftp_session_v4(tftp_server_v4 const& parent, address_v4 remote, request_type request, socket_local const& local = {});
+	tftp_session_v4(tftp_session_v4 const&) = delete;
+	tftp_session_v4& operator = (tftp_session_v4 const&) = delete;
+ ~tftp_session_v4();
 
-	template <typename P, typename T>
-	tftp_session_v4(P& parent, address_v4 source, T const& request)
-	:	m_address		{ parent.address().port(0) },
-		m_base_dir	{ parent.base_dir() },
-		m_thread		{ [&parent, source, request, this] (auto st) { io_thread(parent, source, request, st); } }
-	{}
+	void start();
+	void on_readable();
+	void on_writable();
+	void on_stalled();
+	void on_timeout();
 
+	/* requests for the same file with the same block size may share a multicast transfer, empty when the request can't */
+	static auto group_key(request_type const& request) -> std::string;
+	/* false when this transfer can't take the client, it then needs a session of its own */
+	auto join(address_v4 remote, request_type const& request) -> bool;
+	/* empty for a unicast transfer */
+	auto group_key() const noexcept -> std::string const&;
+
+	auto socket() const noexcept -> socket_udp const&;
+	auto deadline() const noexcept -> clock_type::time_point;
+	/* what the worker should watch the socket for */
+	auto readiness() const noexcept -> socket_reactor::readiness_type;
+	auto state() const noexcept -> state_type;
 	bool is_done() const;
 
-  void validate_filepath(std::filesystem::path const& file_path_v, socket_udp& socket_v, address_v4 const& remote_client);
-	void validate_request(tftp_packet::type_rrq const& request, socket_udp& socket_v, address_v4 const& remote_client);	
-	
-	void validate_options(options_type& options_v, tftp_packet::type_rrq const& request_v, socket_udp& socket_v, address_v4 const& remote_client_v, std::stop_token token_v);
-	void validate_options(options_type& options_v, tftp_packet::type_wrq const& request_v, socket_udp& socket_v, address_v4 const& remote_client_v, std::stop_token token_v);	
+private:
+	void start(tftp_packet::type_rrq const& request_v);
+	void start(tftp_packet::type_wrq const& request_v);
+	void await_index();
+	void await_writer();
+	void serve(tftp_packet::type_rrq const& request_v, std::filesystem::path const& file_path_v, tftp_netascii_cache::index_type netascii_v);
+	void on_packet(tftp_packet const& packet_v);
+	void on_data(tftp_packet const& packet_v);
+	void transmit();
+	void send_window();
+	auto send_control(tftp_packet const& packet_v) -> bool;
+	void arm_timer();
+	void finish();
+	void sample_rtt(clock_type::duration rtt_v);
+	void pace(std::uint64_t rate_v);
+	void sample_delivery(std::uintmax_t blocks_v, clock_type::duration elapsed_v);
+	/* the next client in line becomes the master, there has to be one */
+	void promote();
+	auto on_member_packet(address_v4 const& from_client_v, std::span<const std::byte> bits_v) -> bool;
+	auto multicast_option(bool is_master) const -> std::string;
+	auto is_multicast() const noexcept -> bool;
 
-  void validate_ack(tftp_packet const& packet_v, socket_udp& socket_v, address_v4 const& remote_client_v, std::uintmax_t number_v);
-	void validate_source(address_v4 const& remote_client_v, address_v4 const& from_client_v, socket_udp& socket_v);
-	
-	void io_thread(tftp_server_v4& parent, address_v4 source, tftp_packet::type_rrq request, std::stop_token st);
-	void io_thread(tftp_server_v4& parent, address_v4 source, tftp_packet::type_wrq request, std::stop_token st);
+	void validate_filepath(std::filesystem::path const& file_path_v);
+	void validate_upload(std::string const& filename_v, std::filesystem::path const& file_path_v);
+	template <typename Request>
+	void validate_request(Request const& request);
+	template <typename Request>
+	void validate_options(Request const& request_v);
+	/* the block acknowledged, empty for a stale or duplicate ACK that moves nothing */
+	auto validate_ack(tftp_packet const& packet_v) -> std::optional<std::uintmax_t>;
+	/* the next block in order, empty for anything else */
+	auto validate_data(tftp_packet const& packet_v) -> std::optional<std::uintmax_t>;
+	auto validate_source(address_v4 const& from_client_v) -> bool;
 
-	
-private:
-	std::atomic<bool> m_done{ false };
-	address_v4 m_address;
-	std::filesystem::path m_base_dir;
-	std::jthread m_thread;
-};
\ No newline at end of file
+	tftp_server_v4 const&			m_parent;
+	address_v4								m_remote;
+	address_v4								m_address;
+	request_type							m_request;
+	std::filesystem::path			m_base_dir;
+	tftp_io_engine						m_engine;
+	socket_udp								m_socket;
+	options_type							m_options;
+	tftp_packet::dictionary_type	m_oack;
+	std::unique_ptr<tftp_reader>	m_reader;
+	std::unique_ptr<tftp_writer>	m_writer;
+	tftp_netascii_cache::pending_type	m_index;
+	state_type								m_state{ state_type::created };
+	std::uintmax_t						m_acked{ 0u };
+	std::uintmax_t						m_sent{ 0u };
+	std::uintmax_t						m_resent{ 0u };
+	std::uintmax_t						m_window{ 0u };		/* last block of the window being sent */
+	bool											m_blocked{ false };	/* the socket buffer was full, the rest goes out in on_writable() */
+	clock_type::time_point		m_deadline;
+
+	/* RFC 6298 estimator, fed only by ACKs to windows sent once (Karn) */
+	clock_type::duration			m_srtt{ 0 };
+	clock_type::duration			m_rttvar{ 0 };
+	clock_type::duration			m_rto{ std::chrono::seconds(1) };
+	clock_type::time_point		m_sent_at;
+	clock_type::time_point		m_progress;
+	bool											m_resending{ false };
+
+	tftp_scheduler::flow_type	m_flow{ 0u };
+	std::uint64_t							m_pacing{ 0u };					/* bytes per second, 0 = not paced */
+	std::uint64_t							m_pacing_applied{ 0u };	/* what the socket was last set to */
+	std::uint64_t							m_delivery{ 0u };				/* bytes per second, recent best, fading */
+	clock_type::time_point		m_paced;		/* since when the window waits for its turn, zero when it doesn't */
+
+	/* RFC 2090, m_remote is the master client, the others wait in line with the OACK they asked for */
+	struct member_type
+	{
+		address_v4										remote;
+		tftp_packet::dictionary_type	oack;
+	};
+
+	address_v4								m_group;
+	std::string								m_group_key;
+	std::deque<member_type>		m_members;
+};
@@ -0,0 +1,217 @@
+#include <stdexcept>
+#include <random>
+#include <format>
+#include <utility>
+#include <algorithm>
+
+#include <common/logger.hpp>
+
+#include "tftp_writer.hpp"
+
+auto to_string(tftp_upload_mode mode) -> std::string_view
+{
+	using namespace std::string_view_literals;
+	switch (mode)
+	{
+	case tftp_upload_mode::off:				return "off"sv;
+	case tftp_upload_mode::create:		return "create"sv;
+	case tftp_upload_mode::overwrite:	return "overwrite"sv;
+	}
+	return "unknown"sv;
+}
+
+tftp_write_behind::~tftp_write_behind()
+{
+	cease();
+}
+
+void tftp_write_behind::start(unsigned threads)
+{
+	for (auto i = 0u; i < std::max(threads, 1u); ++i)
+		m_threads.emplace_back(std::make_unique<thread_type>());
+	for (auto&& thread_v : m_threads)
+		thread_v->thread = std::jthread([this, &thread_v = *thread_v](auto&& st){ thread_writer (st, thread_v); });
+}
+
+void tftp_write_behind::cease()
+{
+	for (auto&& thread_v : m_threads)
+		thread_v->thread.request_stop();
+	for (auto&& thread_v : m_threads)
+		if (thread_v->thread.joinable())
+			thread_v->thread.join();
+	m_threads.clear();
+}
+
+auto tftp_write_behind::open(std::filesystem::path const& target, std::uintmax_t size, bool replace) -> upload_handle
+{
+	thread_local std::mt19937_64 random_v{ std::random_device{}() };
+	auto upload_v = std::make_shared<upload_type>();
+	upload_v->target = target;
+	upload_v->replace = replace;
+	upload_v->temporary = target.parent_path() / std::format(".{}.{:016x}.part", target.filename().string(), random_v());
+	upload_v->file = write_only_file(upload_v->temporary);
+	upload_v->thread = m_next.fetch_add(1u, std::memory_order_relaxed) % m_threads.size();
+	try
+	{
+		upload_v->file.preallocate(size);
+	}
+	catch (...)
+	{
+		upload_v->file.close();
+		std::error_code error_v;
+		std::filesystem::remove(upload_v->temporary, error_v);
+		throw;
+	}
+	return upload_v;
+}
+
+void tftp_write_behind::write(upload_handle const& upload, std::uintmax_t offset, std::vector<std::byte> bytes)
+{
+	upload->pending.fetch_add(bytes.size(), std::memory_order_relaxed);
+	submit(job_type{ .kind = job_kind::write, .upload = upload, .offset = offset, .bytes = std::move(bytes) });
+}
+
+void tftp_write_behind::commit(upload_handle const& upload, std::uintmax_t size)
+{
+	submit(job_type{ .kind = job_kind::commit, .upload = upload, .offset = size });
+}
+
+void tftp_write_behind::abort(upload_handle const& upload)
+{
+	submit(job_type{ .kind = job_kind::abort, .upload = upload });
+}
+
+auto tftp_write_behind::statistics() const -> statistics_type
+{
+	return statistics_type
+	{
+		.committed	= m_committed.load(std::memory_order_relaxed),
+		.failed			= m_failed.load(std::memory_order_relaxed),
+		.batches		= m_batches.load(std::memory_order_relaxed),
+		.written		= m_written.load(std::memory_order_relaxed)
+	};
+}
+
+void tftp_write_behind::submit(job_type job_v)
+{
+	auto& thread_v = *m_threads.at(job_v.upload->thread);
+	thread_v.jobs.push(std::move(job_v));
+}
+
+void tftp_write_behind::thread_writer(std::stop_token st, thread_type& thread_v)
+{
+	Glog.info("* Upload writer started.");
+	/* a stop only ends the thread once the queue is empty, every block ACKed gets written */
+	job_type job_v;
+	while (true)
+	{
+		if (!thread_v.jobs.try_pop(job_v))
+		{
+			if (st.stop_requested())
+				break;
+			auto popped_v = thread_v.jobs.pop(std::nothrow, st);
+			if (!popped_v)
+				continue;
+			job_v = std::move(*popped_v);
+		}
+		run(job_v);
+		/* written, or skipped after a failure, either way no longer holding the session back */
+		if (job_v.kind == job_kind::write)
+			job_v.upload->pending.fetch_sub(job_v.bytes.size(), std::memory_order_release);
+		job_v = {};
+	}
+	Glog.info("* Upload writer stopped.");
+}
+
+void tftp_write_behind::run(job_type& job_v)
+{
+	using namespace std::string_view_literals;
+	auto& upload_v = *job_v.upload;
+	if (upload_v.failed.load(std::memory_order_relaxed) && job_v.kind != job_kind::abort)
+		return;
+	try
+	{
+		switch (job_v.kind)
+		{
+		case job_kind::write:
+			upload_v.file.write(job_v.offset, job_v.bytes);
+			m_batches.fetch_add(1u, std::memory_order_relaxed);
+			m_written.fetch_add(job_v.bytes.size(), std::memory_order_relaxed);
+			return;
+		case job_kind::commit:
+			/* preallocation grew the file to the announced tsize, the client may have sent less */
+			upload_v.file.resize(job_v.offset);
+			upload_v.file.sync();
+			upload_v.file.close();
+			/* the target was free at WRQ time, another upload or a local write may have taken it since */
+			if (upload_v.replace)
+				std::filesystem::rename(upload_v.temporary, upload_v.target);
+			else
+				rename_no_replace(upload_v.temporary, upload_v.target);
+			m_committed.fetch_add(1u, std::memory_order_relaxed);
+			Glog.info("Upload of '{}' is on disk ({} bytes)."sv, upload_v.target.string(), job_v.offset);
+			return;
+		case job_kind::abort:
+			break;
+		}
+	}
+	catch (std::exception const& e)
+	{
+		Glog.error("Failed to write upload of '{}', {}."sv, upload_v.target.string(), e.what());
+		upload_v.failed.store(true, std::memory_order_relaxed);
+		m_failed.fetch_add(1u, std::memory_order_relaxed);
+	}
+	upload_v.file.close();
+	std::error_code error_v;
+	std::filesystem::remove(upload_v.temporary, error_v);
+}
+
+tftp_writer::tftp_writer(tftp_write_behind& behind, std::filesystem::path const& target, std::uintmax_t size_hint, bool replace)
+:	m_behind{ behind },
+	m_upload{ behind.open(target, size_hint, replace) }
+{
+	m_batch.reserve(BATCH_SIZE);
+}
+
+tftp_writer::~tftp_writer()
+{
+	if (!m_committed)
+		m_behind.abort(m_upload);
+}
+
+void tftp_writer::append(std::span<const std::byte> bytes)
+{
+	if (m_upload->failed.load(std::memory_order_relaxed))
+		throw std::runtime_error(std::format("Failed to write upload of '{}'.", m_upload->target.string()));
+	m_batch.insert(m_batch.end(), bytes.begin(), bytes.end());
+	m_size += bytes.size();
+	if (m_batch.size() >= BATCH_SIZE)
+		flush();
+}
+
+void tftp_writer::commit()
+{
+	flush();
+	m_behind.commit(m_upload, m_size);
+	m_committed = true;
+}
+
+auto tftp_writer::size() const noexcept -> std::uintmax_t
+{
+	return m_size;
+}
+
+auto tftp_writer::caught_up() const noexcept -> bool
+{
+	return m_upload->pending.load(std::memory_order_acquire) <= MAX_BEHIND;
+}
+
+void tftp_writer::flush()
+{
+	if (m_batch.empty())
+		return;
+	const auto offset_v = m_size - m_batch.size();
+	m_behind.write(m_upload, offset_v, std::exchange(m_batch, {}));
+	m_batch.reserve(BATCH_SIZE);
+}
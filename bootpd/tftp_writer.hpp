@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <stop_token>
+#include <span>
+
+#include <common/write_only_file.hpp>
+#include <common/concurrent_queue.hpp>
+
+enum struct tftp_upload_mode
+{
+	off,				/* WRQ is refused */
+	create,			/* new files only */
+	overwrite		/* new files, or replacing existing ones */
+};
+
+auto to_string(tftp_upload_mode mode) -> std::string_view;
+
+/*
+ * Write-behind for TFTP uploads. Sessions ACK a block as soon as it is
+ * buffered and hand their buffers over in large batches, a few threads write
+ * them out, so neither a slow disk nor the final sync holds up a transfer worker.
+ * A client faster than the disk gets tftp_writer::MAX_BEHIND bytes ahead of it,
+ * past that the session holds its ACK back until the batches are written.
+ *
+ * An upload goes to a temporary file next to its target and sticks to one
+ * thread, its batches land in order and the file only replaces the target once
+ * all of it is on disk. An upload given up on, or failing to write, is removed.
+ * Uploads not allowed to replace fail when the target showed up in the meantime.
+ */
+struct tftp_write_behind
+{
+	struct upload_type
+	{
+		write_only_file					file;
+		std::filesystem::path		temporary;
+		std::filesystem::path		target;
+		std::size_t							thread{ 0u };
+		bool										replace{ false };		/* may move over an existing target */
+		std::atomic<bool>				failed{ false };
+		std::atomic<std::uintmax_t>	pending{ 0u };		/* bytes handed over and not written yet */
+	};
+	using upload_handle = std::shared_ptr<upload_type>;
+
+	struct statistics_type
+	{
+		std::uint64_t		committed{ 0u };
+		std::uint64_t		failed{ 0u };
+		std::uint64_t		batches{ 0u };
+		std::uintmax_t	written{ 0u };
+	};
+
+	tftp_write_behind() = default;
+	tftp_write_behind(tftp_write_behind const&) = delete;
+	tftp_write_behind& operator = (tftp_write_behind const&) = delete;
+ ~tftp_write_behind();
+
+	void start(unsigned threads);
+	/* writes out everything already handed over before the threads stop */
+	void cease();
+
+	/* throws when the temporary file can't be created or `size` bytes don't fit on the disk */
+	auto open(std::filesystem::path const& target, std::uintmax_t size, bool replace) -> upload_handle;
+	void write(upload_handle const& upload, std::uintmax_t offset, std::vector<std::byte> bytes);
+	/* trims the file to `size`, syncs it and moves it to the target, over it only when the upload may replace */
+	void commit(upload_handle const& upload, std::uintmax_t size);
+	void abort(upload_handle const& upload);
+	auto statistics() const -> statistics_type;
+
+private:
+	enum struct job_kind
+	{
+		write,
+		commit,
+		abort
+	};
+
+	struct job_type
+	{
+		job_kind								kind{ job_kind::write };
+		upload_handle						upload{};
+		std::uintmax_t					offset{ 0u };
+		std::vector<std::byte>	bytes{};
+	};
+
+	struct thread_type
+	{
+		concurrent_queue<job_type>	jobs;
+		std::jthread								thread;
+	};
+
+	void submit(job_type job_v);
+	void thread_writer(std::stop_token st, thread_type& thread_v);
+	void run(job_type& job_v);
+
+	std::vector<std::unique_ptr<thread_type>>	m_threads;
+	std::atomic<std::size_t>		m_next{ 0u };
+	std::atomic<std::uint64_t>	m_committed{ 0u };
+	std::atomic<std::uint64_t>	m_failed{ 0u };
+	std::atomic<std::uint64_t>	m_batches{ 0u };
+	std::atomic<std::uintmax_t>	m_written{ 0u };
+};
+
+/* one upload as its session sees it, blocks are appended in order */
+struct tftp_writer
+{
+	static inline const constexpr std::size_t BATCH_SIZE = 0x100000u;
+	/* bytes an upload may have waiting for the disk before its session stops ACKing */
+	static inline const constexpr std::uintmax_t MAX_BEHIND = 4u * BATCH_SIZE;
+
+	/* `size_hint` is the tsize the client announced, preallocated when not 0 */
+	tftp_writer(tftp_write_behind& behind, std::filesystem::path const& target, std::uintmax_t size_hint, bool replace);
+	tftp_writer(tftp_writer const&) = delete;
+	tftp_writer& operator = (tftp_writer const&) = delete;
+	/* an upload not committed is thrown away */
+ ~tftp_writer();
+
+	/* throws once an earlier batch failed to write */
+	void append(std::span<const std::byte> bytes);
+	void commit();
+	auto size() const noexcept -> std::uintmax_t;
+	/* false while more than MAX_BEHIND bytes wait for the disk */
+	auto caught_up() const noexcept -> bool;
+
+private:
+	void flush();
+
+	tftp_write_behind&								m_behind;
+	tftp_write_behind::upload_handle	m_upload;
+	std::vector<std::byte>						m_batch;
+	std::uintmax_t										m_size{ 0u };
+	bool															m_committed{ false };
+};
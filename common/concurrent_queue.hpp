@@ -1,11 +1,18 @@
 #pragma once
 
 #include <queue>
+#include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <stop_token>
 #include <exception>
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <new>
+#include <expected>
+#include <system_error>
  
 struct error_stop_requested: std::exception
 {
@@ -28,32 +35,52 @@ private:
 template <typename T>
 struct concurrent_queue
 {
+	using value_type = T;
+
+	/* non-throwing pop for the hot loops, std::errc::timed_out on time out and
+	   std::errc::operation_canceled when a stop was requested or the queue is going away */
 	template <typename... Dur>
 	requires (sizeof... (Dur) < 2u)
-  auto pop(std::stop_token const& st, Dur&&... dur) -> T 
+	auto pop(std::nothrow_t, std::stop_token const& st, Dur&&... dur) -> std::expected<T, std::error_code>
 	{
 		std::stop_callback please_stop(st, [this] () {
 			m_covar.notify_all();
 		});
-		
-    std::unique_lock<std::mutex> mlock(m_mutex);
-    while (m_queue.empty())			
-    {
-			if constexpr (sizeof...(dur) == 1u) {
-				using enum std::cv_status;
-				if (m_covar.wait_for(mlock, dur) != no_timeout)					
-					throw error_queue_timed_out("queue timed out");				
-			}
-			else {
-				m_covar.wait(mlock);
-			}
-			if (st.stop_requested() || m_cease.load()) {
-				throw error_stop_requested("stop requested");
-			}
+		std::unique_lock<std::mutex> mlock(m_mutex);
+		if (const auto waited = wait_nonempty(mlock, st, dur...); !waited)
+			return std::unexpected(waited.error());
+		auto value = std::move(m_queue.front());
+		m_queue.pop();
+		return value;
+	}
+
+	/* blocks for the first value, then takes whatever else is queued, up to max_count values in total */
+	template <typename... Dur>
+	requires (sizeof... (Dur) < 2u)
+	auto pop_batch(std::nothrow_t, std::vector<T>& values, std::size_t max_count, std::stop_token const& st, Dur&&... dur) -> std::expected<void, std::error_code>
+	{
+		std::stop_callback please_stop(st, [this] () {
+			m_covar.notify_all();
+		});
+		std::unique_lock<std::mutex> mlock(m_mutex);
+		if (const auto waited = wait_nonempty(mlock, st, dur...); !waited)
+			return waited;
+		for (auto i = 0u; i < max_count && !m_queue.empty(); ++i)
+		{
+			values.emplace_back(std::move(m_queue.front()));
+			m_queue.pop();
 		}
-    const auto value = std::move(m_queue.front());
-    m_queue.pop();
-    return value;
+		return {};
+	}
+
+	template <typename... Dur>
+	requires (sizeof... (Dur) < 2u)
+  auto pop(std::stop_token const& st, Dur&&... dur) -> T 
+	{
+		auto popped = pop(std::nothrow, st, dur...);
+		if (!popped)
+			throw_error(popped.error());
+		return std::move(*popped);
   } 
 	
 	template <typename... Dur>
@@ -112,6 +139,14 @@ struct concurrent_queue
     m_queue.pop();
   }
 
+	template <typename... Dur>
+	requires (sizeof... (Dur) < 2u)
+	void pop_batch(std::vector<T>& values, std::size_t max_count, std::stop_token const& st, Dur&&... dur)
+	{
+		if (const auto popped = pop_batch(std::nothrow, values, max_count, st, dur...); !popped)
+			throw_error(popped.error());
+	}
+
 	bool try_pop(T& value)
 	{
 		std::unique_lock<std::mutex> mlock(m_mutex);
@@ -148,6 +183,19 @@ struct concurrent_queue
     m_covar.notify_one();
   }
 
+	/* moves every value into the queue under a single lock, leaves `values` empty */
+	void push_batch(std::vector<T>& values)
+	{
+		if (values.empty())
+			return;
+		std::unique_lock<std::mutex> mlock(m_mutex);
+		for (auto&& value : values)
+			m_queue.push(std::move(value));
+		mlock.unlock();
+		values.clear();
+		m_covar.notify_all();
+	}
+
 	template<typename...Q>
 	void emplace(Q&&... args)
 	{
@@ -174,6 +222,34 @@ struct concurrent_queue
 	}
  
  private:
+	template <typename... Dur>
+	auto wait_nonempty(std::unique_lock<std::mutex>& mlock, std::stop_token const& st, Dur&&... dur) -> std::expected<void, std::error_code>
+	{
+		while (m_queue.empty())
+		{
+			if constexpr (sizeof...(Dur) == 1u) {
+				using enum std::cv_status;
+				if (m_covar.wait_for(mlock, dur...) != no_timeout)
+					return std::unexpected(std::make_error_code(std::errc::timed_out));
+			}
+			else {
+				m_covar.wait(mlock);
+			}
+
+			if (st.stop_requested() || m_cease.load()) {
+				return std::unexpected(std::make_error_code(std::errc::operation_canceled));
+			}
+		}
+		return {};
+	}
+
+	[[noreturn]] static void throw_error(std::error_code const& error)
+	{
+		if (error == std::errc::timed_out)
+			throw error_queue_timed_out("queue timed out");
+		throw error_stop_requested("stop requested");
+	}
+
   std::queue<T>           m_queue;
   std::mutex              m_mutex;
   std::condition_variable m_covar;
@@ -6,6 +6,7 @@
 #include <string>
 #include <string_view>
 #include <optional>
+#include <vector>
 
 #include "lexical_cast.hpp"
 
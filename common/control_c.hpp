@@ -8,4 +8,7 @@ struct control_c
 	
 	static auto get_token() -> std::stop_token;
 	static auto stop_requested() -> bool;
+
+	/* SIGUSR1 (Ctrl+Break on Windows) asks for statistics, true once per request */
+	static auto dump_requested() -> bool;
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "control_c.hpp"
+#include "logger.hpp"
+
+#include <mutex>
+#include <thread>
+#include <iostream>
+
+#include <csignal>
+#include <signal.h>
+
+static std::stop_source G_source;
+static std::once_flag G_initialize;
+static volatile std::sig_atomic_t G_dump{ 0 };
+
+static void control_c_handler(int)
+{
+	G_source.request_stop();
+}
+
+static void dump_handler(int)
+{
+	G_dump = 1;
+}
+
+auto control_c::get_token() -> std::stop_token
+{
+	std::call_once(G_initialize, []() 
+	{			
+		struct sigaction action{};
+		action.sa_handler = control_c_handler;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(SIGINT, &action, nullptr) != 0 || sigaction(SIGTERM, &action, nullptr) != 0)
+		{
+			throw std::runtime_error("Unable to install control+c handler.");
+		}
+		action.sa_handler = dump_handler;
+		if (sigaction(SIGUSR1, &action, nullptr) != 0)
+		{
+			throw std::runtime_error("Unable to install SIGUSR1 handler.");
+		}
+	});
+	return G_source.get_token();
+}
+
+auto control_c::stop_requested() -> bool
+{
+	static auto token = get_token();
+	if (token.stop_requested()) 
+	{
+		static std::once_flag logged;
+		std::call_once(logged, [] () { Glog.debug("Control+C termination requested."); });
+		return true;
+	}
+	return false;
+}
+
+auto control_c::dump_requested() -> bool
+{
+	get_token();
+	if (!G_dump)
+		return false;
+	G_dump = 0;
+	return true;
+}
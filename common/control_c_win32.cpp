@@ -4,11 +4,13 @@
 #include <mutex>
 #include <thread>
 #include <iostream>
+#include <atomic>
 
 #include <Windows.h>
 
 static std::stop_source G_source;
 static std::once_flag G_initialize;
+static std::atomic_bool G_dump{ false };
 
 static auto control_c_handler(DWORD w) -> BOOL
 {
@@ -18,6 +20,11 @@ static auto control_c_handler(DWORD w) -> BOOL
 		G_source.request_stop();
 		return TRUE;
 	}
+	if (w == CTRL_BREAK_EVENT)
+	{
+		G_dump.store(true);
+		return TRUE;
+	}
 	return FALSE;
 }
 
@@ -42,3 +49,9 @@ auto control_c::stop_requested() -> bool
 	static auto token = get_token();
   return token.stop_requested();
 }
+
+auto control_c::dump_requested() -> bool
+{
+	get_token();
+	return G_dump.exchange(false);
+}
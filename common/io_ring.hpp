@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <filesystem>
+
+#include "socket_api.hpp"
+
+/*
+ * Minimal io_uring submission/completion ring (raw syscalls, no liburing).
+ *
+ * The ring owns a slab of registered buffers and a sparse table of fixed
+ * files, operations always refer to both by index. Only what the TFTP data
+ * path needs is exposed: fixed buffer reads from a file and datagram sends
+ * from a fixed buffer. Everything prepared until submit() is one chain, each
+ * operation starts once the one before it completed, so a send waits for the
+ * read into its buffer and datagrams leave in the order they were prepared. A
+ * failure cancels the rest of the chain.
+ *
+ * Nothing waits for the operations, the owner watches native_handle() and
+ * calls complete() when it is readable. A buffer goes back to the free list
+ * once the send from it completed, a failure is kept for the slot it
+ * happened on until the slot is unregistered. Sends the socket had no room
+ * for are not failures, take_stalled() names the socket and take_unsent() the
+ * tag of the first of them, for the owner to send again once it's writable.
+ *
+ * Not available on Windows or on kernels without io_uring, check is_supported().
+ */
+struct io_ring
+{
+	static auto is_supported() -> bool;
+
+	/* buffers of the rings this_thread() creates from now on, one per block in flight */
+	static void configure(unsigned buffer_count, std::size_t buffer_size);
+	/* ring of the calling thread, created on first use */
+	static auto this_thread() -> io_ring&;
+
+	io_ring(unsigned entries, unsigned buffer_count, std::size_t buffer_size);
+	io_ring(io_ring const&) = delete;
+	io_ring& operator = (io_ring const&) = delete;
+ ~io_ring();
+
+	auto acquire_buffer() -> std::optional<unsigned>;
+	void release_buffer(unsigned index);
+	auto buffer(unsigned index) const -> std::span<std::byte>;
+	auto buffer_size() const noexcept -> std::size_t;
+
+	/* fixed file slots, the ring keeps its own reference to the descriptor */
+	auto register_file(std::filesystem::path const& path) -> int;
+	auto register_socket(int_socket_type socket) -> int;
+	void unregister(int slot);
+	/* first failure (-errno, -EIO for a short read) of an operation on the slot, 0 when there was none */
+	auto slot_error(int slot) const noexcept -> int;
+	/* lowest tag of the sends on the socket slot that didn't go out since the last call */
+	auto take_unsent(int slot) -> std::optional<std::uint64_t>;
+
+	/* the send hands the buffer back when it completes, the read into it has to be prepared right before */
+	void prepare_read(int file_slot, unsigned buffer_index, std::size_t buffer_offset, std::size_t length, std::uint64_t file_offset);
+	void prepare_send(int socket_slot, unsigned buffer_index, std::size_t length, struct address_v4 const& target, std::uint64_t tag);
+
+	/* submits everything prepared without waiting */
+	void submit();
+	/* takes what completed so far, without waiting, returns how many operations did */
+	auto complete() -> std::size_t;
+	/* sockets that had sends they had no room for since the last call */
+	auto take_stalled() -> std::vector<int_socket_type>;
+	/* readable while completions are waiting */
+	auto native_handle() const noexcept -> int_socket_type;
+
+private:
+	struct state_type;
+	std::unique_ptr<state_type> m_state;
+};
@@ -0,0 +1,420 @@
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <atomic>
+#include <mutex>
+#include <format>
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include "io_ring.hpp"
+#include "address_v4.hpp"
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+static inline constexpr const unsigned io_ring_file_slots = 256u;
+/* two entries per buffer, its read and its send, have to stay below the kernel's limit of 32768 */
+static inline constexpr const unsigned io_ring_max_buffers = 4096u;
+
+static std::atomic<unsigned> io_ring_buffer_count{ 64u };
+static std::atomic<std::size_t> io_ring_buffer_size{ 0x10000u };
+
+static auto error_as_string(int error_code = errno) -> std::string
+{
+	return std::generic_category().message(error_code);
+}
+
+static auto sys_io_uring_setup(unsigned entries, io_uring_params* params) -> int
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static auto sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) -> int
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static auto sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) -> int
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+struct io_ring::state_type
+{
+	/* what is in flight from one buffer, completions carry its index, shifted left once, the low bit set for the send */
+	struct send_type
+	{
+		msghdr			header;
+		iovec				vector;
+		sockaddr_in	target;
+		int					file_slot{ -1 };
+		int					socket_slot{ -1 };
+		unsigned		file_generation{ 0u };
+		unsigned		socket_generation{ 0u };
+		std::int32_t	read_length{ 0 };
+		std::uint64_t	tag{ 0u };
+	};
+
+	int							ring_fd{ -1 };
+	io_uring_params	params{};
+
+	void*						sq_map{ MAP_FAILED };
+	std::size_t			sq_map_size{ 0u };
+	void*						cq_map{ MAP_FAILED };
+	std::size_t			cq_map_size{ 0u };
+	io_uring_sqe*		sqes{ (io_uring_sqe*)MAP_FAILED };
+	std::size_t			sqes_size{ 0u };
+
+	std::atomic<unsigned>*	sq_head{ nullptr };
+	std::atomic<unsigned>*	sq_tail{ nullptr };
+	unsigned*								sq_array{ nullptr };
+	unsigned								sq_mask{ 0u };
+	std::atomic<unsigned>*	cq_head{ nullptr };
+	std::atomic<unsigned>*	cq_tail{ nullptr };
+	io_uring_cqe*						cqes{ nullptr };
+	unsigned								cq_mask{ 0u };
+
+	unsigned								sq_local_tail{ 0u };
+	unsigned								sq_pending{ 0u };
+
+	std::size_t							buffer_size{ 0u };
+	std::unique_ptr<std::byte[]>	buffer_storage;
+	std::vector<unsigned>					buffer_free;
+	std::vector<send_type>				sends;
+	std::vector<int>							file_free;
+	std::vector<int>							slot_errors;
+	std::vector<unsigned>					slot_generations;	/* bumped on unregister, so late completions don't blame the slot's next owner */
+	std::vector<std::optional<std::uint64_t>>	slot_unsent;
+	std::vector<int_socket_type>	slot_handles;
+	std::vector<int_socket_type>	stalled;
+
+	~state_type()
+	{
+		if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+		if (cq_map != MAP_FAILED && cq_map != sq_map) munmap(cq_map, cq_map_size);
+		if (sq_map != MAP_FAILED) munmap(sq_map, sq_map_size);
+		if (ring_fd >= 0) ::close(ring_fd);
+	}
+
+	auto next_sqe() -> io_uring_sqe&
+	{
+		if (sq_local_tail - sq_head->load(std::memory_order_acquire) >= params.sq_entries)
+			throw std::runtime_error("io_uring submission queue is full.");
+		const auto index = sq_local_tail & sq_mask;
+		auto& sqe = sqes[index];
+		std::memset(&sqe, 0, sizeof(sqe));
+		sq_array[index] = index;
+		++sq_local_tail;
+		++sq_pending;
+		return sqe;
+	}
+
+	void fail(int slot, unsigned generation, int error)
+	{
+		if (slot >= 0 && slot_generations[slot] == generation && slot_errors[slot] == 0)
+			slot_errors[slot] = error;
+	}
+
+	void unsent(int slot, unsigned generation, std::uint64_t tag)
+	{
+		if (slot_generations[slot] != generation)
+			return;
+		if (!slot_unsent[slot])
+			stalled.push_back(slot_handles[slot]);
+		slot_unsent[slot] = std::min(slot_unsent[slot].value_or(tag), tag);
+	}
+};
+
+auto io_ring::is_supported() -> bool
+{
+	static std::once_flag probed;
+	static bool supported{ false };
+	std::call_once(probed, [] ()
+	{
+		io_uring_params params{};
+		if (const auto fd = sys_io_uring_setup(2u, &params); fd >= 0)
+		{
+			supported = true;
+			::close(fd);
+		}
+	});
+	return supported;
+}
+
+void io_ring::configure(unsigned buffer_count, std::size_t buffer_size)
+{
+	io_ring_buffer_count = std::clamp(buffer_count, 1u, io_ring_max_buffers);
+	io_ring_buffer_size = buffer_size;
+}
+
+auto io_ring::this_thread() -> io_ring&
+{
+	thread_local io_ring ring(2u*io_ring_buffer_count, io_ring_buffer_count, io_ring_buffer_size);
+	return ring;
+}
+
+io_ring::io_ring(unsigned entries, unsigned buffer_count, std::size_t buffer_size)
+:	m_state{ std::make_unique<state_type>() }
+{
+	using namespace std::string_literals;
+	auto& s = *m_state;
+
+	s.ring_fd = sys_io_uring_setup(entries, &s.params);
+	if (s.ring_fd < 0)
+		throw std::runtime_error("io_uring_setup failed, error : "s + error_as_string());
+
+	s.sq_map_size = s.params.sq_off.array + s.params.sq_entries * sizeof(unsigned);
+	s.cq_map_size = s.params.cq_off.cqes + s.params.cq_entries * sizeof(io_uring_cqe);
+	if (s.params.features & IORING_FEAT_SINGLE_MMAP)
+		s.sq_map_size = s.cq_map_size = std::max(s.sq_map_size, s.cq_map_size);
+
+	s.sq_map = mmap(nullptr, s.sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s.ring_fd, IORING_OFF_SQ_RING);
+	if (s.sq_map == MAP_FAILED)
+		throw std::runtime_error("failed to map io_uring submission ring, error : "s + error_as_string());
+	s.cq_map = (s.params.features & IORING_FEAT_SINGLE_MMAP) ? s.sq_map
+		: mmap(nullptr, s.cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s.ring_fd, IORING_OFF_CQ_RING);
+	if (s.cq_map == MAP_FAILED)
+		throw std::runtime_error("failed to map io_uring completion ring, error : "s + error_as_string());
+	s.sqes_size = s.params.sq_entries * sizeof(io_uring_sqe);
+	s.sqes = (io_uring_sqe*)mmap(nullptr, s.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, s.ring_fd, IORING_OFF_SQES);
+	if (s.sqes == MAP_FAILED)
+		throw std::runtime_error("failed to map io_uring submission entries, error : "s + error_as_string());
+
+	auto* sq_bytes = (std::byte*)s.sq_map;
+	auto* cq_bytes = (std::byte*)s.cq_map;
+	s.sq_head		= (std::atomic<unsigned>*)(sq_bytes + s.params.sq_off.head);
+	s.sq_tail		= (std::atomic<unsigned>*)(sq_bytes + s.params.sq_off.tail);
+	s.sq_mask		= *(unsigned*)(sq_bytes + s.params.sq_off.ring_mask);
+	s.sq_array	= (unsigned*)(sq_bytes + s.params.sq_off.array);
+	s.cq_head		= (std::atomic<unsigned>*)(cq_bytes + s.params.cq_off.head);
+	s.cq_tail		= (std::atomic<unsigned>*)(cq_bytes + s.params.cq_off.tail);
+	s.cq_mask		= *(unsigned*)(cq_bytes + s.params.cq_off.ring_mask);
+	s.cqes			= (io_uring_cqe*)(cq_bytes + s.params.cq_off.cqes);
+	s.sq_local_tail = s.sq_tail->load(std::memory_order_relaxed);
+
+	/* registered buffers, pinned once for the lifetime of the ring */
+	s.buffer_size = buffer_size;
+	s.buffer_storage = std::make_unique<std::byte[]>(buffer_count * buffer_size);
+	s.sends.resize(buffer_count);
+	std::vector<iovec> vectors(buffer_count);
+	for (auto i = 0u; i < buffer_count; ++i)
+	{
+		vectors[i] = iovec{ .iov_base = s.buffer_storage.get() + i * buffer_size, .iov_len = buffer_size };
+		s.buffer_free.push_back(buffer_count - i - 1u);
+	}
+	if (buffer_count > 0u && sys_io_uring_register(s.ring_fd, IORING_REGISTER_BUFFERS, vectors.data(), buffer_count) != 0)
+		throw std::runtime_error("failed to register io_uring buffers, error : "s + error_as_string());
+
+	/* sparse fixed file table, slots get filled by register_file/register_socket */
+	std::vector<int> files(io_ring_file_slots, -1);
+	if (sys_io_uring_register(s.ring_fd, IORING_REGISTER_FILES, files.data(), (unsigned)files.size()) != 0)
+		throw std::runtime_error("failed to register io_uring file table, error : "s + error_as_string());
+	for (auto i = 0u; i < io_ring_file_slots; ++i)
+		s.file_free.push_back((int)(io_ring_file_slots - i - 1u));
+	s.slot_errors.assign(io_ring_file_slots, 0);
+	s.slot_generations.assign(io_ring_file_slots, 0u);
+	s.slot_unsent.assign(io_ring_file_slots, std::nullopt);
+	s.slot_handles.assign(io_ring_file_slots, v4_socket_make_invalid());
+}
+
+io_ring::~io_ring()
+{}
+
+auto io_ring::acquire_buffer() -> std::optional<unsigned>
+{
+	auto& s = *m_state;
+	if (s.buffer_free.empty())
+		return std::nullopt;
+	const auto index = s.buffer_free.back();
+	s.buffer_free.pop_back();
+	return index;
+}
+
+void io_ring::release_buffer(unsigned index)
+{
+	m_state->buffer_free.push_back(index);
+}
+
+auto io_ring::buffer(unsigned index) const -> std::span<std::byte>
+{
+	auto& s = *m_state;
+	return { s.buffer_storage.get() + index * s.buffer_size, s.buffer_size };
+}
+
+auto io_ring::buffer_size() const noexcept -> std::size_t
+{
+	return m_state->buffer_size;
+}
+
+auto io_ring::register_socket(int_socket_type socket) -> int
+{
+	using namespace std::string_literals;
+	auto& s = *m_state;
+	if (s.file_free.empty())
+		throw std::runtime_error("io_uring file table is full.");
+	const auto slot = s.file_free.back();
+	int fd = (int)socket;
+	io_uring_files_update update{ .offset = (unsigned)slot, .resv = 0u, .fds = (std::uint64_t)(std::uintptr_t)&fd };
+	if (sys_io_uring_register(s.ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1u) < 0)
+		throw std::runtime_error("failed to register io_uring fixed file, error : "s + error_as_string());
+	s.file_free.pop_back();
+	s.slot_handles[slot] = socket;
+	return slot;
+}
+
+auto io_ring::register_file(std::filesystem::path const& path) -> int
+{
+	using namespace std::string_literals;
+	const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error(std::format("failed to open '{}', error : {}", path.string(), error_as_string()));
+	try
+	{
+		/* the fixed file table holds its own reference */
+		const auto slot = register_socket(fd);
+		::close(fd);
+		return slot;
+	}
+	catch (...)
+	{
+		::close(fd);
+		throw;
+	}
+}
+
+/* operations still in flight keep their own reference to the file */
+void io_ring::unregister(int slot)
+{
+	auto& s = *m_state;
+	int fd = -1;
+	io_uring_files_update update{ .offset = (unsigned)slot, .resv = 0u, .fds = (std::uint64_t)(std::uintptr_t)&fd };
+	sys_io_uring_register(s.ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1u);
+	++s.slot_generations[slot];
+	s.slot_errors[slot] = 0;
+	s.slot_unsent[slot].reset();
+	s.file_free.push_back(slot);
+}
+
+auto io_ring::slot_error(int slot) const noexcept -> int
+{
+	return slot >= 0 ? m_state->slot_errors[slot] : 0;
+}
+
+auto io_ring::take_unsent(int slot) -> std::optional<std::uint64_t>
+{
+	if (slot < 0)
+		return std::nullopt;
+	return std::exchange(m_state->slot_unsent[slot], std::nullopt);
+}
+
+void io_ring::prepare_read(int file_slot, unsigned buffer_index, std::size_t buffer_offset, std::size_t length, std::uint64_t file_offset)
+{
+	auto& s = *m_state;
+	auto& read = s.sends[buffer_index];
+	read.file_slot = file_slot;
+	read.file_generation = s.slot_generations[file_slot];
+	read.read_length = (std::int32_t)length;
+
+	auto& sqe = s.next_sqe();
+	sqe.opcode = IORING_OP_READ_FIXED;
+	sqe.flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+	sqe.fd = file_slot;
+	sqe.addr = (std::uint64_t)(std::uintptr_t)(buffer(buffer_index).data() + buffer_offset);
+	sqe.len = (unsigned)length;
+	sqe.off = file_offset;
+	sqe.buf_index = (std::uint16_t)buffer_index;
+	sqe.user_data = (std::uint64_t)buffer_index << 1u;
+}
+
+void io_ring::prepare_send(int socket_slot, unsigned buffer_index, std::size_t length, address_v4 const& target, std::uint64_t tag)
+{
+	auto& send = m_state->sends[buffer_index];
+	send.tag = tag;
+	send.socket_slot = socket_slot;
+	send.socket_generation = m_state->slot_generations[socket_slot];
+	send.target = target.as<sockaddr_in>();
+	send.vector = iovec{ .iov_base = buffer(buffer_index).data(), .iov_len = length };
+	send.header = msghdr{};
+	send.header.msg_name = &send.target;
+	send.header.msg_namelen = sizeof(send.target);
+	send.header.msg_iov = &send.vector;
+	send.header.msg_iovlen = 1u;
+
+	auto& sqe = m_state->next_sqe();
+	sqe.opcode = IORING_OP_SENDMSG;
+	sqe.flags = IOSQE_FIXED_FILE | IOSQE_IO_LINK;
+	sqe.fd = socket_slot;
+	sqe.addr = (std::uint64_t)(std::uintptr_t)&send.header;
+	sqe.len = 1u;
+	/* a full socket buffer parks the send in the ring until there is room, though the socket being
+	 * non-blocking it may still give up with -EAGAIN, complete() then reports the socket as stalled */
+	sqe.msg_flags = MSG_NOSIGNAL;
+	sqe.user_data = ((std::uint64_t)buffer_index << 1u) | 1u;
+}
+
+void io_ring::submit()
+{
+	using namespace std::string_literals;
+	auto& s = *m_state;
+	s.sq_tail->store(s.sq_local_tail, std::memory_order_release);
+	while (s.sq_pending > 0u)
+	{
+		const auto result = sys_io_uring_enter(s.ring_fd, s.sq_pending, 0u, 0u);
+		if (result < 0 && errno == EINTR)
+			continue;
+		if (result < 0)
+			throw std::runtime_error("io_uring_enter failed, error : "s + error_as_string());
+		s.sq_pending -= std::min<unsigned>(s.sq_pending, (unsigned)result);
+		break;
+	}
+}
+
+auto io_ring::complete() -> std::size_t
+{
+	auto& s = *m_state;
+	auto head = s.cq_head->load(std::memory_order_relaxed);
+	const auto tail = s.cq_tail->load(std::memory_order_acquire);
+	std::size_t count{ 0u };
+	for (; head != tail; ++head, ++count)
+	{
+		const auto& cqe = s.cqes[head & s.cq_mask];
+		const auto index = (unsigned)(cqe.user_data >> 1u);
+		const auto& send = s.sends[index];
+		/* a failed or short operation breaks the chain, the rest of it completes with -ECANCELED */
+		if (!(cqe.user_data & 1u))
+		{
+			if (cqe.res != send.read_length && cqe.res != -ECANCELED)
+				s.fail(send.file_slot, send.file_generation, cqe.res < 0 ? cqe.res : -EIO);
+			continue;
+		}
+		/* a send that found the socket full didn't go out, nor did the rest of its chain */
+		if (cqe.res == -EAGAIN || cqe.res == -ECANCELED)
+			s.unsent(send.socket_slot, send.socket_generation, send.tag);
+		else if (cqe.res < 0)
+			s.fail(send.socket_slot, send.socket_generation, cqe.res);
+		s.buffer_free.push_back(index);
+	}
+	s.cq_head->store(head, std::memory_order_release);
+	return count;
+}
+
+auto io_ring::take_stalled() -> std::vector<int_socket_type>
+{
+	return std::exchange(m_state->stalled, {});
+}
+
+auto io_ring::native_handle() const noexcept -> int_socket_type
+{
+	return m_state->ring_fd;
+}
@@ -0,0 +1,101 @@
+#include <stdexcept>
+
+#include "io_ring.hpp"
+
+/* no io_uring on Windows, callers check is_supported() and stay on the classic path */
+
+struct io_ring::state_type
+{};
+
+auto io_ring::is_supported() -> bool
+{
+	return false;
+}
+
+void io_ring::configure(unsigned, std::size_t)
+{}
+
+auto io_ring::this_thread() -> io_ring&
+{
+	thread_local io_ring ring(64u, 4u, 0x10000u);
+	return ring;
+}
+
+io_ring::io_ring(unsigned, unsigned, std::size_t)
+{
+	throw std::logic_error("io_uring is not available on this platform.");
+}
+
+io_ring::~io_ring()
+{}
+
+auto io_ring::acquire_buffer() -> std::optional<unsigned>
+{
+	return std::nullopt;
+}
+
+void io_ring::release_buffer(unsigned)
+{}
+
+auto io_ring::buffer(unsigned) const -> std::span<std::byte>
+{
+	return {};
+}
+
+auto io_ring::buffer_size() const noexcept -> std::size_t
+{
+	return 0u;
+}
+
+auto io_ring::register_file(std::filesystem::path const&) -> int
+{
+	throw std::logic_error("io_uring is not available on this platform.");
+}
+
+auto io_ring::register_socket(int_socket_type) -> int
+{
+	throw std::logic_error("io_uring is not available on this platform.");
+}
+
+void io_ring::unregister(int)
+{}
+
+auto io_ring::slot_error(int) const noexcept -> int
+{
+	return 0;
+}
+
+auto io_ring::take_unsent(int) -> std::optional<std::uint64_t>
+{
+	return std::nullopt;
+}
+
+void io_ring::prepare_read(int, unsigned, std::size_t, std::size_t, std::uint64_t)
+{
+	throw std::logic_error("io_uring is not available on this platform.");
+}
+
+void io_ring::prepare_send(int, unsigned, std::size_t, address_v4 const&, std::uint64_t)
+{
+	throw std::logic_error("io_uring is not available on this platform.");
+}
+
+void io_ring::submit()
+{
+	throw std::logic_error("io_uring is not available on this platform.");
+}
+
+auto io_ring::complete() -> std::size_t
+{
+	return 0u;
+}
+
+auto io_ring::take_stalled() -> std::vector<int_socket_type>
+{
+	return {};
+}
+
+auto io_ring::native_handle() const noexcept -> int_socket_type
+{
+	return -1;
+}
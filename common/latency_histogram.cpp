@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <bit>
+#include <format>
+
+#include "latency_histogram.hpp"
+#include "logger.hpp"
+
+void latency_histogram::record(std::chrono::nanoseconds elapsed) noexcept
+{
+	using namespace std::chrono;
+	/* clock steps can make the difference of two realtime stamps negative, count those as zero */
+	const auto us = (std::uint64_t)std::max<std::int64_t>(duration_cast<microseconds>(elapsed).count(), 0);
+	const auto bucket = std::min<std::size_t>(std::bit_width(us), BUCKETS - 1u);
+	m_buckets[bucket].fetch_add(1u, std::memory_order_relaxed);
+	m_count.fetch_add(1u, std::memory_order_relaxed);
+	m_total_us.fetch_add(us, std::memory_order_relaxed);
+	auto max_v = m_max_us.load(std::memory_order_relaxed);
+	while (us > max_v && !m_max_us.compare_exchange_weak(max_v, us, std::memory_order_relaxed))
+		;
+}
+
+void latency_histogram::record(socket_timestamp from, socket_timestamp to) noexcept
+{
+	/* no stamp from the kernel, nothing to measure */
+	if (from == socket_timestamp{} || to == socket_timestamp{})
+		return;
+	record(to - from);
+}
+
+void latency_histogram::reset() noexcept
+{
+	for (auto&& bucket : m_buckets)
+		bucket.store(0u, std::memory_order_relaxed);
+	m_count.store(0u, std::memory_order_relaxed);
+	m_total_us.store(0u, std::memory_order_relaxed);
+	m_max_us.store(0u, std::memory_order_relaxed);
+}
+
+auto latency_histogram::snapshot() const noexcept -> snapshot_type
+{
+	snapshot_type snapshot_v;
+	for (auto i = 0u; i < BUCKETS; ++i)
+		snapshot_v.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+	snapshot_v.count = m_count.load(std::memory_order_relaxed);
+	snapshot_v.total_us = m_total_us.load(std::memory_order_relaxed);
+	snapshot_v.max_us = m_max_us.load(std::memory_order_relaxed);
+	return snapshot_v;
+}
+
+auto latency_histogram::snapshot_type::percentile(double fraction) const noexcept -> std::uint64_t
+{
+	const auto wanted_v = (std::uint64_t)(fraction * (double)count);
+	std::uint64_t seen_v{ 0u };
+	for (auto i = 0u; i < BUCKETS; ++i)
+	{
+		seen_v += buckets[i];
+		if (seen_v > wanted_v || (seen_v == count && seen_v > 0u))
+			return std::min<std::uint64_t>(1ull << i, max_us);
+	}
+	return max_us;
+}
+
+auto latency_histogram::to_string() const -> std::string
+{
+	const auto snapshot_v = snapshot();
+	const auto average_v = snapshot_v.count ? snapshot_v.total_us / snapshot_v.count : 0u;
+	return std::format("n={} avg={}us p50<={}us p90<={}us p99<={}us p999<={}us max={}us",
+		snapshot_v.count, average_v, snapshot_v.percentile(0.5), snapshot_v.percentile(0.9), snapshot_v.percentile(0.99), snapshot_v.percentile(0.999), snapshot_v.max_us);
+}
+
+void packet_latency::dump(std::string_view who) const
+{
+	const auto dump_one = [who] (std::string_view what, latency_histogram const& histogram_v)
+	{
+		if (histogram_v.snapshot().count > 0u)
+			Glog.info("* {} {} latency : {}", who, what, histogram_v.to_string());
+	};
+	dump_one("kernel to userspace", kernel);
+	dump_one("queue wait", queue);
+	dump_one("processing", process);
+	dump_one("send", send);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <string_view>
+
+#include "socket_api.hpp"
+
+/*
+ * Log2 histogram of durations in microseconds, bucket 0 counts everything
+ * below 1us, bucket i the range [2^(i-1), 2^i) us. Any thread may record,
+ * the counters are relaxed atomics so a snapshot is only roughly consistent.
+ */
+struct latency_histogram
+{
+	static inline const constexpr auto BUCKETS = 32u;
+
+	struct snapshot_type
+	{
+		std::array<std::uint64_t, BUCKETS> buckets{};
+		std::uint64_t count{ 0u };
+		std::uint64_t total_us{ 0u };
+		std::uint64_t max_us{ 0u };
+
+		/* upper bound of the bucket holding the given fraction of the samples */
+		auto percentile(double fraction) const noexcept -> std::uint64_t;
+	};
+
+	void record(std::chrono::nanoseconds elapsed) noexcept;
+	void record(socket_timestamp from, socket_timestamp to) noexcept;
+	void reset() noexcept;
+	auto snapshot() const noexcept -> snapshot_type;
+
+	/* one line summary, "n=.. avg=..us p50<=..us p90<=..us p99<=..us max=..us" */
+	auto to_string() const -> std::string;
+
+private:
+	std::array<std::atomic<std::uint64_t>, BUCKETS> m_buckets{};
+	std::atomic<std::uint64_t> m_count{ 0u };
+	std::atomic<std::uint64_t> m_total_us{ 0u };
+	std::atomic<std::uint64_t> m_max_us{ 0u };
+};
+
+/* when a datagram reached the kernel and when the receiving thread got it */
+struct packet_times
+{
+	socket_timestamp kernel;
+	socket_timestamp received;
+};
+
+/*
+ * Where the time between a request arriving and its reply leaving goes:
+ * kernel to userspace, waiting in the queue, building the reply, and handing
+ * it to the kernel until it left the socket (transmit timestamp).
+ */
+struct packet_latency
+{
+	latency_histogram kernel;
+	latency_histogram queue;
+	latency_histogram process;
+	latency_histogram send;
+
+	/* logs every histogram that has samples, prefixed with `who` */
+	void dump(std::string_view who) const;
+};
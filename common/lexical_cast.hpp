@@ -27,7 +27,7 @@ auto lexical_cast(std::string_view what) -> T
 {
 	using namespace std::string_literals;
 	using namespace std::string_view_literals;
-	if constexpr (std::is_arithmetic_v<T>)
+	if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>)
 	{
 		T value = T();
 		size_t offs = 0;
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <filesystem>
+
+/*
+ * Read-only view of a whole file, backed by the page cache. Bytes handed out
+ * stay valid for the lifetime of the mapping, so they can be sent straight
+ * from the mapping without copying them into a buffer first.
+ */
+struct mapped_file
+{
+	mapped_file() noexcept;
+	mapped_file(std::filesystem::path const& path);
+	mapped_file(mapped_file&& other) noexcept;
+	mapped_file& operator = (mapped_file&& other) noexcept;
+	mapped_file(mapped_file const&) = delete;
+	mapped_file& operator = (mapped_file const&) = delete;
+ ~mapped_file();
+
+	void swap(mapped_file& other) noexcept;
+
+	auto bytes() const noexcept -> std::span<const std::byte>;
+	auto size() const noexcept -> std::size_t;
+
+private:
+	const std::byte*	m_data{ nullptr };
+	std::size_t				m_size{ 0u };
+	std::intptr_t			m_handle{ -1 };
+};
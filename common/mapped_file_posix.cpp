@@ -0,0 +1,81 @@
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <format>
+
+#include "mapped_file.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+
+mapped_file::mapped_file() noexcept
+{}
+
+mapped_file::mapped_file(std::filesystem::path const& path)
+{
+	const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error(std::format("failed to open '{}', error : {}", path.string(), std::generic_category().message(errno)));
+
+	struct stat info{};
+	if (::fstat(fd, &info) != 0)
+	{
+		const auto error_code = errno;
+		::close(fd);
+		throw std::runtime_error(std::format("failed to stat '{}', error : {}", path.string(), std::generic_category().message(error_code)));
+	}
+
+	/* an empty file has nothing to map, the view just stays empty */
+	m_size = (std::size_t)info.st_size;
+	if (m_size > 0u)
+	{
+		auto* data = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+		const auto error_code = errno;
+		::close(fd);
+		if (data == MAP_FAILED)
+			throw std::runtime_error(std::format("failed to map '{}', error : {}", path.string(), std::generic_category().message(error_code)));
+		::madvise(data, m_size, MADV_SEQUENTIAL);
+		m_data = (const std::byte*)data;
+		return;
+	}
+	::close(fd);
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+:	m_data{ std::exchange(other.m_data, nullptr) },
+	m_size{ std::exchange(other.m_size, 0u) },
+	m_handle{ std::exchange(other.m_handle, -1) }
+{}
+
+auto mapped_file::operator = (mapped_file&& other) noexcept -> mapped_file&
+{
+	mapped_file tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+mapped_file::~mapped_file()
+{
+	if (m_data)
+		::munmap((void*)m_data, m_size);
+}
+
+void mapped_file::swap(mapped_file& other) noexcept
+{
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_handle, other.m_handle);
+}
+
+auto mapped_file::bytes() const noexcept -> std::span<const std::byte>
+{
+	return { m_data, m_size };
+}
+
+auto mapped_file::size() const noexcept -> std::size_t
+{
+	return m_size;
+}
@@ -0,0 +1,83 @@
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <format>
+
+#include "mapped_file.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+mapped_file::mapped_file() noexcept
+{}
+
+mapped_file::mapped_file(std::filesystem::path const& path)
+{
+	const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(std::format("failed to open '{}', error : {}", path.string(), std::system_category().message(GetLastError())));
+
+	LARGE_INTEGER length{};
+	GetFileSizeEx(file, &length);
+	m_size = (std::size_t)length.QuadPart;
+
+	/* an empty file can't be mapped, the view just stays empty */
+	if (m_size > 0u)
+	{
+		const auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const auto error_code = GetLastError();
+		CloseHandle(file);
+		if (!mapping)
+			throw std::runtime_error(std::format("failed to map '{}', error : {}", path.string(), std::system_category().message(error_code)));
+		m_data = (const std::byte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!m_data)
+		{
+			const auto error_code = GetLastError();
+			CloseHandle(mapping);
+			throw std::runtime_error(std::format("failed to map '{}', error : {}", path.string(), std::system_category().message(error_code)));
+		}
+		m_handle = (std::intptr_t)mapping;
+		return;
+	}
+	CloseHandle(file);
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+:	m_data{ std::exchange(other.m_data, nullptr) },
+	m_size{ std::exchange(other.m_size, 0u) },
+	m_handle{ std::exchange(other.m_handle, -1) }
+{}
+
+auto mapped_file::operator = (mapped_file&& other) noexcept -> mapped_file&
+{
+	mapped_file tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+mapped_file::~mapped_file()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_handle != -1)
+		CloseHandle((HANDLE)m_handle);
+}
+
+void mapped_file::swap(mapped_file& other) noexcept
+{
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_handle, other.m_handle);
+}
+
+auto mapped_file::bytes() const noexcept -> std::span<const std::byte>
+{
+	return { m_data, m_size };
+}
+
+auto mapped_file::size() const noexcept -> std::size_t
+{
+	return m_size;
+}
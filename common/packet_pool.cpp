@@ -0,0 +1,175 @@
+#include <stdexcept>
+#include <utility>
+#include <algorithm>
+
+#include "packet_pool.hpp"
+
+packet_buffer::packet_buffer() noexcept
+:	m_slot{ nullptr }
+{}
+
+packet_buffer::packet_buffer(slot_type* slot) noexcept
+:	m_slot{ slot }
+{
+	if (m_slot)
+		m_slot->refs.fetch_add(1u, std::memory_order_relaxed);
+}
+
+packet_buffer::packet_buffer(packet_buffer const& other) noexcept
+:	packet_buffer(other.m_slot)
+{}
+
+packet_buffer::packet_buffer(packet_buffer&& other) noexcept
+:	m_slot{ std::exchange(other.m_slot, nullptr) }
+{}
+
+auto packet_buffer::operator = (packet_buffer const& other) noexcept -> packet_buffer&
+{
+	packet_buffer tmp(other);
+	tmp.swap(*this);
+	return *this;
+}
+
+auto packet_buffer::operator = (packet_buffer&& other) noexcept -> packet_buffer&
+{
+	packet_buffer tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+packet_buffer::~packet_buffer()
+{
+	reset();
+}
+
+void packet_buffer::swap(packet_buffer& other) noexcept
+{
+	std::swap(m_slot, other.m_slot);
+}
+
+void packet_buffer::reset() noexcept
+{
+	auto slot = std::exchange(m_slot, nullptr);
+	if (!slot || slot->refs.fetch_sub(1u, std::memory_order_acq_rel) != 1u)
+		return;
+	if (slot->owner)
+	{
+		slot->owner->release(slot);
+		return;
+	}
+	delete[] slot->data;
+	delete slot;
+}
+
+auto packet_buffer::capacity() const noexcept -> std::span<std::byte>
+{
+	if (!m_slot)
+		return {};
+	return { m_slot->data, m_slot->size };
+}
+
+auto packet_buffer::bytes() const noexcept -> std::span<const std::byte>
+{
+	if (!m_slot)
+		return {};
+	return { m_slot->data, m_slot->length };
+}
+
+auto packet_buffer::size() const noexcept -> std::size_t
+{
+	return m_slot ? m_slot->length : 0u;
+}
+
+auto packet_buffer::empty() const noexcept -> bool
+{
+	return size() < 1u;
+}
+
+auto packet_buffer::resize(std::size_t length) -> packet_buffer&
+{
+	if (!m_slot || length > m_slot->size)
+		throw std::out_of_range("packet buffer length exceeds slot size.");
+	m_slot->length = (std::uint32_t)length;
+	return *this;
+}
+
+auto packet_buffer::use_count() const noexcept -> std::uint32_t
+{
+	return m_slot ? m_slot->refs.load(std::memory_order_relaxed) : 0u;
+}
+
+packet_buffer::operator bool () const noexcept
+{
+	return m_slot != nullptr;
+}
+
+packet_pool::packet_pool(std::size_t slot_count, std::size_t slot_size)
+:	m_slot_count{ slot_count },
+	m_slot_size{ slot_size },
+	m_storage{ std::make_unique<std::byte[]>(slot_count * slot_size) },
+	m_slots{ std::make_unique<slot_type[]>(slot_count) }
+{
+	m_free.reserve(slot_count);
+	for (auto i = 0u; i < slot_count; ++i)
+	{
+		auto& slot = m_slots[i];
+		slot.index = i;
+		slot.size = slot_size;
+		slot.data = m_storage.get() + i * slot_size;
+		slot.owner = this;
+		m_free.push_back((std::uint32_t)(slot_count - i - 1u));
+	}
+}
+
+packet_pool::~packet_pool()
+{}
+
+auto packet_pool::acquire() -> packet_buffer
+{
+	m_acquired.fetch_add(1u, std::memory_order_relaxed);
+	{
+		std::unique_lock lock(m_mutex);
+		if (!m_free.empty())
+		{
+			auto& slot = m_slots[m_free.back()];
+			m_free.pop_back();
+			m_peak_in_use = std::max(++m_in_use, m_peak_in_use);
+			slot.length = 0u;
+			return packet_buffer(&slot);
+		}
+	}
+	m_heap_fallbacks.fetch_add(1u, std::memory_order_relaxed);
+	auto slot = std::make_unique<slot_type>();
+	slot->data = new std::byte[m_slot_size];
+	slot->size = m_slot_size;
+	return packet_buffer(slot.release());
+}
+
+void packet_pool::release(slot_type* slot) noexcept
+{
+	std::unique_lock lock(m_mutex);
+	m_free.push_back(slot->index);
+	--m_in_use;
+}
+
+auto packet_pool::slot_size() const noexcept -> std::size_t
+{
+	return m_slot_size;
+}
+
+auto packet_pool::slot_count() const noexcept -> std::size_t
+{
+	return m_slot_count;
+}
+
+auto packet_pool::statistics() const noexcept -> statistics_type
+{
+	std::unique_lock lock(m_mutex);
+	return statistics_type
+	{
+		.acquired				= m_acquired.load(std::memory_order_relaxed),
+		.heap_fallbacks	= m_heap_fallbacks.load(std::memory_order_relaxed),
+		.in_use					= m_in_use,
+		.peak_in_use		= m_peak_in_use
+	};
+}
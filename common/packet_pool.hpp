@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+struct packet_pool;
+
+/*
+ * Refcounted handle to a packet slot, copying the handle shares the slot,
+ * the slot goes back to its pool when the last handle is released.
+ */
+struct packet_buffer
+{
+	packet_buffer() noexcept;
+	packet_buffer(packet_buffer const& other) noexcept;
+	packet_buffer(packet_buffer&& other) noexcept;
+	packet_buffer& operator = (packet_buffer const& other) noexcept;
+	packet_buffer& operator = (packet_buffer&& other) noexcept;
+ ~packet_buffer();
+
+	void swap(packet_buffer& other) noexcept;
+	void reset() noexcept;
+
+	/* whole slot, to receive into */
+	auto capacity() const noexcept -> std::span<std::byte>;
+
+	/* bytes actually held */
+	auto bytes() const noexcept -> std::span<const std::byte>;
+	auto size() const noexcept -> std::size_t;
+	auto empty() const noexcept -> bool;
+	auto resize(std::size_t length) -> packet_buffer&;
+	auto use_count() const noexcept -> std::uint32_t;
+
+	explicit operator bool () const noexcept;
+
+private:
+	friend struct packet_pool;
+
+	struct slot_type
+	{
+		std::atomic<std::uint32_t>	refs{ 0u };
+		std::uint32_t								length{ 0u };
+		std::uint32_t								index{ 0u };
+		std::size_t									size{ 0u };
+		std::byte*									data{ nullptr };
+		packet_pool*								owner{ nullptr };
+	};
+
+	explicit packet_buffer(slot_type* slot) noexcept;
+
+	slot_type* m_slot;
+};
+
+/*
+ * Fixed slab of equally sized packet slots, allocated once up front. When every
+ * slot is taken acquire() falls back to the heap and counts it, so a steady
+ * state should keep `heap_fallbacks` at zero. Handles must not outlive their pool.
+ */
+struct packet_pool
+{
+	struct statistics_type
+	{
+		std::uint64_t acquired;
+		std::uint64_t heap_fallbacks;
+		std::uint32_t in_use;
+		std::uint32_t peak_in_use;
+	};
+
+	packet_pool(std::size_t slot_count, std::size_t slot_size);
+	packet_pool(packet_pool const&) = delete;
+	packet_pool& operator = (packet_pool const&) = delete;
+ ~packet_pool();
+
+	auto acquire() -> packet_buffer;
+	auto slot_size() const noexcept -> std::size_t;
+	auto slot_count() const noexcept -> std::size_t;
+	auto statistics() const noexcept -> statistics_type;
+
+private:
+	friend struct packet_buffer;
+
+	using slot_type = packet_buffer::slot_type;
+
+	void release(slot_type* slot) noexcept;
+
+	std::size_t										m_slot_count;
+	std::size_t										m_slot_size;
+	std::unique_ptr<std::byte[]>	m_storage;
+	std::unique_ptr<slot_type[]>	m_slots;
+	std::vector<std::uint32_t>		m_free;
+	mutable std::mutex						m_mutex;
+	std::atomic<std::uint64_t>		m_acquired{ 0u };
+	std::atomic<std::uint64_t>		m_heap_fallbacks{ 0u };
+	std::uint32_t									m_in_use{ 0u };
+	std::uint32_t									m_peak_in_use{ 0u };
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <filesystem>
+
+/*
+ * A file read at explicit offsets (pread), there is no shared position or
+ * stream state to reset between reads, so going back to an earlier block
+ * costs nothing extra. The advise calls are readahead hints for the kernel,
+ * they do nothing where the platform has no such thing.
+ */
+struct read_only_file
+{
+	read_only_file() noexcept;
+	read_only_file(std::filesystem::path const& path);
+	read_only_file(read_only_file&& other) noexcept;
+	read_only_file& operator = (read_only_file&& other) noexcept;
+	read_only_file(read_only_file const&) = delete;
+	read_only_file& operator = (read_only_file const&) = delete;
+ ~read_only_file();
+
+	void swap(read_only_file& other) noexcept;
+
+	/* reads until `buffer` is full or the file ends, returns the number of bytes read */
+	auto read(std::uintmax_t offset, std::span<std::byte> buffer) const -> std::size_t;
+
+	/* the file is read front to back, worth a larger readahead window */
+	void advise_sequential() const noexcept;
+	/* start reading this range into the page cache now, without waiting for it */
+	void advise_willneed(std::uintmax_t offset, std::uintmax_t length) const noexcept;
+
+	explicit operator bool () const noexcept;
+
+	/* the inode, or the file index on Windows, tells a file apart from another one put in its place under the same name */
+	static auto identity(std::filesystem::path const& path) -> std::uint64_t;
+
+private:
+	std::intptr_t	m_handle{ -1 };
+};
@@ -0,0 +1,88 @@
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <format>
+
+#include "read_only_file.hpp"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+
+read_only_file::read_only_file() noexcept
+{}
+
+read_only_file::read_only_file(std::filesystem::path const& path)
+{
+	const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error(std::format("failed to open '{}', error : {}", path.string(), std::generic_category().message(errno)));
+	m_handle = fd;
+}
+
+read_only_file::read_only_file(read_only_file&& other) noexcept
+:	m_handle{ std::exchange(other.m_handle, -1) }
+{}
+
+auto read_only_file::operator = (read_only_file&& other) noexcept -> read_only_file&
+{
+	read_only_file tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+read_only_file::~read_only_file()
+{
+	if (m_handle >= 0)
+		::close((int)m_handle);
+}
+
+void read_only_file::swap(read_only_file& other) noexcept
+{
+	std::swap(m_handle, other.m_handle);
+}
+
+auto read_only_file::read(std::uintmax_t offset, std::span<std::byte> buffer) const -> std::size_t
+{
+	std::size_t total = 0u;
+	while (total < buffer.size())
+	{
+		const auto count = ::pread((int)m_handle, buffer.data() + total, buffer.size() - total, (off_t)(offset + total));
+		if (count == 0)
+			break;
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0)
+			throw std::runtime_error(std::format("failed to read at offset {}, error : {}", offset + total, std::generic_category().message(errno)));
+		total += (std::size_t)count;
+	}
+	return total;
+}
+
+void read_only_file::advise_sequential() const noexcept
+{
+#if defined(POSIX_FADV_SEQUENTIAL)
+	::posix_fadvise((int)m_handle, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+void read_only_file::advise_willneed(std::uintmax_t offset, std::uintmax_t length) const noexcept
+{
+#if defined(POSIX_FADV_WILLNEED)
+	::posix_fadvise((int)m_handle, (off_t)offset, (off_t)length, POSIX_FADV_WILLNEED);
+#endif
+}
+
+read_only_file::operator bool () const noexcept
+{
+	return m_handle >= 0;
+}
+
+auto read_only_file::identity(std::filesystem::path const& path) -> std::uint64_t
+{
+	struct stat info{};
+	if (::stat(path.c_str(), &info) != 0)
+		throw std::runtime_error(std::format("failed to stat '{}', error : {}", path.string(), std::generic_category().message(errno)));
+	return (std::uint64_t)info.st_ino;
+}
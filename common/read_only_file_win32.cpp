@@ -0,0 +1,96 @@
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <algorithm>
+#include <format>
+
+#include "read_only_file.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+read_only_file::read_only_file() noexcept
+{}
+
+read_only_file::read_only_file(std::filesystem::path const& path)
+{
+	const auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(std::format("failed to open '{}', error : {}", path.string(), std::system_category().message(GetLastError())));
+	m_handle = (std::intptr_t)file;
+}
+
+read_only_file::read_only_file(read_only_file&& other) noexcept
+:	m_handle{ std::exchange(other.m_handle, -1) }
+{}
+
+auto read_only_file::operator = (read_only_file&& other) noexcept -> read_only_file&
+{
+	read_only_file tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+read_only_file::~read_only_file()
+{
+	if (m_handle != -1)
+		CloseHandle((HANDLE)m_handle);
+}
+
+void read_only_file::swap(read_only_file& other) noexcept
+{
+	std::swap(m_handle, other.m_handle);
+}
+
+/* ReadFile with an offset in the OVERLAPPED, the synchronous counterpart of pread */
+auto read_only_file::read(std::uintmax_t offset, std::span<std::byte> buffer) const -> std::size_t
+{
+	std::size_t total = 0u;
+	while (total < buffer.size())
+	{
+		OVERLAPPED position{};
+		position.Offset = (DWORD)((offset + total) & 0xffffffffu);
+		position.OffsetHigh = (DWORD)((offset + total) >> 32u);
+		DWORD count = 0u;
+		const auto chunk = (DWORD)std::min<std::size_t>(buffer.size() - total, 0x40000000u);
+		if (!ReadFile((HANDLE)m_handle, buffer.data() + total, chunk, &count, &position))
+		{
+			const auto error_code = GetLastError();
+			if (error_code == ERROR_HANDLE_EOF)
+				break;
+			throw std::runtime_error(std::format("failed to read at offset {}, error : {}", offset + total, std::system_category().message(error_code)));
+		}
+		if (count == 0u)
+			break;
+		total += count;
+	}
+	return total;
+}
+
+/* FILE_FLAG_SEQUENTIAL_SCAN already asked the cache manager for aggressive readahead */
+void read_only_file::advise_sequential() const noexcept
+{}
+
+void read_only_file::advise_willneed(std::uintmax_t, std::uintmax_t) const noexcept
+{}
+
+read_only_file::operator bool () const noexcept
+{
+	return m_handle != -1;
+}
+
+auto read_only_file::identity(std::filesystem::path const& path) -> std::uint64_t
+{
+	const auto file = CreateFileW(path.c_str(), 0u, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(std::format("failed to open '{}', error : {}", path.string(), std::system_category().message(GetLastError())));
+	BY_HANDLE_FILE_INFORMATION info{};
+	const auto is_known = GetFileInformationByHandle(file, &info);
+	const auto error_code = GetLastError();
+	CloseHandle(file);
+	if (!is_known)
+		throw std::runtime_error(std::format("failed to query '{}', error : {}", path.string(), std::system_category().message(error_code)));
+	return ((std::uint64_t)info.nFileIndexHigh << 32u) | info.nFileIndexLow;
+}
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <span>
 #include <type_traits>
+#include <stdexcept>
 
 enum byte_order_type : bool
 {
@@ -6,12 +6,47 @@
 #include <string_view>
 #include <tuple>
 #include <span>
+#include <new>
+#include <expected>
+#include <system_error>
+#include <chrono>
+#include <optional>
 
 #include "socket_option.hpp"
 #include "socket_error.hpp"
+#include "socket_filter.hpp"
 
 using int_socket_type = std::intptr_t;
 
+/* result of the non-throwing (std::nothrow) flavour of the socket calls, a time out is std::errc::timed_out */
+template <typename T>
+using socket_result = std::expected<T, std::error_code>;
+
+/* MSG_ZEROCOPY completions reaped since the last call, `copied` counts sends the kernel copied anyway */
+struct socket_zerocopy_status
+{
+	std::uint32_t completed{ 0u };
+	std::uint32_t copied{ 0u };
+};
+
+/* kernel software timestamp (CLOCK_REALTIME), the epoch when the kernel didn't provide one */
+using socket_timestamp = std::chrono::system_clock::time_point;
+
+/* interface index and local address (host order) a datagram arrived on or leaves from (IP_PKTINFO), zero when unknown or don't care */
+struct socket_local
+{
+	std::uint32_t interface{ 0u };
+	std::uint32_t address{ 0u };
+};
+
+/* what the kernel reports next to each datagram, for the parts enabled on the socket */
+struct socket_datagram_info
+{
+	socket_timestamp	timestamp;
+	socket_local			local;
+	std::uint32_t			dropped{ 0u };	/* datagrams the kernel dropped on this socket so far (SO_RXQ_OVFL) */
+};
+
 auto mac_address_to_string(std::span<const std::uint8_t> data) -> std::string;
 
 void v4_init_sockaddr(struct sockaddr_in& target, std::size_t len, const struct address_v4& source);
@@ -26,8 +61,45 @@ auto v4_socket_make_udp(const struct address_v4& address) -> int_socket_type;
 auto v4_socket_make_invalid() -> int_socket_type;
 void v4_socket_bind(int_socket_type socket, const struct address_v4& address);
 void v4_socket_close(int_socket_type socket);
+auto v4_socket_recv(std::nothrow_t, int_socket_type socket, std::span<std::byte>& buffer, struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_send(std::nothrow_t, int_socket_type socket, std::span<const std::byte>& buffer, const struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+/* same as v4_socket_recv but never waits, std::errc::operation_would_block when nothing is queued */
+auto v4_socket_poll(std::nothrow_t, int_socket_type socket, std::span<std::byte>& buffer, struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+/* same as v4_socket_send/_send_gather/_send_zerocopy but never waits, std::errc::operation_would_block when the send buffer is full */
+auto v4_socket_try_send(std::nothrow_t, int_socket_type socket, std::span<const std::byte>& buffer, const struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_try_send_gather(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_try_send_zerocopy(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+/* one UDP_SEGMENT send of as many leading segments as the kernel takes at once, returns how many, 0 when the route has no GSO */
+auto v4_socket_try_send_segmented(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const struct address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_recv_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<struct address_v4> addresses, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_send_batch(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const struct address_v4> addresses, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_recv_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<struct address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags) -> socket_result<std::size_t>;
+/* same as above but never waits, returns 0 when nothing is queued */
+auto v4_socket_poll_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<struct address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags) -> socket_result<std::size_t>;
+auto v4_socket_send_batch(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const struct address_v4> addresses, std::span<const socket_local> sources, std::uint32_t flags) -> socket_result<std::size_t>;
+
+/* the exception flavour of the calls below is a thin wrapper over the std::expected one,
+   a time out becomes error_socket_timed_out, anything else a std::runtime_error */
+[[noreturn]] void v4_socket_throw(std::error_code const& error, std::string_view timed_out, std::string_view failed);
 auto v4_socket_recv(int_socket_type socket, std::span<std::byte>& buffer, struct address_v4& address, std::uint32_t flags) -> std::size_t;
 auto v4_socket_send(int_socket_type socket, std::span<const std::byte>& buffer, const struct address_v4& address, std::uint32_t flags) -> std::size_t;
+auto v4_socket_recv_batch(int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<struct address_v4> addresses, std::uint32_t flags) -> std::size_t;
+auto v4_socket_send_batch(int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const struct address_v4> addresses, std::uint32_t flags) -> std::size_t;
+auto v4_socket_send_gather(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const struct address_v4& address, std::uint32_t flags) -> std::size_t;
+auto v4_socket_send_segmented(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const struct address_v4& address, std::uint32_t flags) -> std::size_t;
+auto v4_socket_send_zerocopy(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const struct address_v4& address, std::uint32_t flags) -> std::size_t;
+auto v4_socket_zerocopy_enable(int_socket_type socket) -> bool;
+auto v4_socket_zerocopy_reap(int_socket_type socket) -> socket_zerocopy_status;
+auto v4_socket_timestamping_enable(int_socket_type socket) -> bool;
+auto v4_socket_timestamping_reap(int_socket_type socket, std::span<socket_timestamp> timestamps) -> std::size_t;
+auto v4_socket_pktinfo_enable(int_socket_type socket) -> bool;
+/* IP_MULTICAST_IF/IP_MULTICAST_TTL, sends to a group leave through the interface holding `interface_address` */
+auto v4_socket_multicast_enable(int_socket_type socket, const struct address_v4& interface_address, std::uint8_t ttl) -> bool;
+auto v4_interface_index(std::string_view name) -> std::uint32_t;
+auto v4_socket_attach_filter(int_socket_type socket, std::span<const socket_filter_instruction> program) -> bool;
+
+/* datagrams the kernel dropped for this socket so far, by the filter or on a full receive queue */
+auto v4_socket_drop_count(int_socket_type socket) -> std::optional<std::uint64_t>;
 
 namespace detail
 {
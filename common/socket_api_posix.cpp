@@ -0,0 +1,909 @@
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <array>
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <expected>
+#include <new>
+
+#include <common/byte_order.hpp>
+#include <common/utility_span.hpp>
+
+#include "socket_api.hpp"
+#include "socket_reactor.hpp"
+#include "address_v4.hpp"
+#include "socket_error.hpp"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <netdb.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <cerrno>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <linux/filter.h>
+#include <linux/sock_diag.h>
+
+
+/* datagrams handed to a single recvmmsg/sendmmsg call */
+static inline constexpr const std::size_t max_socket_batch = 64u;
+
+/* pieces gathered into a single datagram, or a single segmented send */
+static inline constexpr const std::size_t max_socket_gather = 256u;
+
+/* UDP_MAX_SEGMENTS of older kernels, and the payload of one unsegmented IPv4 datagram */
+static inline constexpr const std::size_t max_socket_segments = 64u;
+static inline constexpr const std::size_t max_socket_payload = 0xffffu - 20u - 8u;
+
+/* transmit timestamps kept per socket until reaped, older ones are dropped past this */
+static inline constexpr const std::size_t max_socket_timestamps = 256u;
+
+/* sockets with SO_ZEROCOPY or SO_TIMESTAMPING enabled and what was reaped from their error queue so far */
+struct socket_error_queue
+{
+  std::mutex                    lock;
+  bool                          zerocopy{ false };
+  bool                          timestamping{ false };
+  socket_zerocopy_status        completions;
+  std::deque<socket_timestamp>  transmitted;
+};
+
+/* guards the registry only, each queue is drained under its own lock */
+static std::shared_mutex error_queue_mutex;
+static std::unordered_map<int_socket_type, std::shared_ptr<socket_error_queue>> error_queue_sockets;
+
+/* per descriptor, set while the socket is in the registry, higher descriptors always look it up */
+static inline constexpr const std::size_t max_error_queue_flags = 0x10000u;
+static std::array<std::atomic<bool>, max_error_queue_flags> error_queue_flags;
+
+static auto socket_last_error() -> std::int32_t
+{
+  return errno;
+}
+
+static auto is_time_out_error(std::int32_t error)
+{
+  return EAGAIN == error || EWOULDBLOCK == error || ETIMEDOUT == error;
+}
+
+static auto last_error_as_string(std::int32_t last_error = socket_last_error()) -> std::string
+{
+  return std::format("{} (#{})", std::generic_category().message(last_error), last_error);
+}
+
+static auto socket_timeout(int_socket_type socket, int option) -> std::chrono::milliseconds
+{
+  /* non-blocking sockets ignore SO_RCVTIMEO/SO_SNDTIMEO, the value is only kept for the reactor */
+  std::uint32_t value{ 0 };
+  detail::socket_option_get(socket, SOL_SOCKET, option, &value, sizeof(value));
+  return std::chrono::milliseconds{ value };
+}
+
+static auto to_timestamp(timespec const& value) -> socket_timestamp
+{
+  using namespace std::chrono;
+  return socket_timestamp{ duration_cast<system_clock::duration>(seconds{ value.tv_sec } + nanoseconds{ value.tv_nsec }) };
+}
+
+static auto error_queue_find(int_socket_type socket) -> std::shared_ptr<socket_error_queue>
+{
+  /* sockets that enabled neither never get near the lock */
+  if ((std::size_t)socket < max_error_queue_flags && !error_queue_flags[(std::size_t)socket].load(std::memory_order_acquire))
+    return nullptr;
+  std::shared_lock lock(error_queue_mutex);
+  const auto it = error_queue_sockets.find(socket);
+  return it != error_queue_sockets.end() ? it->second : nullptr;
+}
+
+static auto error_queue_make(int_socket_type socket) -> std::shared_ptr<socket_error_queue>
+{
+  std::unique_lock lock(error_queue_mutex);
+  auto& queue = error_queue_sockets[socket];
+  if (!queue)
+    queue = std::make_shared<socket_error_queue>();
+  if ((std::size_t)socket < max_error_queue_flags)
+    error_queue_flags[(std::size_t)socket].store(true, std::memory_order_release);
+  return queue;
+}
+
+static auto error_queue_drain(int_socket_type socket) -> bool
+{
+  const auto entry = error_queue_find(socket);
+  if (!entry)
+    return false;
+
+  auto& queue = *entry;
+  std::unique_lock lock(queue.lock);
+  auto drained = false;
+  while (true)
+  {
+    alignas(cmsghdr) std::array<std::byte, 256u> control;
+    msghdr header{};
+    header.msg_control = control.data();
+    header.msg_controllen = control.size();
+    if (recvmsg((int)socket, &header, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+      break;
+    std::optional<socket_timestamp> stamp;
+    for (auto cmsg = CMSG_FIRSTHDR(&header); cmsg; cmsg = CMSG_NXTHDR(&header, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+      {
+        scm_timestamping value;
+        std::memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+        stamp = to_timestamp(value.ts[0]);
+        continue;
+      }
+      if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR)
+        continue;
+      sock_extended_err error;
+      std::memcpy(&error, CMSG_DATA(cmsg), sizeof(error));
+      if (error.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+      /* one notification covers the inclusive range of send sequence numbers [ee_info, ee_data] */
+      const auto count = error.ee_data - error.ee_info + 1u;
+      queue.completions.completed += count;
+      if (error.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+        queue.completions.copied += count;
+      drained = true;
+    }
+    if (stamp && queue.timestamping)
+    {
+      if (queue.transmitted.size() >= max_socket_timestamps)
+        queue.transmitted.pop_front();
+      queue.transmitted.push_back(*stamp);
+    }
+  }
+  return drained;
+}
+
+static auto socket_wait(int_socket_type socket, socket_reactor::readiness_type what, int option) -> bool
+{
+  /* pending zerocopy notifications and transmit timestamps keep the socket in EPOLLERR, drain them or the wait returns at once */
+  error_queue_drain(socket);
+  return socket_reactor::this_thread().wait(socket, what, socket_timeout(socket, option));
+}
+
+auto v4_resolve_single(std::string_view target) -> std::uint32_t
+{
+  using namespace std::string_literals;
+  std::string tmp{ target };
+
+  addrinfo hints{};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_DGRAM;
+  addrinfo* result{ nullptr };
+  if (auto error = getaddrinfo(tmp.c_str(), nullptr, &hints, &result); error != 0 || !result)
+    throw std::runtime_error(tmp + " cannot be resolved, error : "s + gai_strerror(error));
+  const auto address = reinterpret_cast<const sockaddr_in*>(result->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(result);
+  return net_to_host(address);
+}
+
+
+auto v4_socket_make_udp() -> int_socket_type
+{
+  using namespace std::string_literals;
+
+  if (auto int_sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP); int_sock >= 0)
+  {
+    return int_sock;
+  }
+  throw std::runtime_error("can't create socket, error code : "s +
+                           last_error_as_string());
+}
+
+auto v4_socket_make_udp(const address_v4& address) -> int_socket_type
+{
+  const auto int_sock = v4_socket_make_udp();
+  v4_socket_bind(int_sock, address);
+  return int_sock;
+}
+
+auto v4_socket_make_invalid() -> int_socket_type
+{
+  return -1;
+}
+
+void v4_socket_bind(int_socket_type socket, const address_v4& address)
+{
+  using namespace std::string_literals;
+
+  const auto sai = address.as<sockaddr_in>();
+  if (const auto error = bind((int)socket, (const sockaddr*)&sai, sizeof(sai)); error != 0)
+    throw std::runtime_error(std::format("failed to bind socket with address '{}', error code : {}", address.to_string(), last_error_as_string()));
+}
+
+void v4_init_sockaddr(sockaddr_in& target, std::size_t len, const struct address_v4& source)
+{
+  std::memset(&target, 0, len);
+  target.sin_family = AF_INET;
+  target.sin_port = source.net_port();
+  target.sin_addr.s_addr = source.net_addr();
+}
+
+void v4_init_sockaddr(sockaddr& target, std::size_t len, const struct address_v4& source)
+{
+  if(len < sizeof(sockaddr_in))
+    throw std::logic_error("`target` is too small.");
+  v4_init_sockaddr(*reinterpret_cast<sockaddr_in*>(&target), len, source);
+}
+
+auto v4_parse_address_and_port(std::string_view what) -> std::pair<uint32_t, uint16_t>
+{
+  using namespace std::string_literals;
+  uint32_t port{ 0 };
+  in_addr address;
+  std::string tmp;
+
+  if (auto it = what.find(':'); it != what.npos) {
+    tmp = what.substr(it + 1);
+    if (tmp.size() > 0)
+    {
+      std::size_t idx;
+      port = std::stoul(tmp, &idx, 10);
+      if (idx != tmp.size() || port > 65535)
+        throw std::logic_error(tmp + " is not a valid port number.");
+      port &= 0xffff;
+    }
+    what = what.substr(0, it);
+  }
+  tmp = what;
+  if (!inet_pton(AF_INET, tmp.c_str(), &address)) {
+    return { v4_resolve_single(tmp), port };
+  }
+  return { net_to_host(address.s_addr), port };
+}
+
+auto v4_parse_address_and_port(sockaddr_in const& what) -> std::pair<uint32_t, uint16_t>
+{
+  if (what.sin_family != AF_INET)
+    throw std::logic_error("address family mismatch.");
+  return std::pair {
+    net_to_host(what.sin_addr.s_addr),
+    net_to_host(what.sin_port)
+  };
+}
+
+auto v4_address_to_string(std::uint32_t address) -> std::string
+{
+  using namespace std::string_literals;
+  char buff [INET_ADDRSTRLEN];
+  in_addr addr_bits;
+
+  std::memset(buff, 0, sizeof(buff));
+  addr_bits.s_addr = host_to_net(address);
+  if (!inet_ntop(AF_INET, &addr_bits, buff, sizeof(buff)))
+    throw std::runtime_error("unable to convert address to string, error code : "s +
+                             last_error_as_string());
+  std::string tmp;
+  tmp.assign(buff);
+  return tmp;
+}
+
+auto v4_parse_address(std::string_view what) -> uint32_t
+{
+  auto[address, port] = v4_parse_address_and_port(what);
+  return address;
+}
+
+auto v4_socket_close(int_socket_type socket) -> void
+{
+  using namespace std::string_literals;
+
+  if ((std::size_t)socket >= max_error_queue_flags || error_queue_flags[(std::size_t)socket].exchange(false, std::memory_order_acq_rel))
+  {
+    std::unique_lock lock(error_queue_mutex);
+    error_queue_sockets.erase(socket);
+  }
+  if (const auto error = ::close((int)socket); error != 0)
+  {
+    std::cerr << ("WARNING! failed to close socket, error code : "s + last_error_as_string() + "\n"s);
+  }
+}
+
+
+
+static auto socket_recv(int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags, bool wait) -> socket_result<std::size_t>
+{
+  sockaddr_in addr_in;
+  socklen_t addr_len{ sizeof(addr_in) };
+
+  while (true)
+  {
+    auto received_bytes = recvfrom((int)socket, buffer.data(), buffer.size(), (int)flags, (sockaddr*)&addr_in, &addr_len);
+    if (received_bytes >= 0)
+    {
+      if (addr_len != sizeof (addr_in))
+        return std::unexpected(std::make_error_code(std::errc::address_family_not_supported));
+      address.assign_from(addr_in);
+      buffer = buffer.subspan(0, (std::size_t)received_bytes);
+      return (std::size_t)received_bytes;
+    }
+
+    const auto error_code = socket_last_error();
+    if (error_code == EINTR)
+      continue;
+    if (!is_time_out_error(error_code))
+      return std::unexpected(std::error_code(error_code, std::generic_category()));
+    if (!wait)
+      return std::unexpected(std::make_error_code(std::errc::operation_would_block));
+    if (!socket_wait(socket, socket_reactor::readiness_read, SO_RCVTIMEO))
+      return std::unexpected(std::make_error_code(std::errc::timed_out));
+    addr_len = sizeof(addr_in);
+  }
+}
+
+auto v4_socket_recv(std::nothrow_t, int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return socket_recv(socket, buffer, address, flags, true);
+}
+
+auto v4_socket_poll(std::nothrow_t, int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  /* callers poll after their own readiness wait, which also wakes up for a non-empty error queue */
+  error_queue_drain(socket);
+  return socket_recv(socket, buffer, address, flags | MSG_DONTWAIT, false);
+}
+
+static auto socket_send(int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags, bool wait) -> socket_result<std::size_t>
+{
+  const auto addr_in = address.as<sockaddr_in>();
+
+  while (true)
+  {
+    auto sent_bytes = sendto((int)socket, buffer.data(), buffer.size(), (int)flags | MSG_NOSIGNAL, (const sockaddr*)&addr_in, sizeof(addr_in));
+    if (sent_bytes >= 0)
+    {
+      buffer = buffer.subspan((std::size_t)sent_bytes);
+      return (std::size_t)sent_bytes;
+    }
+
+    const auto error_code = socket_last_error();
+    if (error_code == EINTR)
+      continue;
+    if (!is_time_out_error(error_code))
+      return std::unexpected(std::error_code(error_code, std::generic_category()));
+    if (!wait)
+      return std::unexpected(std::make_error_code(std::errc::operation_would_block));
+    if (!socket_wait(socket, socket_reactor::readiness_write, SO_SNDTIMEO))
+      return std::unexpected(std::make_error_code(std::errc::timed_out));
+  }
+}
+
+auto v4_socket_send(std::nothrow_t, int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return socket_send(socket, buffer, address, flags, true);
+}
+
+auto v4_socket_try_send(std::nothrow_t, int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return socket_send(socket, buffer, address, flags | MSG_DONTWAIT, false);
+}
+
+auto v4_socket_recv_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return v4_socket_recv_batch(std::nothrow, socket, buffers, addresses, std::span<socket_datagram_info>{}, flags);
+}
+
+static auto socket_recv_batch(int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags, bool wait) -> socket_result<std::size_t>
+{
+  const auto count = std::min({ buffers.size(), addresses.size(), max_socket_batch });
+  if (count < 1u)
+    return 0u;
+
+  /* room for the SCM_TIMESTAMPING, IP_PKTINFO and SO_RXQ_OVFL of every datagram, only handed to the kernel when the info is wanted */
+  static constexpr const auto control_size = CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(in_pktinfo)) + CMSG_SPACE(sizeof(std::uint32_t));
+  const auto stamped = infos.size() >= count;
+
+  std::array<mmsghdr, max_socket_batch> headers;
+  std::array<iovec, max_socket_batch> vectors;
+  std::array<sockaddr_in, max_socket_batch> names;
+  alignas(cmsghdr) std::array<std::array<std::byte, control_size>, max_socket_batch> controls;
+
+  for (auto i = 0u; i < count; ++i)
+  {
+    vectors[i] = iovec{ .iov_base = buffers[i].data(), .iov_len = buffers[i].size() };
+    headers[i] = mmsghdr{};
+    headers[i].msg_hdr.msg_name = &names[i];
+    headers[i].msg_hdr.msg_namelen = sizeof(names[i]);
+    headers[i].msg_hdr.msg_iov = &vectors[i];
+    headers[i].msg_hdr.msg_iovlen = 1u;
+    if (stamped)
+    {
+      headers[i].msg_hdr.msg_control = controls[i].data();
+      headers[i].msg_hdr.msg_controllen = control_size;
+    }
+  }
+
+  while (true)
+  {
+    auto received = recvmmsg((int)socket, headers.data(), (unsigned)count, (int)flags, nullptr);
+    if (received > 0)
+    {
+      for (auto i = 0u; i < (unsigned)received; ++i)
+      {
+        if (headers[i].msg_hdr.msg_namelen != sizeof (sockaddr_in))
+          return std::unexpected(std::make_error_code(std::errc::address_family_not_supported));
+        addresses[i].assign_from(names[i]);
+        buffers[i] = buffers[i].subspan(0, headers[i].msg_len);
+        if (!stamped)
+          continue;
+        infos[i] = socket_datagram_info{};
+        for (auto cmsg = CMSG_FIRSTHDR(&headers[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&headers[i].msg_hdr, cmsg))
+        {
+          if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+          {
+            scm_timestamping value;
+            std::memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+            infos[i].timestamp = to_timestamp(value.ts[0]);
+          }
+          else if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+            std::memcpy(&infos[i].dropped, CMSG_DATA(cmsg), sizeof(infos[i].dropped));
+          else if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO)
+          {
+            /* ipi_spec_dst is the local address a reply should leave from, ipi_addr may be the broadcast */
+            in_pktinfo value;
+            std::memcpy(&value, CMSG_DATA(cmsg), sizeof(value));
+            infos[i].local = socket_local{ (std::uint32_t)value.ipi_ifindex, ntohl(value.ipi_spec_dst.s_addr) };
+          }
+        }
+      }
+      return (std::size_t)received;
+    }
+
+    const auto error_code = socket_last_error();
+    if (received < 0 && error_code == EINTR)
+      continue;
+    if (received < 0 && !is_time_out_error(error_code))
+      return std::unexpected(std::error_code(error_code, std::generic_category()));
+    if (!wait)
+      return 0u;
+    if (!socket_wait(socket, socket_reactor::readiness_read, SO_RCVTIMEO))
+      return std::unexpected(std::make_error_code(std::errc::timed_out));
+  }
+}
+
+auto v4_socket_recv_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return socket_recv_batch(socket, buffers, addresses, infos, flags, true);
+}
+
+auto v4_socket_poll_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  /* the socket is non-blocking, with SO_BUSY_POLL each call also polls the device queue once */
+  return socket_recv_batch(socket, buffers, addresses, infos, flags | MSG_DONTWAIT, false);
+}
+
+auto v4_socket_send_batch(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> addresses, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return v4_socket_send_batch(std::nothrow, socket, buffers, addresses, std::span<const socket_local>{}, flags);
+}
+
+auto v4_socket_send_batch(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> addresses, std::span<const socket_local> sources, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  const auto count = std::min(buffers.size(), addresses.size());
+  std::array<mmsghdr, max_socket_batch> headers;
+  std::array<iovec, max_socket_batch> vectors;
+  std::array<sockaddr_in, max_socket_batch> names;
+
+  /* an IP_PKTINFO per datagram pins the source address and outgoing interface, skipped when both are zero */
+  static constexpr const auto control_size = CMSG_SPACE(sizeof(in_pktinfo));
+  alignas(cmsghdr) std::array<std::array<std::byte, control_size>, max_socket_batch> controls;
+  const auto pinned = sources.size() >= count;
+
+  std::size_t sent_total{ 0u };
+  while (sent_total < count)
+  {
+    const auto chunk = std::min(count - sent_total, max_socket_batch);
+    for (auto i = 0u; i < chunk; ++i)
+    {
+      const auto& buffer = buffers[sent_total + i];
+      names[i] = addresses[sent_total + i].as<sockaddr_in>();
+      vectors[i] = iovec{ .iov_base = (void*)buffer.data(), .iov_len = buffer.size() };
+      headers[i] = mmsghdr{};
+      headers[i].msg_hdr.msg_name = &names[i];
+      headers[i].msg_hdr.msg_namelen = sizeof(names[i]);
+      headers[i].msg_hdr.msg_iov = &vectors[i];
+      headers[i].msg_hdr.msg_iovlen = 1u;
+      if (!pinned)
+        continue;
+      const auto& source = sources[sent_total + i];
+      if (source.interface == 0u && source.address == 0u)
+        continue;
+      headers[i].msg_hdr.msg_control = controls[i].data();
+      headers[i].msg_hdr.msg_controllen = control_size;
+      auto cmsg = CMSG_FIRSTHDR(&headers[i].msg_hdr);
+      cmsg->cmsg_level = IPPROTO_IP;
+      cmsg->cmsg_type = IP_PKTINFO;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(in_pktinfo));
+      in_pktinfo value{};
+      value.ipi_ifindex = (int)source.interface;
+      value.ipi_spec_dst.s_addr = htonl(source.address);
+      std::memcpy(CMSG_DATA(cmsg), &value, sizeof(value));
+    }
+
+    auto sent = sendmmsg((int)socket, headers.data(), (unsigned)chunk, (int)flags | MSG_NOSIGNAL);
+    if (sent > 0)
+    {
+      sent_total += (std::size_t)sent;
+      continue;
+    }
+
+    const auto error_code = socket_last_error();
+    if (sent < 0 && error_code == EINTR)
+      continue;
+    if (sent < 0 && !is_time_out_error(error_code))
+      return std::unexpected(std::error_code(error_code, std::generic_category()));
+    if (!socket_wait(socket, socket_reactor::readiness_write, SO_SNDTIMEO))
+      return std::unexpected(std::make_error_code(std::errc::timed_out));
+  }
+  return sent_total;
+}
+
+void v4_socket_throw(std::error_code const& error, std::string_view timed_out, std::string_view failed)
+{
+  using namespace std::string_literals;
+  if (error == std::errc::timed_out)
+    throw error_socket_timed_out(timed_out);
+  if (error == std::errc::address_family_not_supported)
+    throw std::runtime_error("packet sender address size mismatch."s);
+  throw std::runtime_error(std::format("{}, error code : {}", failed, last_error_as_string(error.value())));
+}
+
+auto v4_socket_recv(int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_recv(std::nothrow, socket, buffer, address, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "receive operation timed out.", "failed to receive bytes from socket");
+}
+
+auto v4_socket_send(int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_send(std::nothrow, socket, buffer, address, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "send operation timed out.", "failed to send bytes trough socket");
+}
+
+auto v4_socket_recv_batch(int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_recv_batch(std::nothrow, socket, buffers, addresses, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "receive operation timed out.", "failed to receive bytes from socket");
+}
+
+auto v4_socket_send_batch(int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> addresses, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_send_batch(std::nothrow, socket, buffers, addresses, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "send operation timed out.", "failed to send bytes trough socket");
+}
+
+/* with a segment size the kernel splits the send into datagrams of that size (UDP GSO),
+   returns 0 when it refuses to, so the caller can fall back to one send per datagram */
+static auto socket_send_message(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, int flags, std::uint16_t segment_size, bool wait) -> socket_result<std::size_t>
+{
+  using namespace std::string_literals;
+  if (pieces.size() > max_socket_gather)
+    throw std::invalid_argument("too many pieces for a single datagram."s);
+
+  auto addr_in = address.as<sockaddr_in>();
+  std::array<iovec, max_socket_gather> vectors;
+  for (auto i = 0u; i < pieces.size(); ++i)
+    vectors[i] = iovec{ .iov_base = (void*)pieces[i].data(), .iov_len = pieces[i].size() };
+
+  msghdr header{};
+  header.msg_name = &addr_in;
+  header.msg_namelen = sizeof(addr_in);
+  header.msg_iov = vectors.data();
+  header.msg_iovlen = pieces.size();
+
+  alignas(cmsghdr) std::array<std::byte, CMSG_SPACE(sizeof(std::uint16_t))> control{};
+  if (segment_size > 0u)
+  {
+    header.msg_control = control.data();
+    header.msg_controllen = control.size();
+    auto cmsg = CMSG_FIRSTHDR(&header);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segment_size));
+    std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+  }
+
+  while (true)
+  {
+    auto sent_bytes = sendmsg((int)socket, &header, flags | MSG_NOSIGNAL);
+    if (sent_bytes >= 0)
+      return (std::size_t)sent_bytes;
+
+    const auto error_code = socket_last_error();
+    if (error_code == EINTR)
+      continue;
+    /* EMSGSIZE is a segment larger than the path MTU, GSO never fragments */
+    if (segment_size > 0u && (error_code == EIO || error_code == EINVAL || error_code == ENOPROTOOPT || error_code == EMSGSIZE))
+      return 0u;
+    if (error_code == ENOBUFS && (flags & MSG_ZEROCOPY))
+    {
+      /* out of option memory for notifications, reap them or send this one as a copy */
+      if (!error_queue_drain(socket))
+        flags &= ~MSG_ZEROCOPY;
+      continue;
+    }
+    if (error_code == EMSGSIZE && (flags & MSG_ZEROCOPY))
+    {
+      /* pinned pages don't fit the fragment list of a single skb, only a copy can carry it */
+      flags &= ~MSG_ZEROCOPY;
+      continue;
+    }
+    if (!is_time_out_error(error_code))
+      return std::unexpected(std::error_code(error_code, std::generic_category()));
+    if (!wait)
+      return std::unexpected(std::make_error_code(std::errc::operation_would_block));
+    if (!socket_wait(socket, socket_reactor::readiness_write, SO_SNDTIMEO))
+      return std::unexpected(std::make_error_code(std::errc::timed_out));
+  }
+}
+
+static auto socket_send_message(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, int flags, std::uint16_t segment_size = 0u) -> std::size_t
+{
+  if (const auto result = socket_send_message(std::nothrow, socket, pieces, address, flags, segment_size, true); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "send operation timed out.", "failed to send bytes trough socket");
+}
+
+auto v4_socket_send_gather(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  return socket_send_message(socket, pieces, address, (int)flags);
+}
+
+auto v4_socket_send_zerocopy(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  /* the pages behind the pieces must stay untouched until the completion is reaped */
+  return socket_send_message(socket, pieces, address, (int)flags | MSG_ZEROCOPY);
+}
+
+auto v4_socket_try_send_gather(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return socket_send_message(std::nothrow, socket, pieces, address, (int)flags | MSG_DONTWAIT, 0u, false);
+}
+
+auto v4_socket_try_send_zerocopy(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return socket_send_message(std::nothrow, socket, pieces, address, (int)flags | MSG_ZEROCOPY | MSG_DONTWAIT, 0u, false);
+}
+
+auto v4_socket_try_send_segmented(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  using namespace std::string_literals;
+  if (segment_size < 1u || segment_size > max_socket_payload)
+    throw std::invalid_argument("invalid segment size."s);
+
+  std::size_t total{ 0u };
+  for (auto&& piece : pieces)
+    total += piece.size();
+  const auto count = std::min({ max_socket_segments, max_socket_payload / segment_size, (total + segment_size - 1u) / segment_size });
+
+  std::array<std::span<const std::byte>, max_socket_gather> slice;
+  std::size_t offset{ 0u };
+  const auto used = take_gather(pieces, offset, count * segment_size, slice);
+  const auto sent = socket_send_message(std::nothrow, socket, std::span(slice).first(used), address, (int)flags | MSG_DONTWAIT, (std::uint16_t)segment_size, false);
+  if (!sent)
+    return std::unexpected(sent.error());
+  return *sent > 0u ? count : 0u;
+}
+
+auto v4_socket_send_segmented(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  using namespace std::string_literals;
+  if (segment_size < 1u || segment_size > max_socket_payload)
+    throw std::invalid_argument("invalid segment size."s);
+
+  std::size_t total{ 0u };
+  for (auto&& piece : pieces)
+    total += piece.size();
+  const auto datagrams = (total + segment_size - 1u) / segment_size;
+  const auto per_send = std::min(max_socket_segments, max_socket_payload / segment_size);
+
+  std::array<std::span<const std::byte>, max_socket_gather> slice;
+  std::size_t offset{ 0u };
+  std::size_t sent{ 0u };
+  auto segmented = per_send > 1u;
+  while (sent < datagrams)
+  {
+    if (segmented)
+    {
+      auto rest = pieces;
+      auto rest_offset = offset;
+      const auto count = std::min(per_send, datagrams - sent);
+      const auto used = take_gather(rest, rest_offset, count * segment_size, slice);
+      if (!socket_send_message(socket, std::span(slice).first(used), address, (int)flags, (std::uint16_t)segment_size))
+      {
+        /* no GSO for this route or device, stay with one datagram per send from here on */
+        segmented = false;
+        continue;
+      }
+      pieces = rest;
+      offset = rest_offset;
+      sent += count;
+      continue;
+    }
+    const auto used = take_gather(pieces, offset, segment_size, slice);
+    socket_send_message(socket, std::span(slice).first(used), address, (int)flags);
+    ++sent;
+  }
+  return sent;
+}
+
+auto v4_socket_zerocopy_enable(int_socket_type socket) -> bool
+{
+  const int enable{ 1 };
+  if (setsockopt((int)socket, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) != 0)
+    return false;
+  const auto queue = error_queue_make(socket);
+  std::unique_lock lock(queue->lock);
+  queue->zerocopy = true;
+  return true;
+}
+
+auto v4_socket_zerocopy_reap(int_socket_type socket) -> socket_zerocopy_status
+{
+  error_queue_drain(socket);
+  const auto queue = error_queue_find(socket);
+  if (!queue)
+    return {};
+  std::unique_lock lock(queue->lock);
+  return std::exchange(queue->completions, socket_zerocopy_status{});
+}
+
+auto v4_socket_timestamping_enable(int_socket_type socket) -> bool
+{
+  /* software stamps only, TSONLY keeps the payload out of the error queue, OPT_ID numbers the sends */
+  const int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE
+                  | SOF_TIMESTAMPING_OPT_TSONLY | SOF_TIMESTAMPING_OPT_ID;
+  if (setsockopt((int)socket, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != 0)
+    return false;
+  const auto queue = error_queue_make(socket);
+  std::unique_lock lock(queue->lock);
+  queue->timestamping = true;
+  return true;
+}
+
+auto v4_socket_timestamping_reap(int_socket_type socket, std::span<socket_timestamp> timestamps) -> std::size_t
+{
+  error_queue_drain(socket);
+  const auto queue = error_queue_find(socket);
+  if (!queue)
+    return 0u;
+  std::unique_lock lock(queue->lock);
+  auto& transmitted = queue->transmitted;
+  const auto count = std::min(timestamps.size(), transmitted.size());
+  std::copy_n(transmitted.begin(), count, timestamps.begin());
+  transmitted.erase(transmitted.begin(), transmitted.begin() + (std::ptrdiff_t)count);
+  return count;
+}
+
+auto v4_socket_pktinfo_enable(int_socket_type socket) -> bool
+{
+  const int enable{ 1 };
+  return setsockopt((int)socket, IPPROTO_IP, IP_PKTINFO, &enable, sizeof(enable)) == 0;
+}
+
+auto v4_socket_multicast_enable(int_socket_type socket, const address_v4& interface_address, std::uint8_t ttl) -> bool
+{
+  const in_addr interface_v{ .s_addr = interface_address.net_addr() };
+  const int ttl_v{ ttl };
+  return setsockopt((int)socket, IPPROTO_IP, IP_MULTICAST_IF, &interface_v, sizeof(interface_v)) == 0
+      && setsockopt((int)socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl_v, sizeof(ttl_v)) == 0;
+}
+
+auto v4_interface_index(std::string_view name) -> std::uint32_t
+{
+  return if_nametoindex(std::string{ name }.c_str());
+}
+
+auto v4_socket_attach_filter(int_socket_type socket, std::span<const socket_filter_instruction> program) -> bool
+{
+  static_assert(sizeof(socket_filter_instruction) == sizeof(sock_filter));
+  const sock_fprog filter{ .len = (unsigned short)program.size(), .filter = (sock_filter*)program.data() };
+  return setsockopt((int)socket, SOL_SOCKET, SO_ATTACH_FILTER, &filter, sizeof(filter)) == 0;
+}
+
+auto v4_socket_drop_count(int_socket_type socket) -> std::optional<std::uint64_t>
+{
+  std::array<std::uint32_t, SK_MEMINFO_VARS> meminfo{};
+  socklen_t length = sizeof(meminfo);
+  if (getsockopt((int)socket, SOL_SOCKET, SO_MEMINFO, meminfo.data(), &length) != 0 || length <= SK_MEMINFO_DROPS * sizeof(std::uint32_t))
+    return std::nullopt;
+  return meminfo[SK_MEMINFO_DROPS];
+}
+
+static auto to_hex(std::uint8_t value) -> std::string
+{
+  static constexpr const char x [] = "0123456789ABCDEF";
+  return std::string{ x[(value >> 4) & 0xf], x[value & 0xf] };
+}
+
+auto mac_address_to_string(std::span<const std::uint8_t> data)
+  -> std::string
+{
+  using namespace std::string_literals;
+  if (data.size () < 1u)
+    throw std::runtime_error("address is empty"s);
+
+  std::string value;
+  value.append(to_hex(data.front()));
+  for (auto&& a_byte : data.subspan(1u))
+  {
+    value.push_back('-');
+    value.append(to_hex(a_byte));
+  }
+  return value;
+}
+
+namespace detail
+{
+  /* SO_RCVTIMEO/SO_SNDTIMEO take milliseconds like on WinSock, the kernel wants a timeval */
+  static auto is_timeout_option(int level, int option, int size) -> bool
+  {
+    return level == SOL_SOCKET && (option == SO_RCVTIMEO || option == SO_SNDTIMEO) && size == sizeof(std::uint32_t);
+  }
+
+  void socket_option_set(int_socket_type target, int level, int option, const void* value, int size)
+  {
+    using namespace std::string_literals;
+    int result;
+    if (is_timeout_option(level, option, size))
+    {
+      const auto value_ms = *(const std::uint32_t*)value;
+      const timeval value_tv{ .tv_sec = (time_t)(value_ms / 1000u), .tv_usec = (suseconds_t)((value_ms % 1000u) * 1000u) };
+      result = setsockopt((int)target, level, option, &value_tv, sizeof(value_tv));
+    }
+    else
+      result = setsockopt((int)target, level, option, value, (socklen_t)size);
+    if (result != 0)
+      throw std::runtime_error("failed to set socket option, error code : "s +
+                              last_error_as_string());
+  }
+
+  void socket_option_get(int_socket_type target, int level, int option, void* value, int size)
+  {
+    using namespace std::string_literals;
+    if (is_timeout_option(level, option, size))
+    {
+      timeval value_tv{};
+      socklen_t value_size{ sizeof(value_tv) };
+      if (getsockopt((int)target, level, option, &value_tv, &value_size) != 0)
+        throw std::runtime_error("failed to get socket option, error code : "s +
+                                last_error_as_string());
+      *(std::uint32_t*)value = (std::uint32_t)(value_tv.tv_sec * 1000u + value_tv.tv_usec / 1000u);
+      return;
+    }
+    socklen_t actual_size = (socklen_t)size;
+    if (getsockopt((int)target, level, option, value, &actual_size) != 0)
+      throw std::runtime_error("failed to get socket option, error code : "s +
+                              last_error_as_string());
+    if ((int)actual_size != size)
+      throw std::logic_error("socket option value size mismatch."s);
+  }
+}
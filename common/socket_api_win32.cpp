@@ -6,8 +6,13 @@
 #include <iostream>
 #include <system_error>
 #include <charconv>
+#include <algorithm>
+#include <array>
+#include <expected>
+#include <new>
 
 #include <common/byte_order.hpp>
+#include <common/utility_span.hpp>
 
 #include "socket_api.hpp"
 #include "address_v4.hpp"
@@ -19,8 +24,10 @@
 #include <ws2tcpip.h>
 #include <WinSock2.h>
 #include <Windows.h>
+#include <iphlpapi.h>
 
 #pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "iphlpapi.lib")
 
 
 static auto socket_last_error() -> std::int32_t
@@ -299,10 +306,8 @@ auto v4_socket_close(int_socket_type socket) -> void
 
 
 
-auto v4_socket_recv(int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> std::size_t
+auto v4_socket_recv(std::nothrow_t, int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
 {
-  using namespace std::string_literals;
-
   sockaddr_in addr_in;
   int addr_len{ sizeof(addr_in) };
   const auto size = std::min((int)buffer.size(), 0x7fffffff);
@@ -314,22 +319,20 @@ auto v4_socket_recv(int_socket_type socket, std::span<std::byte>& buffer, addres
   if (received_bytes >= 0) 
   {
     if (addr_len != sizeof (addr_in))
-      throw std::runtime_error("packet sender address size mismatch."s);
+      return std::unexpected(std::make_error_code(std::errc::address_family_not_supported));
     address.assign_from(addr_in);
     buffer = buffer.subspan(0, (unsigned)received_bytes);
-    return received_bytes;
+    return (std::size_t)received_bytes;
   }
 
   if (const auto error_code = socket_last_error(); is_time_out_error(error_code))
-    throw  error_socket_timed_out{ "receive operation timed out." };
-
-  throw std::runtime_error("failed to receive bytes from socket, error code : "s + 
-                           last_error_as_string());
+    return std::unexpected(std::make_error_code(std::errc::timed_out));
+  else
+    return std::unexpected(std::error_code(error_code, std::system_category()));
 }
 
-auto v4_socket_send(int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> std::size_t
+auto v4_socket_send(std::nothrow_t, int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
 {
-  using namespace std::string_literals;
   const auto size = std::min((int)buffer.size(), 0x7fffffff);
   auto* const data = (char*)buffer.data(); 
   const auto addr_in = address.as<sockaddr_in>();
@@ -340,14 +343,269 @@ auto v4_socket_send(int_socket_type socket, std::span<const std::byte>& buffer,
   if (sent_bytes >= 0)
   {
     buffer = buffer.subspan(sent_bytes);
-    return sent_bytes;
+    return (std::size_t)sent_bytes;
+  }
+
+  if (const auto error_code = socket_last_error(); is_time_out_error(error_code))
+    return std::unexpected(std::make_error_code(std::errc::timed_out));
+  else
+    return std::unexpected(std::error_code(error_code, std::system_category()));
+}
+
+auto v4_socket_recv_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  /* no recvmmsg on WinSock, block for the first datagram and take the rest only while more are pending */
+  const auto count = std::min(buffers.size(), addresses.size());
+  if (count < 1u)
+    return 0u;
+  if (const auto result = v4_socket_recv(std::nothrow, socket, buffers[0], addresses[0], flags); !result)
+    return result;
+  auto received = 1u;
+  for (; received < count; ++received)
+  {
+    u_long pending{ 0 };
+    if (ioctlsocket(socket, FIONREAD, &pending) != 0 || pending < 1u)
+      break;
+    if (const auto result = v4_socket_recv(std::nothrow, socket, buffers[received], addresses[received], flags); !result)
+      return result;
+  }
+  return (std::size_t)received;
+}
+
+auto v4_socket_recv_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  /* no SO_TIMESTAMPING, IP_PKTINFO or SO_RXQ_OVFL through recv(), every datagram is reported without them */
+  const auto result = v4_socket_recv_batch(std::nothrow, socket, buffers, addresses, flags);
+  if (result)
+    std::fill_n(infos.begin(), std::min(*result, infos.size()), socket_datagram_info{});
+  return result;
+}
+
+auto v4_socket_poll(std::nothrow_t, int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  u_long pending{ 0 };
+  if (ioctlsocket(socket, FIONREAD, &pending) != 0)
+    return std::unexpected(std::error_code(socket_last_error(), std::system_category()));
+  if (pending < 1u)
+    return std::unexpected(std::make_error_code(std::errc::operation_would_block));
+  return v4_socket_recv(std::nothrow, socket, buffer, address, flags);
+}
+
+auto v4_socket_poll_batch(std::nothrow_t, int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::span<socket_datagram_info> infos, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  u_long pending{ 0 };
+  if (ioctlsocket(socket, FIONREAD, &pending) != 0)
+    return std::unexpected(std::error_code(socket_last_error(), std::system_category()));
+  if (pending < 1u)
+    return 0u;
+  return v4_socket_recv_batch(std::nothrow, socket, buffers, addresses, infos, flags);
+}
+
+auto v4_socket_send_batch(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> addresses, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  const auto count = std::min(buffers.size(), addresses.size());
+  for (auto i = 0u; i < count; ++i)
+  {
+    auto buffer = buffers[i];
+    if (const auto result = v4_socket_send(std::nothrow, socket, buffer, addresses[i], flags); !result)
+      return result;
   }
+  return count;
+}
+
+auto v4_socket_send_batch(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> addresses, std::span<const socket_local>, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  /* the routing table picks the source, v4_socket_pktinfo_enable() never succeeds here */
+  return v4_socket_send_batch(std::nothrow, socket, buffers, addresses, flags);
+}
+
+void v4_socket_throw(std::error_code const& error, std::string_view timed_out, std::string_view failed)
+{
+  using namespace std::string_literals;
+  if (error == std::errc::timed_out)
+    throw error_socket_timed_out(timed_out);
+  if (error == std::errc::address_family_not_supported)
+    throw std::runtime_error("packet sender address size mismatch."s);
+  throw std::runtime_error(std::string(failed) + ", error code : "s + last_error_as_string(error.value()));
+}
+
+auto v4_socket_recv(int_socket_type socket, std::span<std::byte>& buffer, address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_recv(std::nothrow, socket, buffer, address, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "receive operation timed out.", "failed to receive bytes from socket");
+}
+
+auto v4_socket_send(int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_send(std::nothrow, socket, buffer, address, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "send operation timed out.", "failed to send bytes trough socket");
+}
+
+auto v4_socket_recv_batch(int_socket_type socket, std::span<std::span<std::byte>> buffers, std::span<address_v4> addresses, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_recv_batch(std::nothrow, socket, buffers, addresses, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "receive operation timed out.", "failed to receive bytes from socket");
+}
+
+auto v4_socket_send_batch(int_socket_type socket, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> addresses, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_send_batch(std::nothrow, socket, buffers, addresses, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "send operation timed out.", "failed to send bytes trough socket");
+}
+
+/* sockets stay blocking on Windows, a full send buffer still waits in the kernel for the socket's send timeout */
+auto v4_socket_try_send(std::nothrow_t, int_socket_type socket, std::span<const std::byte>& buffer, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return v4_socket_send(std::nothrow, socket, buffer, address, flags);
+}
+
+auto v4_socket_try_send_gather(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  using namespace std::string_literals;
+  /* same limit as the POSIX backend */
+  static constexpr const std::size_t max_socket_gather = 256u;
+  if (pieces.size() > max_socket_gather)
+    throw std::invalid_argument("too many pieces for a single datagram."s);
+
+  std::array<WSABUF, max_socket_gather> buffers;
+  for (auto i = 0u; i < pieces.size(); ++i)
+    buffers[i] = WSABUF{ .len = (ULONG)pieces[i].size(), .buf = (CHAR*)pieces[i].data() };
+  const auto addr_in = address.as<sockaddr_in>();
+
+  v4_initialize();
+
+  DWORD sent_bytes{ 0 };
+  if (WSASendTo(socket, buffers.data(), (DWORD)pieces.size(), &sent_bytes, (DWORD)flags, (const sockaddr*)&addr_in, sizeof(addr_in), nullptr, nullptr) == 0)
+    return sent_bytes;
 
   if (const auto error_code = socket_last_error(); is_time_out_error(error_code))
-    throw error_socket_timed_out("send operation timed out.");
+    return std::unexpected(std::make_error_code(std::errc::timed_out));
+  else
+    return std::unexpected(std::error_code(error_code, std::system_category()));
+}
+
+auto v4_socket_try_send_zerocopy(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  return v4_socket_try_send_gather(std::nothrow, socket, pieces, address, flags);
+}
+
+auto v4_socket_send_gather(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  if (const auto result = v4_socket_try_send_gather(std::nothrow, socket, pieces, address, flags); result)
+    return *result;
+  else
+    v4_socket_throw(result.error(), "send operation timed out.", "failed to send bytes trough socket");
+}
+
+auto v4_socket_send_segmented(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  using namespace std::string_literals;
+  if (segment_size < 1u)
+    throw std::invalid_argument("invalid segment size."s);
+
+  /* no UDP GSO on WinSock, one datagram per segment */
+  std::size_t total{ 0u };
+  for (auto&& piece : pieces)
+    total += piece.size();
+  const auto datagrams = (total + segment_size - 1u) / segment_size;
+
+  std::array<std::span<const std::byte>, 16u> slice;
+  std::size_t offset{ 0u };
+  for (auto i = 0u; i < datagrams; ++i)
+  {
+    const auto used = take_gather(pieces, offset, segment_size, slice);
+    v4_socket_send_gather(socket, std::span(slice).first(used), address, flags);
+  }
+  return datagrams;
+}
+
+auto v4_socket_try_send_segmented(std::nothrow_t, int_socket_type socket, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& address, std::uint32_t flags) -> socket_result<std::size_t>
+{
+  using namespace std::string_literals;
+  if (segment_size < 1u)
+    throw std::invalid_argument("invalid segment size."s);
+
+  /* no UDP GSO on WinSock, one datagram per segment until the socket takes no more */
+  std::array<std::span<const std::byte>, 16u> slice;
+  std::size_t offset{ 0u };
+  std::size_t sent{ 0u };
+  while (!pieces.empty())
+  {
+    const auto used = take_gather(pieces, offset, segment_size, slice);
+    if (const auto result = v4_socket_try_send_gather(std::nothrow, socket, std::span(slice).first(used), address, flags); !result)
+    {
+      if (sent > 0u && result.error() == std::errc::operation_would_block)
+        break;
+      return std::unexpected(result.error());
+    }
+    ++sent;
+  }
+  return sent;
+}
 
-  throw std::runtime_error("failed to send bytes trough socket, error code : "s + 
-                           last_error_as_string());
+auto v4_socket_send_zerocopy(int_socket_type socket, std::span<const std::span<const std::byte>> pieces, const address_v4& address, std::uint32_t flags) -> std::size_t
+{
+  /* no MSG_ZEROCOPY on WinSock, v4_socket_zerocopy_enable never succeeds */
+  return v4_socket_send_gather(socket, pieces, address, flags);
+}
+
+auto v4_socket_zerocopy_enable(int_socket_type socket) -> bool
+{
+  return false;
+}
+
+auto v4_socket_zerocopy_reap(int_socket_type socket) -> socket_zerocopy_status
+{
+  return {};
+}
+
+auto v4_socket_timestamping_enable(int_socket_type socket) -> bool
+{
+  return false;
+}
+
+auto v4_socket_timestamping_reap(int_socket_type socket, std::span<socket_timestamp> timestamps) -> std::size_t
+{
+  return 0u;
+}
+
+auto v4_socket_pktinfo_enable(int_socket_type socket) -> bool
+{
+  /* IP_PKTINFO needs WSARecvMsg/WSASendMsg, not wired up, callers serve with the bound address */
+  return false;
+}
+
+auto v4_socket_multicast_enable(int_socket_type socket, const address_v4& interface_address, std::uint8_t ttl) -> bool
+{
+  IN_ADDR interface_v{};
+  interface_v.s_addr = interface_address.net_addr();
+  const DWORD ttl_v{ ttl };
+  return setsockopt((SOCKET)socket, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&interface_v, sizeof(interface_v)) == 0
+      && setsockopt((SOCKET)socket, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&ttl_v, sizeof(ttl_v)) == 0;
+}
+
+auto v4_interface_index(std::string_view name) -> std::uint32_t
+{
+  return if_nametoindex(std::string{ name }.c_str());
+}
+
+auto v4_socket_attach_filter(int_socket_type socket, std::span<const socket_filter_instruction> program) -> bool
+{
+  /* no socket filters on WinSock, everything reaches userspace */
+  return false;
+}
+
+auto v4_socket_drop_count(int_socket_type socket) -> std::optional<std::uint64_t>
+{
+  return std::nullopt;
 }
 
 static auto to_hex(std::uint8_t value) -> std::string
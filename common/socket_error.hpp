@@ -1,6 +1,8 @@
 #pragma once
 
 #include <exception>
+#include <string>
+#include <string_view>
 
 template <auto... Args>
 struct socket_error_base: std::exception
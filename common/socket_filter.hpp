@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+ * Classic BPF, just enough to generate socket filters. The instruction has
+ * the layout of Linux' struct sock_filter, opcodes are spelled out here so
+ * programs can be built on platforms without <linux/filter.h>.
+ *
+ * A filter attached to a UDP socket sees the datagram starting with the
+ * UDP header, the payload begins at offset 8. Loads past the end of the
+ * datagram drop it.
+ */
+struct socket_filter_instruction
+{
+	std::uint16_t code;
+	std::uint8_t	jt;
+	std::uint8_t	jf;
+	std::uint32_t k;
+};
+
+using socket_filter_program = std::vector<socket_filter_instruction>;
+
+namespace socket_filter
+{
+	static inline constexpr const std::uint16_t load_byte		= 0x30u;	/* BPF_LD  | BPF_B | BPF_ABS */
+	static inline constexpr const std::uint16_t load_half		= 0x28u;	/* BPF_LD  | BPF_H | BPF_ABS */
+	static inline constexpr const std::uint16_t load_word		= 0x20u;	/* BPF_LD  | BPF_W | BPF_ABS */
+	static inline constexpr const std::uint16_t jump_equal	= 0x15u;	/* BPF_JMP | BPF_JEQ | BPF_K */
+	static inline constexpr const std::uint16_t ret					= 0x06u;	/* BPF_RET | BPF_K */
+
+	static inline constexpr const std::uint32_t accept			= 0xffffffffu;
+	static inline constexpr const std::uint32_t drop				= 0u;
+
+	inline constexpr auto statement(std::uint16_t code, std::uint32_t k) -> socket_filter_instruction
+	{
+		return { code, 0u, 0u, k };
+	}
+
+	/* jt/jf count instructions to skip after this one */
+	inline constexpr auto jump(std::uint16_t code, std::uint32_t k, std::uint8_t jt, std::uint8_t jf) -> socket_filter_instruction
+	{
+		return { code, jt, jf, k };
+	}
+}
@@ -49,6 +49,14 @@ DEFINE_SOCKET_OPTION(acceptconn,					so_bool)
 DEFINE_SOCKET_OPTION(rcvlowat,						int32_t)
 DEFINE_SOCKET_OPTION(sndlowat,						int32_t)
 DEFINE_SOCKET_OPTION(type,								so_sock_type)
+DEFINE_SOCKET_OPTION(reuseport,						so_bool)
+DEFINE_SOCKET_OPTION(incoming_cpu,				int32_t)
+DEFINE_SOCKET_OPTION(rcvbufforce,					int32_t)
+DEFINE_SOCKET_OPTION(sndbufforce,					int32_t)
+DEFINE_SOCKET_OPTION(rxq_ovfl,						so_bool)
+DEFINE_SOCKET_OPTION(busy_poll,						int32_t)
+DEFINE_SOCKET_OPTION(prefer_busy_poll,		so_bool)
+DEFINE_SOCKET_OPTION(max_pacing_rate,			uint64_t)
 
 #undef DEFINE_SOCKET_OPTION
 
@@ -0,0 +1,39 @@
+#include "socket_option.hpp"
+
+#include <sys/socket.h>
+
+#define DEFINE_SOCKET_OPTION(L, name, O)  \
+	int so_##name ::level  () { return L; } \
+	int so_##name ::option () { return O; }
+
+/* WinSock only options, setting or getting them fails with ENOPROTOOPT */
+static inline constexpr const int SO_UNSUPPORTED = -1;
+
+DEFINE_SOCKET_OPTION(SOL_SOCKET, broadcast,						SO_BROADCAST)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, conditional_accept,	SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, debug,								SO_DEBUG)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, dontlinger,					SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, dontroute,						SO_DONTROUTE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, error,								SO_ERROR)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, group_priority,			SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, keepalive,						SO_KEEPALIVE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, linger,							SO_LINGER)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, oobinline,						SO_OOBINLINE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rcvbuf,							SO_RCVBUF)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, reuseaddr,						SO_REUSEADDR)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, exclusiveaddruse,		SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rcvtimeo,						SO_RCVTIMEO)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, sndbuf,							SO_SNDBUF)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, sndtimeo,						SO_SNDTIMEO)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, acceptconn,					SO_ACCEPTCONN)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rcvlowat,						SO_RCVLOWAT)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, sndlowat,						SO_SNDLOWAT)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, type,								SO_TYPE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, reuseport,						SO_REUSEPORT)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, incoming_cpu,				SO_INCOMING_CPU)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rcvbufforce,					SO_RCVBUFFORCE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, sndbufforce,					SO_SNDBUFFORCE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rxq_ovfl,						SO_RXQ_OVFL)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, busy_poll,						SO_BUSY_POLL)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, prefer_busy_poll,		SO_PREFER_BUSY_POLL)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, max_pacing_rate,			SO_MAX_PACING_RATE)
@@ -7,6 +7,8 @@
 	int so_##name ::level  () { return L; } \
 	int so_##name ::option () { return O; }
 
+/* POSIX only options, setting or getting them fails with WSAENOPROTOOPT */
+static inline constexpr const int SO_UNSUPPORTED = -1;
 
 DEFINE_SOCKET_OPTION(SOL_SOCKET, broadcast,						SO_BROADCAST)
 DEFINE_SOCKET_OPTION(SOL_SOCKET, conditional_accept,	SO_CONDITIONAL_ACCEPT)
@@ -28,4 +30,12 @@ DEFINE_SOCKET_OPTION(SOL_SOCKET, acceptconn,					SO_ACCEPTCONN)
 DEFINE_SOCKET_OPTION(SOL_SOCKET, rcvlowat,						SO_RCVLOWAT)
 DEFINE_SOCKET_OPTION(SOL_SOCKET, sndlowat,						SO_SNDLOWAT)
 DEFINE_SOCKET_OPTION(SOL_SOCKET, type,								SO_TYPE)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, reuseport,						SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, incoming_cpu,				SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rcvbufforce,					SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, sndbufforce,					SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, rxq_ovfl,						SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, busy_poll,						SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, prefer_busy_poll,		SO_UNSUPPORTED)
+DEFINE_SOCKET_OPTION(SOL_SOCKET, max_pacing_rate,			SO_UNSUPPORTED)
 
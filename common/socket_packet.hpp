@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "socket_api.hpp"
+#include "udp_frame.hpp"
+
+/*
+ * Transmit-only link layer socket (AF_PACKET) bound to a single interface,
+ * every frame handed to it carries its own Ethernet header, see make_udp_frame().
+ * Needs CAP_NET_RAW, not available on Windows, check is_supported().
+ */
+struct socket_packet
+{
+	static auto is_supported() -> bool;
+
+	socket_packet() noexcept;
+	socket_packet(std::string_view interface_name);
+	socket_packet(socket_packet&& other) noexcept;
+	socket_packet& operator = (socket_packet&& other) noexcept;
+	socket_packet(socket_packet const&) = delete;
+	socket_packet& operator = (socket_packet const&) = delete;
+ ~socket_packet();
+
+	void swap(socket_packet& other) noexcept;
+
+	auto interface_name() const noexcept -> std::string const&;
+	auto interface_index() const noexcept -> std::uint32_t;
+	auto hardware_address() const noexcept -> hardware_address_type const&;
+
+	/* sends every frame, returns the number of frames sent */
+	auto send_batch(std::span<const std::span<const std::byte>> frames) const -> std::size_t;
+
+	explicit operator bool () const noexcept;
+
+private:
+	int_socket_type				m_sock;
+	std::string						m_interface;
+	std::uint32_t					m_index{ 0u };
+	hardware_address_type	m_hardware_address{};
+};
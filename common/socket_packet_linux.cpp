@@ -0,0 +1,150 @@
+#include <stdexcept>
+#include <system_error>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <cstring>
+#include <format>
+
+#include "socket_packet.hpp"
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <unistd.h>
+#include <cerrno>
+
+/* frames handed to a single sendmmsg call */
+static inline constexpr const std::size_t max_packet_batch = 64u;
+
+static auto errno_as_string(int error = errno) -> std::string
+{
+	return std::format("{} (#{})", std::generic_category().message(error), error);
+}
+
+auto socket_packet::is_supported() -> bool
+{
+	return true;
+}
+
+socket_packet::socket_packet() noexcept
+:	m_sock{ v4_socket_make_invalid() }
+{}
+
+socket_packet::socket_packet(std::string_view interface_name)
+:	m_sock{ v4_socket_make_invalid() },
+	m_interface{ interface_name }
+{
+	const auto index = if_nametoindex(m_interface.c_str());
+	m_index = index;
+	if (index == 0u)
+		throw std::runtime_error(std::format("unknown network interface '{}', error : {}", m_interface, errno_as_string()));
+
+	/* protocol 0, nothing is ever received on this socket */
+	const auto sock = ::socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		throw std::runtime_error(std::format("failed to create packet socket, error : {}", errno_as_string()));
+	m_sock = sock;
+
+	ifreq request{};
+	std::strncpy(request.ifr_name, m_interface.c_str(), IFNAMSIZ - 1u);
+	if (ioctl(sock, SIOCGIFHWADDR, &request) != 0)
+	{
+		const auto error = errno;
+		::close(sock);
+		m_sock = v4_socket_make_invalid();
+		throw std::runtime_error(std::format("failed to get the hardware address of '{}', error : {}", m_interface, errno_as_string(error)));
+	}
+	std::memcpy(m_hardware_address.data(), request.ifr_hwaddr.sa_data, m_hardware_address.size());
+
+	sockaddr_ll address{};
+	address.sll_family = AF_PACKET;
+	address.sll_ifindex = (int)index;
+	address.sll_protocol = 0;
+	if (::bind(sock, (sockaddr const*)&address, sizeof(address)) != 0)
+	{
+		const auto error = errno;
+		::close(sock);
+		m_sock = v4_socket_make_invalid();
+		throw std::runtime_error(std::format("failed to bind packet socket to '{}', error : {}", m_interface, errno_as_string(error)));
+	}
+}
+
+socket_packet::socket_packet(socket_packet&& other) noexcept
+:	socket_packet()
+{
+	swap(other);
+}
+
+auto socket_packet::operator = (socket_packet&& other) noexcept -> socket_packet&
+{
+	socket_packet tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+socket_packet::~socket_packet()
+{
+	if (m_sock != v4_socket_make_invalid())
+		::close((int)m_sock);
+}
+
+void socket_packet::swap(socket_packet& other) noexcept
+{
+	std::swap(m_sock, other.m_sock);
+	std::swap(m_interface, other.m_interface);
+	std::swap(m_index, other.m_index);
+	std::swap(m_hardware_address, other.m_hardware_address);
+}
+
+auto socket_packet::interface_name() const noexcept -> std::string const&
+{
+	return m_interface;
+}
+
+auto socket_packet::interface_index() const noexcept -> std::uint32_t
+{
+	return m_index;
+}
+
+auto socket_packet::hardware_address() const noexcept -> hardware_address_type const&
+{
+	return m_hardware_address;
+}
+
+auto socket_packet::send_batch(std::span<const std::span<const std::byte>> frames) const -> std::size_t
+{
+	std::array<mmsghdr, max_packet_batch> headers;
+	std::array<iovec, max_packet_batch> vectors;
+
+	std::size_t sent_total{ 0u };
+	while (sent_total < frames.size())
+	{
+		const auto chunk = std::min(frames.size() - sent_total, max_packet_batch);
+		for (auto i = 0u; i < chunk; ++i)
+		{
+			const auto& frame = frames[sent_total + i];
+			vectors[i] = iovec{ .iov_base = (void*)frame.data(), .iov_len = frame.size() };
+			headers[i] = mmsghdr{};
+			headers[i].msg_hdr.msg_iov = &vectors[i];
+			headers[i].msg_hdr.msg_iovlen = 1u;
+		}
+		const auto sent = sendmmsg((int)m_sock, headers.data(), (unsigned)chunk, MSG_NOSIGNAL);
+		if (sent > 0)
+		{
+			sent_total += (std::size_t)sent;
+			continue;
+		}
+		if (sent < 0 && errno == EINTR)
+			continue;
+		throw std::runtime_error(std::format("failed to send frames on '{}', error : {}", m_interface, errno_as_string()));
+	}
+	return sent_total;
+}
+
+socket_packet::operator bool () const noexcept
+{
+	return m_sock != v4_socket_make_invalid();
+}
@@ -0,0 +1,70 @@
+#include <stdexcept>
+#include <utility>
+
+#include "socket_packet.hpp"
+
+/* no packet sockets on Windows, callers check is_supported() and keep broadcasting */
+
+auto socket_packet::is_supported() -> bool
+{
+	return false;
+}
+
+socket_packet::socket_packet() noexcept
+:	m_sock{ v4_socket_make_invalid() }
+{}
+
+socket_packet::socket_packet(std::string_view)
+:	m_sock{ v4_socket_make_invalid() }
+{
+	throw std::logic_error("packet sockets are not available on this platform.");
+}
+
+socket_packet::socket_packet(socket_packet&& other) noexcept
+:	socket_packet()
+{
+	swap(other);
+}
+
+auto socket_packet::operator = (socket_packet&& other) noexcept -> socket_packet&
+{
+	socket_packet tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+socket_packet::~socket_packet()
+{}
+
+void socket_packet::swap(socket_packet& other) noexcept
+{
+	std::swap(m_sock, other.m_sock);
+	std::swap(m_interface, other.m_interface);
+	std::swap(m_index, other.m_index);
+	std::swap(m_hardware_address, other.m_hardware_address);
+}
+
+auto socket_packet::interface_name() const noexcept -> std::string const&
+{
+	return m_interface;
+}
+
+auto socket_packet::interface_index() const noexcept -> std::uint32_t
+{
+	return m_index;
+}
+
+auto socket_packet::hardware_address() const noexcept -> hardware_address_type const&
+{
+	return m_hardware_address;
+}
+
+auto socket_packet::send_batch(std::span<const std::span<const std::byte>>) const -> std::size_t
+{
+	throw std::logic_error("packet sockets are not available on this platform.");
+}
+
+socket_packet::operator bool () const noexcept
+{
+	return false;
+}
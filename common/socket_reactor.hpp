@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <functional>
+#include <stop_token>
+#include <span>
+#include <vector>
+#include <utility>
+
+#include "socket_api.hpp"
+
+/*
+ * Readiness reactor, one per worker thread.
+ *
+ * On POSIX sockets are non-blocking, v4_socket_recv/v4_socket_send park the
+ * calling thread in its reactor (epoll) until the socket is ready, the socket
+ * timeout expires or the reactor is interrupted. A stop request can therefore
+ * wake a receiver immediately, no timeout polling required.
+ *
+ * A thread that serves many sockets at once owns a reactor of its own and
+ * keeps them on its watch list instead, see watch() and wait_ready().
+ *
+ * On Windows sockets stay blocking and the reactor can not be interrupted,
+ * only the watch list is available there (WSAPoll).
+ */
+struct socket_reactor
+{
+	enum readiness_type: std::uint32_t
+	{
+		readiness_read	= 0x01u,
+		readiness_write	= 0x02u
+	};
+
+	using interrupt_type = std::stop_callback<std::function<void()>>;
+
+#if defined(_WIN32)
+	static inline constexpr const bool can_interrupt = false;
+#else
+	static inline constexpr const bool can_interrupt = true;
+#endif
+
+	static auto this_thread() -> socket_reactor&;
+
+	socket_reactor();
+	socket_reactor(const socket_reactor&) = delete;
+	socket_reactor& operator = (const socket_reactor&) = delete;
+ ~socket_reactor();
+
+	/* zero timeout waits indefinitely, returns false on timeout or interrupt */
+	auto wait(int_socket_type socket, readiness_type what, std::chrono::milliseconds timeout) -> bool;
+
+	/* wakes up the thread waiting in this reactor, thread safe */
+	void interrupt();
+
+	/* interrupt this reactor when stop is requested, keep the result alive while waiting */
+	auto interrupt_on(std::stop_token const& st) -> interrupt_type;
+
+	/* level triggered, the socket stays watched until unwatch() or until it is closed, don't mix with wait() on the same reactor */
+	void watch(int_socket_type socket, readiness_type what);
+	void unwatch(int_socket_type socket);
+
+	/* waits for any watched socket, zero timeout waits indefinitely, returns how many ready sockets were written
+	   to `ready`, 0 on timeout or interrupt; errors count as ready, so the owner gets to drain them */
+	auto wait_ready(std::span<int_socket_type> ready, std::chrono::milliseconds timeout) -> std::size_t;
+
+private:
+	auto arm(int_socket_type socket, std::uint32_t events) -> void;
+
+	int_socket_type m_poll;
+	int_socket_type m_wake;
+	std::vector<std::pair<int_socket_type, std::uint32_t>> m_watched;	/* WSAPoll only, epoll keeps its own list */
+};
@@ -0,0 +1,162 @@
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <iostream>
+#include <array>
+#include <algorithm>
+
+#include "socket_reactor.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+static auto error_as_string(int error_code = errno) -> std::string
+{
+	return std::generic_category().message(error_code);
+}
+
+auto socket_reactor::this_thread() -> socket_reactor&
+{
+	thread_local socket_reactor reactor;
+	return reactor;
+}
+
+socket_reactor::socket_reactor()
+:	m_poll{ epoll_create1(EPOLL_CLOEXEC) },
+	m_wake{ eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) }
+{
+	using namespace std::string_literals;
+	if (m_poll < 0 || m_wake < 0)
+	{
+		const auto error_code = errno;
+		if (m_poll >= 0) ::close((int)m_poll);
+		if (m_wake >= 0) ::close((int)m_wake);
+		throw std::runtime_error("failed to create socket reactor, error : "s + error_as_string(error_code));
+	}
+	epoll_event ev{ .events = EPOLLIN, .data = { .fd = (int)m_wake } };
+	if (epoll_ctl((int)m_poll, EPOLL_CTL_ADD, (int)m_wake, &ev) != 0)
+	{
+		const auto error_code = errno;
+		::close((int)m_poll);
+		::close((int)m_wake);
+		throw std::runtime_error("failed to register reactor wake up event, error : "s + error_as_string(error_code));
+	}
+}
+
+socket_reactor::~socket_reactor()
+{
+	::close((int)m_wake);
+	::close((int)m_poll);
+}
+
+auto socket_reactor::arm(int_socket_type socket, std::uint32_t events) -> void
+{
+	using namespace std::string_literals;
+
+	/* one-shot, so a ready socket nobody waits for can't keep waking the reactor up,
+	   descriptors also leave the epoll set when closed and their numbers get reused */
+	epoll_event ev{ .events = events | EPOLLONESHOT, .data = { .fd = (int)socket } };
+	auto result = epoll_ctl((int)m_poll, EPOLL_CTL_MOD, (int)socket, &ev);
+	if (result != 0 && errno == ENOENT)
+		result = epoll_ctl((int)m_poll, EPOLL_CTL_ADD, (int)socket, &ev);
+	if (result != 0)
+		throw std::runtime_error("failed to watch socket, error : "s + error_as_string());
+}
+
+auto socket_reactor::wait(int_socket_type socket, readiness_type what, std::chrono::milliseconds timeout) -> bool
+{
+	using namespace std::string_literals;
+	using namespace std::chrono;
+
+	arm(socket, (what & readiness_read ? EPOLLIN : 0u) | (what & readiness_write ? EPOLLOUT : 0u));
+
+	const auto deadline = steady_clock::now() + timeout;
+	std::array<epoll_event, 2u> events;
+	while (true)
+	{
+		int timeout_ms = -1;
+		if (timeout.count() > 0)
+			timeout_ms = (int)std::max<std::int64_t>(0, duration_cast<milliseconds>(deadline - steady_clock::now()).count());
+
+		const auto count = epoll_wait((int)m_poll, events.data(), (int)events.size(), timeout_ms);
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0)
+			throw std::runtime_error("failed to wait for socket, error : "s + error_as_string());
+		if (count == 0)
+			return false;
+
+		bool is_ready = false;
+		for (auto i = 0; i < count; ++i)
+		{
+			if (events[i].data.fd == (int)m_wake)
+			{
+				std::uint64_t value;
+				[[maybe_unused]] auto _ = ::read((int)m_wake, &value, sizeof(value));
+				return false;
+			}
+			if (events[i].data.fd == (int)socket)
+				is_ready = true;
+		}
+		if (is_ready)
+			return true;
+	}
+}
+
+void socket_reactor::watch(int_socket_type socket, readiness_type what)
+{
+	using namespace std::string_literals;
+	epoll_event ev{ .events = (what & readiness_read ? EPOLLIN : 0u) | (what & readiness_write ? EPOLLOUT : 0u), .data = { .fd = (int)socket } };
+	auto result = epoll_ctl((int)m_poll, EPOLL_CTL_ADD, (int)socket, &ev);
+	if (result != 0 && errno == EEXIST)
+		result = epoll_ctl((int)m_poll, EPOLL_CTL_MOD, (int)socket, &ev);
+	if (result != 0)
+		throw std::runtime_error("failed to watch socket, error : "s + error_as_string());
+}
+
+void socket_reactor::unwatch(int_socket_type socket)
+{
+	epoll_ctl((int)m_poll, EPOLL_CTL_DEL, (int)socket, nullptr);
+}
+
+auto socket_reactor::wait_ready(std::span<int_socket_type> ready, std::chrono::milliseconds timeout) -> std::size_t
+{
+	using namespace std::string_literals;
+
+	static constexpr const std::size_t max_events = 256u;
+	std::array<epoll_event, max_events> events;
+	const auto capacity = (int)std::min(ready.size(), max_events);
+	const auto timeout_ms = timeout.count() > 0 ? (int)timeout.count() : -1;
+
+	const auto count = epoll_wait((int)m_poll, events.data(), capacity, timeout_ms);
+	if (count < 0 && errno == EINTR)
+		return 0u;
+	if (count < 0)
+		throw std::runtime_error("failed to wait for sockets, error : "s + error_as_string());
+
+	std::size_t ready_count = 0u;
+	for (auto i = 0; i < count; ++i)
+	{
+		if (events[i].data.fd == (int)m_wake)
+		{
+			std::uint64_t value;
+			[[maybe_unused]] auto _ = ::read((int)m_wake, &value, sizeof(value));
+			continue;
+		}
+		ready[ready_count++] = events[i].data.fd;
+	}
+	return ready_count;
+}
+
+void socket_reactor::interrupt()
+{
+	const std::uint64_t value{ 1u };
+	[[maybe_unused]] auto _ = ::write((int)m_wake, &value, sizeof(value));
+}
+
+auto socket_reactor::interrupt_on(std::stop_token const& st) -> interrupt_type
+{
+	return interrupt_type(st, [this] () { interrupt(); });
+}
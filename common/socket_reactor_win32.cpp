@@ -0,0 +1,80 @@
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include "socket_reactor.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <WinSock2.h>
+#include <Windows.h>
+
+/* WinSock sockets stay blocking, timeouts are handled by SO_RCVTIMEO/SO_SNDTIMEO */
+
+auto socket_reactor::this_thread() -> socket_reactor&
+{
+	thread_local socket_reactor reactor;
+	return reactor;
+}
+
+socket_reactor::socket_reactor()
+:	m_poll{ v4_socket_make_invalid() },
+	m_wake{ v4_socket_make_invalid() }
+{}
+
+socket_reactor::~socket_reactor()
+{}
+
+auto socket_reactor::arm(int_socket_type, std::uint32_t) -> void
+{}
+
+auto socket_reactor::wait(int_socket_type, readiness_type, std::chrono::milliseconds) -> bool
+{
+	throw std::logic_error("socket reactor is not available on this platform.");
+}
+
+void socket_reactor::watch(int_socket_type socket, readiness_type what)
+{
+	const auto it = std::ranges::find(m_watched, socket, &std::pair<int_socket_type, std::uint32_t>::first);
+	if (it != m_watched.end())
+		it->second = what;
+	else
+		m_watched.emplace_back(socket, what);
+}
+
+void socket_reactor::unwatch(int_socket_type socket)
+{
+	std::erase_if(m_watched, [socket] (auto const& entry) { return entry.first == socket; });
+}
+
+/* nothing to interrupt WSAPoll with, callers keep the timeout short instead */
+auto socket_reactor::wait_ready(std::span<int_socket_type> ready, std::chrono::milliseconds timeout) -> std::size_t
+{
+	using namespace std::string_literals;
+	std::vector<WSAPOLLFD> polled;
+	polled.reserve(m_watched.size());
+	for (auto&& [socket, what] : m_watched)
+		polled.push_back(WSAPOLLFD{ .fd = (SOCKET)socket, .events = (SHORT)((what & readiness_read ? POLLRDNORM : 0) | (what & readiness_write ? POLLWRNORM : 0)) });
+	if (polled.empty())
+	{
+		Sleep((DWORD)(timeout.count() > 0 ? timeout.count() : INFINITE));
+		return 0u;
+	}
+	const auto count = WSAPoll(polled.data(), (ULONG)polled.size(), timeout.count() > 0 ? (INT)timeout.count() : -1);
+	if (count == SOCKET_ERROR)
+		throw std::runtime_error("failed to wait for sockets, error : "s + std::to_string(WSAGetLastError()));
+	std::size_t ready_count = 0u;
+	for (auto&& entry : polled)
+		if (entry.revents != 0 && ready_count < ready.size())
+			ready[ready_count++] = (int_socket_type)entry.fd;
+	return ready_count;
+}
+
+void socket_reactor::interrupt()
+{}
+
+auto socket_reactor::interrupt_on(std::stop_token const& st) -> interrupt_type
+{
+	return interrupt_type(st, [] () {});
+}
@@ -5,6 +5,8 @@
 
 #include <vector>
 #include <array>
+#include <algorithm>
+#include <stdexcept>
 
 using std::exchange;
 
@@ -20,6 +22,11 @@ socket_udp::socket_udp(const struct address_v4& addr)
 :	socket_udp(v4_socket_make_udp(addr))
 {}
 
+auto socket_udp::make_unbound() -> socket_udp
+{
+	return socket_udp(v4_socket_make_udp());
+}
+
 socket_udp::socket_udp(socket_udp&& from)
 :	m_sock{ exchange(from.m_sock, v4_socket_make_invalid()) }
 {}
@@ -42,11 +49,76 @@ void socket_udp::swap(socket_udp& other)
 	std::swap(other.m_sock, m_sock);
 }
 
+auto socket_udp::native_handle() const noexcept -> int_socket_type
+{
+	return m_sock;
+}
+
 void socket_udp::bind(const address_v4& addr)
 {
 	v4_socket_bind(m_sock, addr);
 }
 
+auto socket_udp::recv(std::nothrow_t, std::span<std::byte>& buffer, address_v4& source, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_recv(std::nothrow, m_sock, buffer, source, flags);
+}
+
+auto socket_udp::send(std::nothrow_t, std::span<const std::byte>& buffer, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_send(std::nothrow, m_sock, buffer, target, flags);
+}
+
+auto socket_udp::recv_batch(std::nothrow_t, std::span<std::span<std::byte>> buffers, std::span<address_v4> sources, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_recv_batch(std::nothrow, m_sock, buffers, sources, flags);
+}
+
+auto socket_udp::recv_batch(std::nothrow_t, std::span<packet_buffer> buffers, std::span<address_v4> sources, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return recv_batch(std::nothrow, buffers, sources, std::span<socket_datagram_info>{}, flags);
+}
+
+/* receives into the full capacity of each pool buffer, then trims them to the datagrams */
+template <typename F>
+static auto recv_into_pool(F&& receive, std::span<packet_buffer> buffers, std::span<address_v4> sources, std::span<socket_datagram_info> infos) -> socket_result<std::size_t>
+{
+	std::array<std::span<std::byte>, 64u> slots_s;
+	const auto count = std::min({ buffers.size(), sources.size(), slots_s.size() });
+	for (auto i = 0u; i < count; ++i)
+		slots_s[i] = buffers[i].capacity();
+	const auto received = receive(std::span{ slots_s }.first(count), sources.first(count), infos.first(std::min(count, infos.size())));
+	if (!received)
+		return received;
+	for (auto i = 0u; i < *received; ++i)
+		buffers[i].resize(slots_s[i].size());
+	return received;
+}
+
+auto socket_udp::recv_batch(std::nothrow_t, std::span<packet_buffer> buffers, std::span<address_v4> sources, std::span<socket_datagram_info> infos, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return recv_into_pool([this, flags] (auto slots, auto addresses, auto infos) { 
+		return v4_socket_recv_batch(std::nothrow, m_sock, slots, addresses, infos, flags); 
+	}, buffers, sources, infos);
+}
+
+auto socket_udp::poll_batch(std::nothrow_t, std::span<packet_buffer> buffers, std::span<address_v4> sources, std::span<socket_datagram_info> infos, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return recv_into_pool([this, flags] (auto slots, auto addresses, auto infos) { 
+		return v4_socket_poll_batch(std::nothrow, m_sock, slots, addresses, infos, flags); 
+	}, buffers, sources, infos);
+}
+
+auto socket_udp::send_batch(std::nothrow_t, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> targets, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_send_batch(std::nothrow, m_sock, buffers, targets, flags);
+}
+
+auto socket_udp::send_batch(std::nothrow_t, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> targets, std::span<const socket_local> sources, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_send_batch(std::nothrow, m_sock, buffers, targets, sources, flags);
+}
+
 auto socket_udp::recv(std::span<std::byte>& buffer, address_v4& source, uint32_t flags) const -> std::size_t
 {
 	return v4_socket_recv(m_sock, buffer, source, flags);
@@ -57,15 +129,174 @@ auto socket_udp::send(std::span<const std::byte>& buffer, const address_v4& targ
 	return v4_socket_send(m_sock, buffer, target, flags);
 }
 
-auto socket_udp::recv(uint32_t flags) const -> std::tuple<address_v4, std::vector<std::byte>>
+auto socket_udp::recv_batch(std::span<std::span<std::byte>> buffers, std::span<address_v4> sources, uint32_t flags) const -> std::size_t
+{
+	return v4_socket_recv_batch(m_sock, buffers, sources, flags);
+}
+
+auto socket_udp::recv_batch(std::span<packet_buffer> buffers, std::span<address_v4> sources, uint32_t flags) const -> std::size_t
+{
+	if (const auto received = recv_batch(std::nothrow, buffers, sources, flags); received)
+		return *received;
+	else
+		v4_socket_throw(received.error(), "receive operation timed out.", "failed to receive bytes from socket");
+}
+
+auto socket_udp::send_batch(std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> targets, uint32_t flags) const -> std::size_t
+{
+	return v4_socket_send_batch(m_sock, buffers, targets, flags);
+}
+
+auto socket_udp::send_gather(std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> std::size_t
+{
+	return v4_socket_send_gather(m_sock, pieces, target, flags);
+}
+
+auto socket_udp::send_segmented(std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& target, uint32_t flags) const -> std::size_t
+{
+	return v4_socket_send_segmented(m_sock, pieces, segment_size, target, flags);
+}
+
+auto socket_udp::send_zerocopy(std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> std::size_t
+{
+	return v4_socket_send_zerocopy(m_sock, pieces, target, flags);
+}
+
+auto socket_udp::zerocopy_enable() const -> bool
+{
+	return v4_socket_zerocopy_enable(m_sock);
+}
+
+auto socket_udp::zerocopy_reap() const -> socket_zerocopy_status
+{
+	return v4_socket_zerocopy_reap(m_sock);
+}
+
+auto socket_udp::timestamping_enable() const -> bool
+{
+	return v4_socket_timestamping_enable(m_sock);
+}
+
+auto socket_udp::timestamping_reap(std::span<socket_timestamp> timestamps) const -> std::size_t
+{
+	return v4_socket_timestamping_reap(m_sock, timestamps);
+}
+
+auto socket_udp::attach_filter(std::span<const socket_filter_instruction> program) const -> bool
+{
+	return v4_socket_attach_filter(m_sock, program);
+}
+
+auto socket_udp::drop_count() const -> std::optional<std::uint64_t>
+{
+	return v4_socket_drop_count(m_sock);
+}
+
+auto socket_udp::poll(std::nothrow_t, std::span<std::byte>& buffer, address_v4& source, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_poll(std::nothrow, m_sock, buffer, source, flags);
+}
+
+auto socket_udp::try_send(std::nothrow_t, std::span<const std::byte>& buffer, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_try_send(std::nothrow, m_sock, buffer, target, flags);
+}
+
+auto socket_udp::try_send_gather(std::nothrow_t, std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_try_send_gather(std::nothrow, m_sock, pieces, target, flags);
+}
+
+auto socket_udp::try_send_zerocopy(std::nothrow_t, std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_try_send_zerocopy(std::nothrow, m_sock, pieces, target, flags);
+}
+
+auto socket_udp::try_send_segmented(std::nothrow_t, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+{
+	return v4_socket_try_send_segmented(std::nothrow, m_sock, pieces, segment_size, target, flags);
+}
+
+auto socket_udp::pktinfo_enable() const -> bool
+{
+	return v4_socket_pktinfo_enable(m_sock);
+}
+
+auto socket_udp::multicast_enable(const address_v4& interface_address, std::uint8_t ttl) const -> bool
+{
+	return v4_socket_multicast_enable(m_sock, interface_address, ttl);
+}
+
+auto socket_udp::overflow_enable() const -> bool
+{
+	try
+	{ option<so_rxq_ovfl>(so_true); }
+	catch (std::exception const&)
+	{ return false; }
+	return true;
+}
+
+auto socket_udp::pacing_rate(std::uint64_t bytes_per_second) const -> bool
+{
+	try
+	{ option<so_max_pacing_rate>(bytes_per_second); }
+	catch (std::exception const&)
+	{ return false; }
+	return true;
+}
+
+auto socket_udp::receive_buffer(std::int32_t bytes) const -> std::int32_t
+{
+	if (bytes > 0)
+	{
+		option<so_rcvbuf>(bytes);
+		if (option<so_rcvbuf>() < bytes)
+		{
+			try
+			{ option<so_rcvbufforce>(bytes); }
+			catch (std::exception const&)
+			{}
+		}
+	}
+	return option<so_rcvbuf>();
+}
+
+auto socket_udp::send_buffer(std::int32_t bytes) const -> std::int32_t
+{
+	if (bytes > 0)
+	{
+		option<so_sndbuf>(bytes);
+		if (option<so_sndbuf>() < bytes)
+		{
+			try
+			{ option<so_sndbufforce>(bytes); }
+			catch (std::exception const&)
+			{}
+		}
+	}
+	return option<so_sndbuf>();
+}
+
+auto socket_udp::recv(std::nothrow_t, uint32_t flags) const -> socket_result<std::tuple<address_v4, std::vector<std::byte>>>
 {
   thread_local std::array<std::byte, 0x10000u> array_buffer;
 	std::span<std::byte> buffer_s{ array_buffer };
 	address_v4 source;
-	if ((*this).recv(buffer_s, source, flags) > 0u)
-	{
-		std::vector<std::byte> received_bytes(buffer_s.begin(), buffer_s.end());
-		return std::tuple(std::move(source), std::move(received_bytes));
-	}		
-	throw std::runtime_error("recv failed");
+	const auto received = (*this).recv(std::nothrow, buffer_s, source, flags);
+	if (!received)
+		return std::unexpected(received.error());
+	if (*received < 1u)
+		return std::unexpected(std::make_error_code(std::errc::no_message));
+	std::vector<std::byte> received_bytes(buffer_s.begin(), buffer_s.end());
+	return std::tuple(std::move(source), std::move(received_bytes));
+}
+
+auto socket_udp::recv(uint32_t flags) const -> std::tuple<address_v4, std::vector<std::byte>>
+{
+	auto received = recv(std::nothrow, flags);
+	if (!received && received.error() == std::errc::no_message)
+		throw std::runtime_error("recv failed");
+	if (!received)
+		v4_socket_throw(received.error(), "receive operation timed out.", "failed to receive bytes from socket");
+	return std::move(*received);
 }
@@ -5,9 +5,12 @@
 #include <type_traits>
 #include <concepts>
 #include <utility>
+#include <new>
 
 #include "socket_api.hpp"
+#include "socket_reactor.hpp"
 #include "serdes.hpp"
+#include "packet_pool.hpp"
 
 inline static const constexpr std::uint32_t message_out_of_bounds_flag	= 0x01u;
 inline static const constexpr std::uint32_t message_peek_flag						= 0x02u;
@@ -24,7 +27,11 @@ struct socket_udp
 	socket_udp& operator = (const socket_udp&) = delete;
  ~socket_udp();
   void swap(socket_udp& other);
+
+	/* socket that still needs bind(), for options that only take effect before binding */
+	static auto make_unbound() -> socket_udp;
 	void bind(const struct address_v4& addr);
+	auto native_handle() const noexcept -> int_socket_type;
 	
 	/* buffer will be adjusted to span only the bytes received */
 	auto recv(std::span<std::byte>& buffer, struct address_v4& source, uint32_t flags) const -> std::size_t;
@@ -33,6 +40,82 @@ struct socket_udp
 	auto send(std::span<const std::byte>& buffer, const struct address_v4& target, uint32_t flags) const -> std::size_t;
 
 	auto recv(uint32_t flags) const -> std::tuple<address_v4, std::vector<std::byte>>;
+
+	/* waits for at least one datagram, then takes as many as are queued and fit into the buffers,
+	   each buffer will be adjusted to span only the bytes received, returns the number of datagrams */
+	auto recv_batch(std::span<std::span<std::byte>> buffers, std::span<address_v4> sources, uint32_t flags) const -> std::size_t;
+
+	/* same as above, but receives straight into pool slots, every handle must hold a slot */
+	auto recv_batch(std::span<packet_buffer> buffers, std::span<address_v4> sources, uint32_t flags) const -> std::size_t;
+
+	/* sends every buffer to the matching target, returns the number of datagrams sent */
+	auto send_batch(std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> targets, uint32_t flags) const -> std::size_t;
+
+	/* sends a single datagram gathered from the pieces, without joining them in userspace */
+	auto send_gather(std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> std::size_t;
+
+	/* sends the concatenated pieces as consecutive datagrams of `segment_size` bytes (only the last one may be shorter),
+	   handed to the kernel as one UDP_SEGMENT (GSO) send where possible, returns the number of datagrams sent */
+	auto send_segmented(std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& target, uint32_t flags) const -> std::size_t;
+
+	/* same as send_gather with MSG_ZEROCOPY, the pieces must stay unchanged until zerocopy_reap() reports them */
+	auto send_zerocopy(std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> std::size_t;
+	auto zerocopy_enable() const -> bool;
+	auto zerocopy_reap() const -> socket_zerocopy_status;
+
+	/* SO_TIMESTAMPING with software receive and transmit stamps, false where the platform has none */
+	auto timestamping_enable() const -> bool;
+
+	/* transmit timestamps of earlier sends, oldest first, returns how many were written */
+	auto timestamping_reap(std::span<socket_timestamp> timestamps) const -> std::size_t;
+
+	/* classic BPF socket filter, false where the platform has none or the kernel rejected it */
+	auto attach_filter(std::span<const socket_filter_instruction> program) const -> bool;
+	auto drop_count() const -> std::optional<std::uint64_t>;
+
+	/* IP_PKTINFO, reports the ingress interface and local address of each datagram, false where the platform has none */
+	auto pktinfo_enable() const -> bool;
+
+	/* sends to multicast groups leave from `interface_address` and cross at most `ttl` routers */
+	auto multicast_enable(const struct address_v4& interface_address, std::uint8_t ttl) const -> bool;
+
+	/* SO_RXQ_OVFL, reports the kernel drop counter with each datagram, false where the platform has none */
+	auto overflow_enable() const -> bool;
+
+	/* SO_MAX_PACING_RATE, the kernel spaces the datagrams out to `bytes_per_second` (UDP needs the fq qdisc
+	   on the egress interface), all ones = no limit, false where the platform has none */
+	auto pacing_rate(std::uint64_t bytes_per_second) const -> bool;
+
+	/* SO_RCVBUF/SO_SNDBUF, past net.core.rmem_max/wmem_max with SO_RCVBUFFORCE/SO_SNDBUFFORCE when privileged,
+	   0 keeps the kernel default, returns the size the kernel settled on (Linux reports twice the payload room) */
+	auto receive_buffer(std::int32_t bytes) const -> std::int32_t;
+	auto send_buffer(std::int32_t bytes) const -> std::int32_t;
+
+	/* non-throwing flavour of the calls above for the receive/send loops, a time out is std::errc::timed_out */
+	auto recv(std::nothrow_t, std::span<std::byte>& buffer, struct address_v4& source, uint32_t flags) const -> socket_result<std::size_t>;
+	auto send(std::nothrow_t, std::span<const std::byte>& buffer, const struct address_v4& target, uint32_t flags) const -> socket_result<std::size_t>;
+	auto recv(std::nothrow_t, uint32_t flags) const -> socket_result<std::tuple<address_v4, std::vector<std::byte>>>;
+
+	/* never waits, std::errc::operation_would_block when nothing is queued, for sockets on a reactor watch list */
+	auto poll(std::nothrow_t, std::span<std::byte>& buffer, struct address_v4& source, uint32_t flags) const -> socket_result<std::size_t>;
+	/* never waits either, std::errc::operation_would_block when the send buffer is full, the caller watches for writable */
+	auto try_send(std::nothrow_t, std::span<const std::byte>& buffer, const struct address_v4& target, uint32_t flags) const -> socket_result<std::size_t>;
+	auto try_send_gather(std::nothrow_t, std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>;
+	auto try_send_zerocopy(std::nothrow_t, std::span<const std::span<const std::byte>> pieces, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>;
+	/* one GSO send of the leading `segment_size` datagrams of the pieces, as many as fit, returns how many, 0 when the route can't segment */
+	auto try_send_segmented(std::nothrow_t, std::span<const std::span<const std::byte>> pieces, std::size_t segment_size, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>;
+	auto recv_batch(std::nothrow_t, std::span<std::span<std::byte>> buffers, std::span<address_v4> sources, uint32_t flags) const -> socket_result<std::size_t>;
+	auto recv_batch(std::nothrow_t, std::span<packet_buffer> buffers, std::span<address_v4> sources, uint32_t flags) const -> socket_result<std::size_t>;
+
+	/* same as above, with the kernel receive timestamp and local address of each datagram, see timestamping_enable() and pktinfo_enable() */
+	auto recv_batch(std::nothrow_t, std::span<packet_buffer> buffers, std::span<address_v4> sources, std::span<socket_datagram_info> infos, uint32_t flags) const -> socket_result<std::size_t>;
+
+	/* same as above but never waits, returns 0 when nothing is queued, for threads that spin on the socket */
+	auto poll_batch(std::nothrow_t, std::span<packet_buffer> buffers, std::span<address_v4> sources, std::span<socket_datagram_info> infos, uint32_t flags) const -> socket_result<std::size_t>;
+	auto send_batch(std::nothrow_t, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> targets, uint32_t flags) const -> socket_result<std::size_t>;
+
+	/* same as above, each datagram leaves from the given local address and interface */
+	auto send_batch(std::nothrow_t, std::span<const std::span<const std::byte>> buffers, std::span<const address_v4> targets, std::span<const socket_local> sources, uint32_t flags) const -> socket_result<std::size_t>;
 	
 	template <typename T>
 	requires requires (T const& packet, ::serdes<serdes_writer>& s) 
@@ -47,6 +130,32 @@ struct socket_udp
 		return send(buffer_s, target, flags);
 	}
 
+	template <typename T>
+	requires requires (T const& packet, ::serdes<serdes_writer>& s) 
+	{
+		{ packet.serdes_size_hint() } -> std::convertible_to<std::size_t>;
+		{ packet.serdes(s) } -> std::convertible_to<::serdes<serdes_writer>&>;
+	}
+	auto send(std::nothrow_t, T const& packet, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+	{
+		auto buffer_v = serialize_to_vector(packet);
+		std::span<const std::byte> buffer_s { buffer_v };
+		return send(std::nothrow, buffer_s, target, flags);
+	}
+
+	template <typename T>
+	requires requires (T const& packet, ::serdes<serdes_writer>& s) 
+	{
+		{ packet.serdes_size_hint() } -> std::convertible_to<std::size_t>;
+		{ packet.serdes(s) } -> std::convertible_to<::serdes<serdes_writer>&>;
+	}
+	auto try_send(std::nothrow_t, T const& packet, const address_v4& target, uint32_t flags) const -> socket_result<std::size_t>
+	{
+		auto buffer_v = serialize_to_vector(packet);
+		std::span<const std::byte> buffer_s { buffer_v };
+		return try_send(std::nothrow, buffer_s, target, flags);
+	}
+
 	template <typename O>
 	auto option(const typename O::value_type& value) const -> void
 	{
@@ -84,6 +193,14 @@ struct socket_udp
 		option<so_sndtimeo>((std::uint32_t)to.count());		
 	}
 
+	/* timeout that only exists to poll a stop token, not needed when the reactor can be interrupted */
+	template <typename... D>
+	void timeout_idle(std::chrono::duration<D...> const& dur)
+	{
+		if constexpr (!socket_reactor::can_interrupt)
+			timeout(dur);
+	}
+
 protected:
 	socket_udp(int_socket_type int_sock);
 private:
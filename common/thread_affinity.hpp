@@ -0,0 +1,7 @@
+#pragma once
+
+/* pins the calling thread to a single CPU, returns false if the platform or scheduler refused */
+auto this_thread_pin_to(unsigned cpu) -> bool;
+
+/* number of CPUs the process may run on, at least 1 */
+auto available_cpu_count() -> unsigned;
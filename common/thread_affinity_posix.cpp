@@ -0,0 +1,24 @@
+#include <thread>
+#include <algorithm>
+
+#include "thread_affinity.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+auto this_thread_pin_to(unsigned cpu) -> bool
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+auto available_cpu_count() -> unsigned
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0)
+		return std::max(1, CPU_COUNT(&set));
+	return std::max(1u, std::thread::hardware_concurrency());
+}
@@ -0,0 +1,21 @@
+#include <thread>
+#include <algorithm>
+
+#include "thread_affinity.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+auto this_thread_pin_to(unsigned cpu) -> bool
+{
+	if (cpu >= sizeof(DWORD_PTR) * 8u)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) != 0;
+}
+
+auto available_cpu_count() -> unsigned
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
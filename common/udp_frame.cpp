@@ -0,0 +1,82 @@
+#include <stdexcept>
+#include <algorithm>
+#include <string>
+
+#include "udp_frame.hpp"
+
+static inline constexpr const std::uint16_t ethertype_ipv4 = 0x0800u;
+static inline constexpr const std::uint8_t ip_protocol_udp = 17u;
+static inline constexpr const std::uint8_t ip_default_ttl = 64u;
+
+static void put_u16(std::span<std::byte> out, std::size_t offset, std::uint16_t value)
+{
+	out[offset + 0u] = std::byte(value >> 8u);
+	out[offset + 1u] = std::byte(value & 0xffu);
+}
+
+static void put_u32(std::span<std::byte> out, std::size_t offset, std::uint32_t value)
+{
+	put_u16(out, offset + 0u, (std::uint16_t)(value >> 16u));
+	put_u16(out, offset + 2u, (std::uint16_t)(value & 0xffffu));
+}
+
+auto internet_checksum(std::span<const std::byte> bytes, std::uint32_t sum) -> std::uint16_t
+{
+	for (auto i = 0u; i + 1u < bytes.size(); i += 2u)
+		sum += ((std::uint32_t)bytes[i] << 8u) | (std::uint32_t)bytes[i + 1u];
+	if (bytes.size() & 1u)
+		sum += (std::uint32_t)bytes.back() << 8u;
+	while (sum >> 16u)
+		sum = (sum & 0xffffu) + (sum >> 16u);
+	return (std::uint16_t)~sum;
+}
+
+auto make_udp_frame(std::span<std::byte> frame,
+	hardware_address_type const& source_mac, address_v4 const& source,
+	hardware_address_type const& target_mac, address_v4 const& target,
+	std::span<const std::byte> payload) -> std::span<const std::byte>
+{
+	using namespace std::string_literals;
+	const auto udp_length = 8u + payload.size();
+	const auto ip_length = 20u + udp_length;
+	if (ip_length > 0xffffu)
+		throw std::invalid_argument("UDP payload doesn't fit into a single IPv4 packet."s);
+	if (frame.size() < udp_frame_overhead + payload.size())
+		throw std::invalid_argument("frame buffer too small for the UDP payload."s);
+
+	auto ethernet = frame.subspan(0u, 14u);
+	std::transform(target_mac.begin(), target_mac.end(), ethernet.begin(), [] (auto v) { return std::byte(v); });
+	std::transform(source_mac.begin(), source_mac.end(), ethernet.begin() + 6u, [] (auto v) { return std::byte(v); });
+	put_u16(ethernet, 12u, ethertype_ipv4);
+
+	auto ip = frame.subspan(14u, 20u);
+	ip[0] = std::byte(0x45u);						/* version 4, 5 words of header */
+	ip[1] = std::byte(0x10u);						/* low delay, as dhcpd and dnsmasq do */
+	put_u16(ip, 2u, (std::uint16_t)ip_length);
+	put_u16(ip, 4u, 0u);								/* identification, never fragmented */
+	put_u16(ip, 6u, 0x4000u);						/* don't fragment */
+	ip[8] = std::byte(ip_default_ttl);
+	ip[9] = std::byte(ip_protocol_udp);
+	put_u16(ip, 10u, 0u);
+	put_u32(ip, 12u, source.addr());
+	put_u32(ip, 16u, target.addr());
+	put_u16(ip, 10u, internet_checksum(ip));
+
+	auto udp = frame.subspan(34u, udp_length);
+	put_u16(udp, 0u, source.port());
+	put_u16(udp, 2u, target.port());
+	put_u16(udp, 4u, (std::uint16_t)udp_length);
+	put_u16(udp, 6u, 0u);
+	std::copy(payload.begin(), payload.end(), udp.begin() + 8u);
+
+	/* pseudo header: addresses, protocol and UDP length */
+	std::uint32_t pseudo = 0u;
+	pseudo += (source.addr() >> 16u) + (source.addr() & 0xffffu);
+	pseudo += (target.addr() >> 16u) + (target.addr() & 0xffffu);
+	pseudo += ip_protocol_udp + (std::uint32_t)udp_length;
+	const auto checksum = internet_checksum(udp, pseudo);
+	/* zero means "no checksum" in UDP over IPv4, all ones is the same value in ones' complement */
+	put_u16(udp, 6u, checksum ? checksum : 0xffffu);
+
+	return frame.first(udp_frame_overhead + payload.size());
+}
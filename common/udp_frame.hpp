@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <span>
+
+#include "address_v4.hpp"
+
+using hardware_address_type = std::array<std::uint8_t, 6u>;
+
+/* Ethernet II + IPv4 (no options) + UDP headers in front of the payload */
+static inline constexpr const std::size_t udp_frame_overhead = 14u + 20u + 8u;
+
+/*
+ * Writes a complete Ethernet/IPv4/UDP frame carrying `payload` into `frame`,
+ * for sending through a packet socket to a host that has no address yet and
+ * can't answer ARP. Returns the part of `frame` that was written, throws if
+ * it's too small or the datagram doesn't fit into a single IPv4 packet.
+ */
+auto make_udp_frame(std::span<std::byte> frame,
+	hardware_address_type const& source_mac, address_v4 const& source,
+	hardware_address_type const& target_mac, address_v4 const& target,
+	std::span<const std::byte> payload) -> std::span<const std::byte>;
+
+/* RFC 1071 ones' complement sum, folded and complemented */
+auto internet_checksum(std::span<const std::byte> bytes, std::uint32_t sum = 0u) -> std::uint16_t;
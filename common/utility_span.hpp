@@ -2,6 +2,8 @@
 
 #include <span>
 #include <stdexcept>
+#include <cstddef>
+#include <algorithm>
 
 template <typename T, typename Q>
 requires (sizeof (Q) == 1)
@@ -12,4 +14,28 @@ auto take_one(std::span<const Q>& bits) -> const T&
 	T const *const value = reinterpret_cast<const T*>(bits.data());
 	bits = bits.subspan(sizeof(T));
 	return *value;
-}
\ No newline at end of file
+}
+
+/* slices the next `count` bytes of a gather list into `out`, `offset` tracks the position within the first piece,
+   returns the number of pieces written to `out` */
+inline auto take_gather(std::span<const std::span<const std::byte>>& pieces, std::size_t& offset, std::size_t count, std::span<std::span<const std::byte>> out) -> std::size_t
+{
+	std::size_t used = 0u;
+	while (count > 0u && !pieces.empty())
+	{
+		if (used >= out.size())
+			throw std::runtime_error("too many pieces for a single datagram");
+		const auto piece = pieces.front().subspan(offset);
+		const auto length = std::min(piece.size(), count);
+		if (length > 0u)
+			out[used++] = piece.subspan(0u, length);
+		count -= length;
+		offset += length;
+		if (offset >= pieces.front().size())
+		{
+			pieces = pieces.subspan(1u);
+			offset = 0u;
+		}
+	}
+	return used;
+}
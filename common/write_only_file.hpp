@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+#include <filesystem>
+
+/*
+ * A new file written at explicit offsets (pwrite), writes that arrive out of
+ * order or from another thread don't need a shared position. Creating it
+ * fails when the path is already taken.
+ */
+struct write_only_file
+{
+	write_only_file() noexcept;
+	write_only_file(std::filesystem::path const& path);
+	write_only_file(write_only_file&& other) noexcept;
+	write_only_file& operator = (write_only_file&& other) noexcept;
+	write_only_file(write_only_file const&) = delete;
+	write_only_file& operator = (write_only_file const&) = delete;
+ ~write_only_file();
+
+	void swap(write_only_file& other) noexcept;
+
+	/* writes all of `buffer` or throws */
+	void write(std::uintmax_t offset, std::span<const std::byte> buffer) const;
+
+	/* reserves the blocks up front, so the file doesn't fragment and a full disk shows up now, throws when there isn't room */
+	void preallocate(std::uintmax_t length) const;
+	void resize(std::uintmax_t length) const;
+	/* the data on disk, not the metadata that doesn't matter for reading it back */
+	void sync() const;
+	void close();
+
+	explicit operator bool () const noexcept;
+
+private:
+	std::intptr_t	m_handle{ -1 };
+};
+
+/* moves `from` to `to` only when `to` isn't there yet, throws when it is (EEXIST) or the move fails */
+void rename_no_replace(std::filesystem::path const& from, std::filesystem::path const& to);
@@ -0,0 +1,104 @@
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <format>
+
+#include "write_only_file.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <cerrno>
+
+write_only_file::write_only_file() noexcept
+{}
+
+write_only_file::write_only_file(std::filesystem::path const& path)
+{
+	const auto fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw std::runtime_error(std::format("failed to create '{}', error : {}", path.string(), std::generic_category().message(errno)));
+	m_handle = fd;
+}
+
+write_only_file::write_only_file(write_only_file&& other) noexcept
+:	m_handle{ std::exchange(other.m_handle, -1) }
+{}
+
+auto write_only_file::operator = (write_only_file&& other) noexcept -> write_only_file&
+{
+	write_only_file tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+write_only_file::~write_only_file()
+{
+	close();
+}
+
+void write_only_file::swap(write_only_file& other) noexcept
+{
+	std::swap(m_handle, other.m_handle);
+}
+
+void write_only_file::write(std::uintmax_t offset, std::span<const std::byte> buffer) const
+{
+	std::size_t total = 0u;
+	while (total < buffer.size())
+	{
+		const auto count = ::pwrite((int)m_handle, buffer.data() + total, buffer.size() - total, (off_t)(offset + total));
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			throw std::runtime_error(std::format("failed to write at offset {}, error : {}", offset + total, std::generic_category().message(count < 0 ? errno : EIO)));
+		total += (std::size_t)count;
+	}
+}
+
+/* file systems without fallocate() are left to allocate as the writes come */
+void write_only_file::preallocate(std::uintmax_t length) const
+{
+	if (length == 0u)
+		return;
+	if (const auto error_code = ::posix_fallocate((int)m_handle, 0, (off_t)length); error_code != 0 && error_code != EOPNOTSUPP && error_code != EINVAL)
+		throw std::runtime_error(std::format("failed to allocate {} bytes, error : {}", length, std::generic_category().message(error_code)));
+}
+
+void write_only_file::resize(std::uintmax_t length) const
+{
+	if (::ftruncate((int)m_handle, (off_t)length) != 0)
+		throw std::runtime_error(std::format("failed to resize to {} bytes, error : {}", length, std::generic_category().message(errno)));
+}
+
+void write_only_file::sync() const
+{
+	if (::fdatasync((int)m_handle) != 0)
+		throw std::runtime_error(std::format("failed to flush to disk, error : {}", std::generic_category().message(errno)));
+}
+
+void write_only_file::close()
+{
+	if (m_handle >= 0)
+		::close((int)std::exchange(m_handle, -1));
+}
+
+write_only_file::operator bool () const noexcept
+{
+	return m_handle >= 0;
+}
+
+void rename_no_replace(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+#if defined(__linux__) && defined(RENAME_NOREPLACE)
+	if (::renameat2(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE) == 0)
+		return;
+	/* file systems without renameat2() fall back to the link below */
+	if (errno != EINVAL && errno != ENOSYS)
+		throw std::runtime_error(std::format("failed to move '{}' to '{}', error : {}", from.string(), to.string(), std::generic_category().message(errno)));
+#endif
+	/* link() fails when `to` exists, unlike rename() */
+	if (::link(from.c_str(), to.c_str()) != 0)
+		throw std::runtime_error(std::format("failed to move '{}' to '{}', error : {}", from.string(), to.string(), std::generic_category().message(errno)));
+	::unlink(from.c_str());
+}
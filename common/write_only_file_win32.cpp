@@ -0,0 +1,103 @@
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <algorithm>
+#include <format>
+
+#include "write_only_file.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+
+#include <Windows.h>
+
+write_only_file::write_only_file() noexcept
+{}
+
+write_only_file::write_only_file(std::filesystem::path const& path)
+{
+	const auto file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(std::format("failed to create '{}', error : {}", path.string(), std::system_category().message(GetLastError())));
+	m_handle = (std::intptr_t)file;
+}
+
+write_only_file::write_only_file(write_only_file&& other) noexcept
+:	m_handle{ std::exchange(other.m_handle, -1) }
+{}
+
+auto write_only_file::operator = (write_only_file&& other) noexcept -> write_only_file&
+{
+	write_only_file tmp(std::move(other));
+	tmp.swap(*this);
+	return *this;
+}
+
+write_only_file::~write_only_file()
+{
+	close();
+}
+
+void write_only_file::swap(write_only_file& other) noexcept
+{
+	std::swap(m_handle, other.m_handle);
+}
+
+/* WriteFile with an offset in the OVERLAPPED, the synchronous counterpart of pwrite */
+void write_only_file::write(std::uintmax_t offset, std::span<const std::byte> buffer) const
+{
+	std::size_t total = 0u;
+	while (total < buffer.size())
+	{
+		OVERLAPPED position{};
+		position.Offset = (DWORD)((offset + total) & 0xffffffffu);
+		position.OffsetHigh = (DWORD)((offset + total) >> 32u);
+		DWORD count = 0u;
+		const auto chunk = (DWORD)std::min<std::size_t>(buffer.size() - total, 0x40000000u);
+		if (!WriteFile((HANDLE)m_handle, buffer.data() + total, chunk, &count, &position))
+			throw std::runtime_error(std::format("failed to write at offset {}, error : {}", offset + total, std::system_category().message(GetLastError())));
+		total += count;
+	}
+}
+
+void write_only_file::preallocate(std::uintmax_t length) const
+{
+	if (length == 0u)
+		return;
+	FILE_ALLOCATION_INFO allocation{};
+	allocation.AllocationSize.QuadPart = (LONGLONG)length;
+	if (!SetFileInformationByHandle((HANDLE)m_handle, FileAllocationInfo, &allocation, sizeof(allocation)))
+		throw std::runtime_error(std::format("failed to allocate {} bytes, error : {}", length, std::system_category().message(GetLastError())));
+}
+
+void write_only_file::resize(std::uintmax_t length) const
+{
+	FILE_END_OF_FILE_INFO end{};
+	end.EndOfFile.QuadPart = (LONGLONG)length;
+	if (!SetFileInformationByHandle((HANDLE)m_handle, FileEndOfFileInfo, &end, sizeof(end)))
+		throw std::runtime_error(std::format("failed to resize to {} bytes, error : {}", length, std::system_category().message(GetLastError())));
+}
+
+void write_only_file::sync() const
+{
+	if (!FlushFileBuffers((HANDLE)m_handle))
+		throw std::runtime_error(std::format("failed to flush to disk, error : {}", std::system_category().message(GetLastError())));
+}
+
+void write_only_file::close()
+{
+	if (m_handle != -1)
+		CloseHandle((HANDLE)std::exchange(m_handle, -1));
+}
+
+write_only_file::operator bool () const noexcept
+{
+	return m_handle != -1;
+}
+
+void rename_no_replace(std::filesystem::path const& from, std::filesystem::path const& to)
+{
+	/* without MOVEFILE_REPLACE_EXISTING the move fails when `to` exists */
+	if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_WRITE_THROUGH))
+		throw std::runtime_error(std::format("failed to move '{}' to '{}', error : {}", from.string(), to.string(), std::system_category().message(GetLastError())));
+}